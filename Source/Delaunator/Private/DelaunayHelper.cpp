@@ -55,7 +55,7 @@ FVector2D FDelaunayTriangle::GetCircumcenter() const
 	}
 }
 
-void FDelaunayMesh::CreatePoints(const TArray<FVector2D>& GivenPoints)
+void FDelaunayMesh::CreatePoints(const TArray<FVector2D>& GivenPoints, bool bReserveGhostStructure)
 {
 	// Convert to standard vector
 	std::vector<double> coords = {};
@@ -72,8 +72,24 @@ void FDelaunayMesh::CreatePoints(const TArray<FVector2D>& GivenPoints)
 	// Place all the data from the Delaunator into this struct for
 	// easy access in Unreal
 
+	// Every unpaired half-edge lies on the hull, and gets a
+	// ghost triangle of 3 sides if we're adding a ghost structure
+	int32 extraRegions = 0;
+	int32 extraSides = 0;
+	if (bReserveGhostStructure)
+	{
+		extraRegions = 1;
+		for (int i = 0; i < delaunay.halfedges.size(); i++)
+		{
+			if (delaunay.halfedges[i] == delaunator::INVALID_INDEX)
+			{
+				extraSides += 3;
+			}
+		}
+	}
+
 	// Coordinates
-	Coordinates.Empty(delaunay.coords.size() / 2);
+	Coordinates.Empty(delaunay.coords.size() / 2 + extraRegions);
 	for (int i = 0; i < delaunay.coords.size(); i += 2)
 	{
 		// The Delaunator stores everything in a vector of doubles
@@ -85,27 +101,26 @@ void FDelaunayMesh::CreatePoints(const TArray<FVector2D>& GivenPoints)
 	}
 
 	// Half-edges
-	HalfEdges.Empty(delaunay.halfedges.size());
+	HalfEdges.Empty(delaunay.halfedges.size() + extraSides);
 	for (int i = 0; i < delaunay.halfedges.size(); i++)
 	{
 		HalfEdges.Add((FSideIndex)delaunay.halfedges[i]);
 	}
 
 	// Triangles
-	DelaunayTriangles.Empty(delaunay.triangles.size());
+	DelaunayTriangles.Empty(delaunay.triangles.size() + extraSides);
 	for (int i = 0; i < delaunay.triangles.size(); i++)
 	{
 		DelaunayTriangles.Add((FPointIndex)delaunay.triangles[i]);
 	}
 
-	PointToEdge.Empty();
-	for (FSideIndex e = 0; e < DelaunayTriangles.Num(); e++)
+	if (bReserveGhostStructure)
 	{
-		FPointIndex endpoint = DelaunayTriangles[UDelaunayHelper::NextHalfEdge(e)];
-		if (!PointToEdge.Contains(endpoint) || !HalfEdges[e].IsValid())
-		{
-			PointToEdge.Add(endpoint, e);
-		}
+		PointToEdge.Empty();
+	}
+	else
+	{
+		BuildPointToEdge();
 	}
 
 	UE_LOG(LogDelaunator, Log, TEXT("Created Delaunay Triangulation with %d points, %d triangles, and %d half-edges."), Coordinates.Num(), DelaunayTriangles.Num() / 3, HalfEdges.Num());
@@ -133,6 +148,26 @@ void FDelaunayMesh::CreatePoints(const TArray<FVector2D>& GivenPoints)
 	}
 }
 
+void FDelaunayMesh::BuildPointToEdge()
+{
+	PointToEdge.Init(INDEX_NONE, Coordinates.Num());
+	for (FSideIndex e = 0; e < DelaunayTriangles.Num(); e++)
+	{
+		FPointIndex endpoint = DelaunayTriangles[UDelaunayHelper::NextHalfEdge(e)];
+		if (PointToEdge[endpoint] == INDEX_NONE || !HalfEdges[e].IsValid())
+		{
+			PointToEdge[endpoint] = (int32)e;
+		}
+	}
+}
+
+SIZE_T FDelaunayMesh::GetAllocatedSize() const
+{
+	return Coordinates.GetAllocatedSize() + HalfEdges.GetAllocatedSize() + PointToEdge.GetAllocatedSize()
+		+ HullTriangles.GetAllocatedSize() + HullPrevious.GetAllocatedSize() + HullNext.GetAllocatedSize()
+		+ DelaunayTriangles.GetAllocatedSize();
+}
+
 float FDelaunayMesh::GetHullArea(float& OutErrorAmount) const
 {
 	TArray<float> hullArea;
@@ -352,9 +352,11 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	TArray<FSideIndex> HalfEdges;
 
-	// An index mapping point IDs to half-edge IDs
+	// An index mapping point IDs to the ID of a half-edge leading into that point.
+	// Hull points always map to their unpaired incoming half-edge.
+	// Points without any triangles are INDEX_NONE.
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
-	TMap<FPointIndex, FSideIndex> PointToEdge;
+	TArray<int32> PointToEdge;
 
 	// Starting triangle for the hull.
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, AdvancedDisplay)
@@ -381,15 +383,23 @@ public:
 		HullStart = FTriangleIndex();
 	}
 
-	FDelaunayMesh(const TArray<FVector2D>& GivenPoints)
+	FDelaunayMesh(const TArray<FVector2D>& GivenPoints, bool bReserveGhostStructure = false)
 	{
 		HullStart = FTriangleIndex();
-		CreatePoints(GivenPoints);
+		CreatePoints(GivenPoints, bReserveGhostStructure);
 	}
 
 public:
-	// Generates the actual triangulation
-	void CreatePoints(const TArray<FVector2D>& GivenPoints);
+	// Generates the actual triangulation.
+	// If bReserveGhostStructure is true, the arrays get enough slack to
+	// add a ghost region and a ghost triangle for every hull side without
+	// reallocating. PointToEdge is left empty in that case, since the
+	// caller is going to change the topology and rebuild it anyway.
+	void CreatePoints(const TArray<FVector2D>& GivenPoints, bool bReserveGhostStructure = false);
+	// Rebuilds the PointToEdge index from the current half-edges and triangles.
+	void BuildPointToEdge();
+	// Gets the number of bytes allocated by the arrays in this struct.
+	SIZE_T GetAllocatedSize() const;
 	// Gets the area of the Delaunay hull.
 	float GetHullArea(float& OutErrorAmount) const;
 	// Returns the Kahan and Babuska of an array of floats.
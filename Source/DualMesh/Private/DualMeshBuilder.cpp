@@ -110,6 +110,30 @@ void UDualMeshBuilder::AddPoisson(FRandomStream& Rng, FVector2D MapOffset, float
 	Rng.GetFraction(); // Generates the next seed
 }
 
+void UDualMeshBuilder::AddVariablePoisson(FRandomStream& Rng, TFunctionRef<float(const FVector2D&)> GetSpacing, FVector2D MapOffset, float MinSpacing, int32 MaxStepSamples)
+{
+#if !UE_BUILD_SHIPPING
+	FDateTime startTime = FDateTime::UtcNow();
+	const int32 firstPoint = Points.Num();
+#endif
+
+	UPoissonDiscUtilities::DistributeVariable2D(Points, Rng.GetCurrentSeed(), MaxMeshSize - MapOffset, MapOffset * 0.5f, MinSpacing, GetSpacing, MaxStepSamples);
+	Rng.GetFraction(); // Generates the next seed
+
+#if !UE_BUILD_SHIPPING
+	// Each point covers an area proportional to its spacing squared,
+	// so this is roughly how many points MinSpacing everywhere would have made
+	double uniformPoints = 0.0;
+	for (int32 i = firstPoint; i < Points.Num(); i++)
+	{
+		const float ratio = FMath::Max(GetSpacing(Points[i]), MinSpacing) / MinSpacing;
+		uniformPoints += ratio * ratio;
+	}
+	FTimespan difference = FDateTime::UtcNow() - startTime;
+	UE_LOG(LogDualMesh, Log, TEXT("Variable Poisson sampling made %d points in %f seconds. A uniform spacing of %f would have made about %d."), Points.Num() - firstPoint, difference.GetTotalSeconds(), MinSpacing, (int32)uniformPoints);
+#endif
+}
+
 UTriangleDualMesh* UDualMeshBuilder::Create()
 {
 	if (NumBoundaryRegions == -1)
@@ -121,8 +145,8 @@ UTriangleDualMesh* UDualMeshBuilder::Create()
 	UTriangleDualMesh* mesh = NewObject<UTriangleDualMesh>();
 	check(mesh);
 	
-	FDualMesh dualMesh = FDualMesh(Points, MaxMeshSize);
-	mesh->InitializeMesh(dualMesh, NumBoundaryRegions);
-	
+	mesh->InitializeMesh(FDualMesh(Points, MaxMeshSize), NumBoundaryRegions);
+	UE_LOG(LogDualMesh, Log, TEXT("Dual mesh with %d regions uses %.2f MB of topology data."), mesh->NumRegions, mesh->GetAllocatedSize() / (1024.0f * 1024.0f));
+
 	return mesh;
 }
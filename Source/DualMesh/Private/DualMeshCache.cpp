@@ -0,0 +1,367 @@
+/*
+* Based on https://github.com/redblobgames/dual-mesh
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Saves generated dual meshes to disk so they can be loaded instead of rebuilt.
+*/
+
+#include "DualMeshCache.h"
+#include "DualMesh.h"
+#include "TriangleDualMesh.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+const uint32 FDualMeshCache::Version = 1;
+
+namespace DualMeshCache
+{
+	// "DMSH"
+	static const uint32 Magic = 0x48534D44;
+
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 PayloadCrc;
+		uint32 KeyLength;
+		int64 PayloadSize;
+	};
+
+	static void Write(TArray<uint8>& Bytes, const void* Data, int64 Size)
+	{
+		const int32 start = Bytes.AddUninitialized((int32)Size);
+		FMemory::Memcpy(Bytes.GetData() + start, Data, Size);
+	}
+
+	static void WriteInt(TArray<uint8>& Bytes, int32 Value)
+	{
+		Write(Bytes, &Value, sizeof(int32));
+	}
+
+	// Mesh indices are stored as int32, with -1 for invalid indices, to halve the file size
+	template<typename IndexType>
+	static void WriteIndices(TArray<uint8>& Bytes, const TArray<IndexType>& Indices)
+	{
+		const int32 start = Bytes.AddUninitialized(Indices.Num() * sizeof(int32));
+		int32* out = (int32*)(Bytes.GetData() + start);
+		for (int32 i = 0; i < Indices.Num(); i++)
+		{
+			out[i] = Indices[i].IsValid() ? (int32)Indices[i].Value : -1;
+		}
+	}
+
+	struct FReader
+	{
+		const uint8* Data;
+		int64 Size;
+		int64 Offset;
+		bool bError;
+
+		FReader(const uint8* InData, int64 InSize)
+			: Data(InData), Size(InSize), Offset(0), bError(false)
+		{
+		}
+
+		const uint8* Read(int64 Bytes)
+		{
+			if (bError || Bytes < 0 || Offset + Bytes > Size)
+			{
+				bError = true;
+				return NULL;
+			}
+			const uint8* result = Data + Offset;
+			Offset += Bytes;
+			return result;
+		}
+
+		int32 ReadInt()
+		{
+			int32 value = 0;
+			if (const uint8* bytes = Read(sizeof(int32)))
+			{
+				FMemory::Memcpy(&value, bytes, sizeof(int32));
+			}
+			return value;
+		}
+
+		template<typename IndexType>
+		void ReadIndices(TArray<IndexType>& OutIndices, int32 Num)
+		{
+			const uint8* bytes = Read((int64)Num * sizeof(int32));
+			if (bytes == NULL)
+			{
+				return;
+			}
+			OutIndices.SetNumUninitialized(Num);
+			for (int32 i = 0; i < Num; i++)
+			{
+				int32 value;
+				FMemory::Memcpy(&value, bytes + i * sizeof(int32), sizeof(int32));
+				OutIndices[i] = value < 0 ? INVALID_DELAUNAY_INDEX : (SIZE_T)value;
+			}
+		}
+	};
+
+	// Whether every index is below Limit. Invalid indices only pass if bAllowInvalid is set.
+	template<typename IndexType>
+	static bool AreIndicesBelow(const TArray<IndexType>& Indices, SIZE_T Limit, bool bAllowInvalid)
+	{
+		for (const IndexType& index : Indices)
+		{
+			if (index.IsValid() ? (SIZE_T)index >= Limit : !bAllowInvalid)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+FString FDualMeshCache::GetCachePath(const FString& Key)
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("DualMeshCache"), FString::Printf(TEXT("%08x.dmsh"), FCrc::StrCrc32(*Key)));
+}
+
+void FDualMeshCache::Serialize(const UTriangleDualMesh* Mesh, const FString& Key, int32 RngSteps, TArray<uint8>& OutBytes)
+{
+	using namespace DualMeshCache;
+	OutBytes.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+	const FDualMesh& rawMesh = Mesh->GetRawMesh();
+
+	TArray<uint8> payload;
+	payload.Reserve(rawMesh.Coordinates.Num() * (sizeof(FVector2D) + 4 * sizeof(int32)) + rawMesh.HalfEdges.Num() * 2 * sizeof(int32) + 64);
+	Write(payload, &rawMesh.MaxSize, sizeof(FVector2D));
+	WriteInt(payload, rawMesh.NumSolidSides);
+	WriteInt(payload, Mesh->NumBoundaryRegions);
+	WriteInt(payload, RngSteps);
+	WriteInt(payload, rawMesh.HullStart.IsValid() ? (int32)rawMesh.HullStart.Value : -1);
+
+	WriteInt(payload, rawMesh.Coordinates.Num());
+	WriteInt(payload, rawMesh.DelaunayTriangles.Num());
+	WriteInt(payload, rawMesh.HalfEdges.Num());
+	WriteInt(payload, rawMesh.PointToEdge.Num());
+	WriteInt(payload, rawMesh.HullTriangles.Num());
+	WriteInt(payload, rawMesh.HullPrevious.Num());
+	WriteInt(payload, rawMesh.HullNext.Num());
+
+	Write(payload, rawMesh.Coordinates.GetData(), rawMesh.Coordinates.Num() * sizeof(FVector2D));
+	WriteIndices(payload, rawMesh.DelaunayTriangles);
+	WriteIndices(payload, rawMesh.HalfEdges);
+	Write(payload, rawMesh.PointToEdge.GetData(), rawMesh.PointToEdge.Num() * sizeof(int32));
+	WriteIndices(payload, rawMesh.HullTriangles);
+	WriteIndices(payload, rawMesh.HullPrevious);
+	WriteIndices(payload, rawMesh.HullNext);
+
+	FTCHARToUTF8 key(*Key);
+	FHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.PayloadCrc = FCrc::MemCrc32(payload.GetData(), payload.Num());
+	header.KeyLength = key.Length();
+	header.PayloadSize = payload.Num();
+
+	OutBytes.Reserve(sizeof(FHeader) + key.Length() + payload.Num());
+	Write(OutBytes, &header, sizeof(FHeader));
+	Write(OutBytes, key.Get(), key.Length());
+	OutBytes.Append(payload);
+}
+
+UTriangleDualMesh* FDualMeshCache::Deserialize(const uint8* Data, int64 Size, const FString& Key, int32& OutRngSteps)
+{
+	using namespace DualMeshCache;
+	OutRngSteps = 0;
+	if (Data == NULL)
+	{
+		return NULL;
+	}
+
+	FReader reader(Data, Size);
+	FHeader header;
+	const uint8* headerBytes = reader.Read(sizeof(FHeader));
+	if (headerBytes == NULL)
+	{
+		return NULL;
+	}
+	FMemory::Memcpy(&header, headerBytes, sizeof(FHeader));
+	if (header.Magic != Magic || header.Version != Version)
+	{
+		UE_LOG(LogDualMesh, Log, TEXT("Ignoring dual mesh cache from an older version."));
+		return NULL;
+	}
+
+	FTCHARToUTF8 key(*Key);
+	const uint8* keyBytes = reader.Read(header.KeyLength);
+	if (keyBytes == NULL || header.KeyLength != (uint32)key.Length() || FMemory::Memcmp(keyBytes, key.Get(), key.Length()) != 0)
+	{
+		UE_LOG(LogDualMesh, Log, TEXT("Ignoring dual mesh cache saved under a different key."));
+		return NULL;
+	}
+
+	const uint8* payloadBytes = reader.Read(header.PayloadSize);
+	if (payloadBytes == NULL || FCrc::MemCrc32(payloadBytes, header.PayloadSize) != header.PayloadCrc)
+	{
+		UE_LOG(LogDualMesh, Warning, TEXT("Dual mesh cache failed its checksum, so it will be rebuilt."));
+		return NULL;
+	}
+
+	FReader payload(payloadBytes, header.PayloadSize);
+	FDualMesh rawMesh;
+	if (const uint8* maxSize = payload.Read(sizeof(FVector2D)))
+	{
+		FMemory::Memcpy(&rawMesh.MaxSize, maxSize, sizeof(FVector2D));
+	}
+	rawMesh.NumSolidSides = payload.ReadInt();
+	const int32 numBoundaryRegions = payload.ReadInt();
+	const int32 rngSteps = payload.ReadInt();
+	const int32 hullStart = payload.ReadInt();
+	rawMesh.HullStart = hullStart < 0 ? INVALID_DELAUNAY_INDEX : (SIZE_T)hullStart;
+
+	const int32 numCoordinates = payload.ReadInt();
+	const int32 numTriangleSides = payload.ReadInt();
+	const int32 numHalfEdges = payload.ReadInt();
+	const int32 numPointToEdge = payload.ReadInt();
+	const int32 numHullTriangles = payload.ReadInt();
+	const int32 numHullPrevious = payload.ReadInt();
+	const int32 numHullNext = payload.ReadInt();
+	if (payload.bError || numCoordinates < 0 || numTriangleSides < 0 || numHalfEdges != numTriangleSides || numPointToEdge < 0
+		|| numHullTriangles < 0 || numHullPrevious < 0 || numHullNext < 0)
+	{
+		return NULL;
+	}
+
+	if (const uint8* coordinates = payload.Read((int64)numCoordinates * sizeof(FVector2D)))
+	{
+		rawMesh.Coordinates.SetNumUninitialized(numCoordinates);
+		FMemory::Memcpy(rawMesh.Coordinates.GetData(), coordinates, numCoordinates * sizeof(FVector2D));
+	}
+	payload.ReadIndices(rawMesh.DelaunayTriangles, numTriangleSides);
+	payload.ReadIndices(rawMesh.HalfEdges, numHalfEdges);
+	if (const uint8* pointToEdge = payload.Read((int64)numPointToEdge * sizeof(int32)))
+	{
+		rawMesh.PointToEdge.SetNumUninitialized(numPointToEdge);
+		FMemory::Memcpy(rawMesh.PointToEdge.GetData(), pointToEdge, numPointToEdge * sizeof(int32));
+	}
+	payload.ReadIndices(rawMesh.HullTriangles, numHullTriangles);
+	payload.ReadIndices(rawMesh.HullPrevious, numHullPrevious);
+	payload.ReadIndices(rawMesh.HullNext, numHullNext);
+	if (payload.bError)
+	{
+		return NULL;
+	}
+
+	// The checksum only proves the bytes weren't damaged by accident, so check that every
+	// index points somewhere real before InitializeMesh() starts following them.
+	// The ghost region is the last coordinate, so it's covered by the coordinate count.
+	const int32 numSides = numTriangleSides;
+	bool bValidTopology = numCoordinates > 0 && numSides % 3 == 0
+		&& rawMesh.NumSolidSides >= 0 && rawMesh.NumSolidSides <= numSides && rawMesh.NumSolidSides % 3 == 0
+		&& numBoundaryRegions >= 0 && numBoundaryRegions <= numCoordinates
+		&& numPointToEdge == numCoordinates
+		&& (!rawMesh.HullStart.IsValid() || (SIZE_T)rawMesh.HullStart < (SIZE_T)numCoordinates)
+		&& AreIndicesBelow(rawMesh.DelaunayTriangles, numCoordinates, false)
+		&& AreIndicesBelow(rawMesh.HalfEdges, numSides, false)
+		&& AreIndicesBelow(rawMesh.HullTriangles, numSides, true)
+		&& AreIndicesBelow(rawMesh.HullPrevious, numCoordinates, true)
+		&& AreIndicesBelow(rawMesh.HullNext, numCoordinates, true);
+	for (int32 i = 0; i < rawMesh.PointToEdge.Num() && bValidTopology; i++)
+	{
+		bValidTopology = rawMesh.PointToEdge[i] >= INDEX_NONE && rawMesh.PointToEdge[i] < numSides;
+	}
+	// Every side has to be paired with a side that points back at it.
+	// Otherwise, walking around a region might never come back to where it started.
+	for (int32 s = 0; s < numSides && bValidTopology; s++)
+	{
+		const int32 opposite = (int32)rawMesh.HalfEdges[s];
+		bValidTopology = opposite != s && (int32)rawMesh.HalfEdges[opposite] == s;
+	}
+	if (!bValidTopology)
+	{
+		UE_LOG(LogDualMesh, Warning, TEXT("Dual mesh cache had indices outside of the mesh, so it will be rebuilt."));
+		return NULL;
+	}
+
+	UTriangleDualMesh* mesh = NewObject<UTriangleDualMesh>();
+	mesh->InitializeMesh(MoveTemp(rawMesh), numBoundaryRegions);
+	OutRngSteps = rngSteps;
+	return mesh;
+}
+
+bool FDualMeshCache::Save(const UTriangleDualMesh* Mesh, const FString& Key, int32 RngSteps)
+{
+	TArray<uint8> bytes;
+	Serialize(Mesh, Key, RngSteps, bytes);
+	if (bytes.Num() == 0)
+	{
+		return false;
+	}
+
+	const FString path = GetCachePath(Key);
+	if (!FFileHelper::SaveArrayToFile(bytes, *path))
+	{
+		UE_LOG(LogDualMesh, Warning, TEXT("Could not write dual mesh cache to %s."), *path);
+		return false;
+	}
+	UE_LOG(LogDualMesh, Log, TEXT("Saved %.2f MB of dual mesh cache to %s."), bytes.Num() / (1024.0f * 1024.0f), *path);
+	return true;
+}
+
+UTriangleDualMesh* FDualMeshCache::Load(const FString& Key, int32& OutRngSteps)
+{
+	OutRngSteps = 0;
+	const FString path = GetCachePath(Key);
+	IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!platformFile.FileExists(*path))
+	{
+		return NULL;
+	}
+
+#if !UE_BUILD_SHIPPING
+	FDateTime startTime = FDateTime::UtcNow();
+#endif
+
+	// Read straight out of a mapping of the file where the platform supports it,
+	// and fall back to reading the whole file into memory where it doesn't
+	UTriangleDualMesh* mesh = NULL;
+	TUniquePtr<IMappedFileHandle> mappedFile(platformFile.OpenMapped(*path));
+	TUniquePtr<IMappedFileRegion> mappedRegion(mappedFile.IsValid() ? mappedFile->MapRegion() : NULL);
+	if (mappedRegion.IsValid())
+	{
+		mesh = Deserialize(mappedRegion->GetMappedPtr(), mappedRegion->GetMappedSize(), Key, OutRngSteps);
+	}
+	else
+	{
+		TArray<uint8> bytes;
+		if (FFileHelper::LoadFileToArray(bytes, *path))
+		{
+			mesh = Deserialize(bytes.GetData(), bytes.Num(), Key, OutRngSteps);
+		}
+	}
+
+#if !UE_BUILD_SHIPPING
+	if (mesh != NULL)
+	{
+		FTimespan difference = FDateTime::UtcNow() - startTime;
+		UE_LOG(LogDualMesh, Log, TEXT("Loaded a dual mesh with %d regions from the cache in %f seconds."), mesh->NumRegions, difference.GetTotalSeconds());
+	}
+#endif
+	return mesh;
+}
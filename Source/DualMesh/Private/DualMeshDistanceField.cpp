@@ -0,0 +1,307 @@
+/*
+* Based on https://github.com/redblobgames/dual-mesh
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Shortest path distances over the dual mesh, measured in world units.
+*/
+
+#include "DualMeshDistanceField.h"
+#include "DualMeshParallel.h"
+#include "TriangleDualMesh.h"
+
+namespace
+{
+	// A relaxation which would shorten the distance to Node, found during the parallel part of a step.
+	struct FDistanceRequest
+	{
+		int32 Node;
+		int32 Side;
+		float Distance;
+	};
+
+	/**
+	* Runs delta-stepping over a graph whose edges are mesh sides.
+	* GraphType must provide ForEachSide(Node, Visitor), calling Visitor(Side, Target)
+	* for every side leaving Node.
+	* SideLength holds the weighted length of every side, or a negative number if it can't be crossed.
+	*/
+	template<typename GraphType>
+	void RunDeltaStepping(const UTriangleDualMesh* Mesh, const GraphType& Graph, int32 NumNodes, TArrayView<const int32> Seeds, const TArray<float>& SideLength, float BucketWidth, TArray<float>& OutDistances, TArray<FSideIndex>* OutParentSides)
+	{
+		OutDistances.Empty(NumNodes);
+		OutDistances.SetNumUninitialized(NumNodes);
+		for (int32 i = 0; i < NumNodes; i++)
+		{
+			OutDistances[i] = MAX_flt;
+		}
+		TArray<int32> parentSide;
+		parentSide.Init(INDEX_NONE, NumNodes);
+
+		const float delta = BucketWidth;
+		auto getBucket = [delta](float Distance)
+		{
+			return FMath::Min(FMath::FloorToInt(Distance / delta), MAX_int32 - 1);
+		};
+
+		TArray<TArray<int32>> buckets;
+		buckets.AddDefaulted(1);
+		for (int32 seed : Seeds)
+		{
+			if (seed >= 0 && seed < NumNodes && OutDistances[seed] != 0.0f)
+			{
+				OutDistances[seed] = 0.0f;
+				buckets[0].Add(seed);
+			}
+		}
+
+		// The last step each node was relaxed in, so nodes queued more than once are only relaxed once per step.
+		// The last bucket each node was settled in, so its heavy edges are only relaxed once.
+		TArray<int32> relaxedStep;
+		relaxedStep.Init(INDEX_NONE, NumNodes);
+		TArray<int32> settledBucket;
+		settledBucket.Init(INDEX_NONE, NumNodes);
+
+		const int32 batchSize = FDualMeshParallel::GetMinBatchSize();
+		TArray<TArray<FDistanceRequest>> chunkRequests;
+		TArray<int32> frontier;
+		TArray<int32> settled;
+		int32 step = 0;
+
+		// Finds every relaxation out of Nodes in parallel, then applies them in a fixed order
+		auto relax = [&](const TArray<int32>& Nodes, bool bLightEdges)
+		{
+			const int32 numChunks = FMath::DivideAndRoundUp(Nodes.Num(), batchSize);
+			if (chunkRequests.Num() < numChunks)
+			{
+				chunkRequests.SetNum(numChunks);
+			}
+			FDualMeshParallel::ForEachChunk(Nodes.Num(), [&](int32 Start, int32 End)
+			{
+				TArray<FDistanceRequest>& requests = chunkRequests[Start / batchSize];
+				requests.Reset();
+				for (int32 i = Start; i < End; i++)
+				{
+					const int32 node = Nodes[i];
+					const float distance = OutDistances[node];
+					Graph.ForEachSide(node, [&](int32 s, int32 target)
+					{
+						const float length = SideLength[s];
+						if (length < 0.0f || (length <= delta) != bLightEdges)
+						{
+							return;
+						}
+						const float newDistance = distance + length;
+						if (newDistance < OutDistances[target])
+						{
+							requests.Add({ target, s, newDistance });
+						}
+					});
+				}
+			}, batchSize);
+
+			for (int32 chunk = 0; chunk < numChunks; chunk++)
+			{
+				for (const FDistanceRequest& request : chunkRequests[chunk])
+				{
+					if (request.Distance < OutDistances[request.Node])
+					{
+						OutDistances[request.Node] = request.Distance;
+						parentSide[request.Node] = request.Side;
+						const int32 bucket = getBucket(request.Distance);
+						if (bucket >= buckets.Num())
+						{
+							buckets.SetNum(bucket + 1);
+						}
+						buckets[bucket].Add(request.Node);
+					}
+				}
+			}
+		};
+
+		for (int32 bucket = 0; bucket < buckets.Num(); bucket++)
+		{
+			settled.Reset();
+			while (buckets[bucket].Num() > 0)
+			{
+				// Drop nodes which have since moved to an earlier bucket, or are queued twice
+				frontier.Reset();
+				for (int32 node : buckets[bucket])
+				{
+					if (getBucket(OutDistances[node]) != bucket || relaxedStep[node] == step)
+					{
+						continue;
+					}
+					relaxedStep[node] = step;
+					frontier.Add(node);
+					if (settledBucket[node] != bucket)
+					{
+						settledBucket[node] = bucket;
+						settled.Add(node);
+					}
+				}
+				buckets[bucket].Reset();
+				step++;
+
+				relax(frontier, true);
+			}
+			relax(settled, false);
+			buckets[bucket].Empty();
+		}
+
+		FDualMeshParallel::ForEach(NumNodes, [&](int32 i)
+		{
+			if (OutDistances[i] == MAX_flt)
+			{
+				OutDistances[i] = -1.0f;
+			}
+		});
+
+		if (OutParentSides != NULL)
+		{
+			OutParentSides->Empty(NumNodes);
+			OutParentSides->SetNum(NumNodes);
+			FDualMeshParallel::ForEach(NumNodes, [&](int32 i)
+			{
+				// Store the side pointing back up the path, rather than the one we came in on
+				(*OutParentSides)[i] = parentSide[i] == INDEX_NONE ? FSideIndex() : Mesh->s_opposite_s(parentSide[i]);
+			});
+		}
+	}
+
+	// Finds the weighted length of every side, and the mean length of the sides that can be crossed.
+	template<typename LengthFunctionType>
+	float ComputeSideLengths(int32 NumSides, FDualMeshDistanceField::FSideWeightFunction SideWeight, const LengthFunctionType& GetLength, TArray<float>& OutLengths)
+	{
+		OutLengths.Empty(NumSides);
+		OutLengths.SetNumUninitialized(NumSides);
+		TArray<float> rawLengths;
+		rawLengths.SetNumUninitialized(NumSides);
+		FDualMeshParallel::ForEach(NumSides, [&](int32 s)
+		{
+			const float weight = SideWeight(s);
+			rawLengths[s] = weight < 0.0f ? -1.0f : GetLength(s);
+			OutLengths[s] = weight < 0.0f || rawLengths[s] < 0.0f ? -1.0f : weight * rawLengths[s];
+		});
+
+		double total = 0.0;
+		int32 count = 0;
+		for (float length : rawLengths)
+		{
+			if (length > 0.0f)
+			{
+				total += length;
+				count++;
+			}
+		}
+		return count > 0 ? (float)(total / count) : 1.0f;
+	}
+
+	struct FRegionGraph
+	{
+		const TArray<int32>& Offsets;
+		const TArray<int32>& Sides;
+		const TArray<FPointIndex>& Triangles;
+
+		template<typename VisitorType>
+		FORCEINLINE void ForEachSide(int32 r, const VisitorType& Visitor) const
+		{
+			for (int32 i = Offsets[r]; i < Offsets[r + 1]; i++)
+			{
+				const int32 s = Sides[i];
+				// The side leads to the region at the start of the next side in its triangle
+				Visitor(s, (int32)Triangles[UTriangleDualMesh::s_next_s(s)]);
+			}
+		}
+	};
+
+	struct FTriangleGraph
+	{
+		const TArray<int32>& Neighbors;
+
+		template<typename VisitorType>
+		FORCEINLINE void ForEachSide(int32 t, const VisitorType& Visitor) const
+		{
+			for (int32 s = 3 * t; s < 3 * t + 3; s++)
+			{
+				Visitor(s, Neighbors[s]);
+			}
+		}
+	};
+}
+
+float FDualMeshDistanceField::ComputeRegionDistances(const UTriangleDualMesh* Mesh, TArrayView<const FPointIndex> Seeds, FSideWeightFunction SideWeight, TArray<float>& OutDistances, TArray<FSideIndex>* OutParentSides, float BucketWidth)
+{
+	if (Mesh == NULL)
+	{
+		return 1.0f;
+	}
+
+	const FPointIndex ghost = Mesh->ghost_r();
+	TArray<float> sideLength;
+	const float meanLength = ComputeSideLengths(Mesh->NumSides, SideWeight, [Mesh, ghost](int32 s)
+	{
+		const FPointIndex begin = Mesh->s_begin_r(s);
+		const FPointIndex end = Mesh->s_end_r(s);
+		if (begin == ghost || end == ghost)
+		{
+			return -1.0f;
+		}
+		return FVector2D::Distance(Mesh->r_pos(begin), Mesh->r_pos(end));
+	}, sideLength);
+
+	TArray<int32> seeds;
+	seeds.Reserve(Seeds.Num());
+	for (FPointIndex r : Seeds)
+	{
+		if (r.IsValid())
+		{
+			seeds.Add((int32)r);
+		}
+	}
+
+	const FRegionGraph graph = { Mesh->GetRegionSideOffsets(), Mesh->GetRegionSides(), Mesh->GetRawMesh().DelaunayTriangles };
+	RunDeltaStepping(Mesh, graph, Mesh->NumRegions, seeds, sideLength, BucketWidth > 0.0f ? BucketWidth : meanLength, OutDistances, OutParentSides);
+	return meanLength;
+}
+
+float FDualMeshDistanceField::ComputeTriangleDistances(const UTriangleDualMesh* Mesh, TArrayView<const FTriangleIndex> Seeds, FSideWeightFunction SideWeight, TArray<float>& OutDistances, TArray<FSideIndex>* OutParentSides, float BucketWidth)
+{
+	if (Mesh == NULL)
+	{
+		return 1.0f;
+	}
+
+	const TArray<int32>& neighbors = Mesh->GetTriangleNeighbors();
+	TArray<float> sideLength;
+	const float meanLength = ComputeSideLengths(Mesh->NumSides, SideWeight, [Mesh, &neighbors](int32 s)
+	{
+		return FVector2D::Distance(Mesh->t_pos(s / 3), Mesh->t_pos(neighbors[s]));
+	}, sideLength);
+
+	TArray<int32> seeds;
+	seeds.Reserve(Seeds.Num());
+	for (FTriangleIndex t : Seeds)
+	{
+		if (t.IsValid())
+		{
+			seeds.Add((int32)t);
+		}
+	}
+
+	const FTriangleGraph graph = { neighbors };
+	RunDeltaStepping(Mesh, graph, Mesh->NumTriangles, seeds, sideLength, BucketWidth > 0.0f ? BucketWidth : meanLength, OutDistances, OutParentSides);
+	return meanLength;
+}
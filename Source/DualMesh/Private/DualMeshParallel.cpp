@@ -0,0 +1,46 @@
+/*
+* Based on https://github.com/redblobgames/dual-mesh
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Helpers for running per-element passes over a dual mesh on multiple threads.
+*/
+
+#include "DualMeshParallel.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarDualMeshParallelMinBatchSize(
+	TEXT("DualMesh.ParallelMinBatchSize"),
+	1024,
+	TEXT("The smallest number of regions, triangles or sides handed to a single task\n")
+	TEXT("when running per-element map generation passes in parallel."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarDualMeshForceSerial(
+	TEXT("DualMesh.ForceSerial"),
+	0,
+	TEXT("If nonzero, per-element map generation passes run on the calling thread.\n")
+	TEXT("Useful for debugging."),
+	ECVF_Default);
+
+int32 FDualMeshParallel::GetMinBatchSize()
+{
+	return FMath::Max(1, CVarDualMeshParallelMinBatchSize.GetValueOnAnyThread());
+}
+
+bool FDualMeshParallel::ShouldRunSerial()
+{
+	return CVarDualMeshForceSerial.GetValueOnAnyThread() != 0;
+}
@@ -152,6 +152,109 @@ void UPoissonDiscUtilities::Distribute2D(TArray<FVector2D>& Samples, int32 Seed,
 	delete v2DSamples; delete v2DList;
 }
 
+void UPoissonDiscUtilities::DistributeVariable2D(TArray<FVector2D>& Samples, int32 Seed, FVector2D Size, FVector2D StartLocation, float MinimumDistance, TFunctionRef<float(const FVector2D&)> GetDistance, int32 MaxStepSamples)
+{
+	if (MinimumDistance <= 0.0f || Size.X <= 0.0f || Size.Y <= 0.0f)
+	{
+		return;
+	}
+	FRandomStream rng = FRandomStream(Seed);
+
+	// No two samples are ever closer than MinimumDistance, so each cell holds at most one sample
+	const float cellSize = MinimumDistance / FMath::Sqrt(2.0f);
+	const int32 cellsX = FMath::Max(1, FMath::CeilToInt(Size.X / cellSize));
+	const int32 cellsY = FMath::Max(1, FMath::CeilToInt(Size.Y / cellSize));
+	TArray<int32> grid;
+	grid.Init(INDEX_NONE, cellsX * cellsY);
+
+	TArray<FVector2D> points;
+	TArray<float> distances;
+	TArray<int32> active;
+
+	auto getCell = [&](const FVector2D& Point, int32& OutX, int32& OutY)
+	{
+		OutX = FMath::Clamp(FMath::FloorToInt(Point.X / cellSize), 0, cellsX - 1);
+		OutY = FMath::Clamp(FMath::FloorToInt(Point.Y / cellSize), 0, cellsY - 1);
+	};
+	auto getDistance = [&](const FVector2D& Point)
+	{
+		return FMath::Max(MinimumDistance, GetDistance(Point + StartLocation));
+	};
+	auto addSample = [&](const FVector2D& Point, float Distance)
+	{
+		int32 x, y;
+		getCell(Point, x, y);
+		const int32 index = points.Add(Point);
+		distances.Add(Distance);
+		grid[y * cellsX + x] = index;
+		active.Add(index);
+	};
+
+	const FVector2D start = FVector2D(rng.FRandRange(0, Size.X), rng.FRandRange(0, Size.Y));
+	addSample(start, getDistance(start));
+
+	while (active.Num() > 0)
+	{
+		const int32 activeIndex = rng.RandRange(0, active.Num() - 1);
+		const FVector2D origin = points[active[activeIndex]];
+		const float originDistance = distances[active[activeIndex]];
+
+		bool bIsSuccessful = false;
+		for (int32 i = 0; i < MaxStepSamples; i++)
+		{
+			const float angle = rng.FRandRange(0.0f, 2.0f * PI);
+			const float radius = rng.FRandRange(1.0f, 2.0f) * originDistance;
+			const FVector2D sample = origin + FVector2D(radius * FMath::Cos(angle), radius * FMath::Sin(angle));
+			if (sample.X < 0.0f || sample.X > Size.X || sample.Y < 0.0f || sample.Y > Size.Y)
+			{
+				continue;
+			}
+
+			// A sample only has to keep its own distance from the others,
+			// so the search never has to reach further than that
+			const float distance = getDistance(sample);
+			const int32 reach = FMath::CeilToInt(distance / cellSize);
+			int32 x, y;
+			getCell(sample, x, y);
+			bool bTooClose = false;
+			for (int32 cellY = FMath::Max(0, y - reach); cellY <= FMath::Min(cellsY - 1, y + reach) && !bTooClose; cellY++)
+			{
+				for (int32 cellX = FMath::Max(0, x - reach); cellX <= FMath::Min(cellsX - 1, x + reach); cellX++)
+				{
+					const int32 other = grid[cellY * cellsX + cellX];
+					if (other != INDEX_NONE && FVector2D::DistSquared(points[other], sample) < distance * distance)
+					{
+						bTooClose = true;
+						break;
+					}
+				}
+			}
+
+			if (!bTooClose)
+			{
+				addSample(sample, distance);
+				bIsSuccessful = true;
+			}
+		}
+
+		// If we weren't successful in generating any new points, remove this point from the working list.
+		if (!bIsSuccessful)
+		{
+			active.RemoveAtSwap(activeIndex);
+		}
+	}
+
+	// Hand the samples back in grid order, so points that are close together stay close together in memory
+	Samples.Reserve(Samples.Num() + points.Num());
+	for (int32 index : grid)
+	{
+		if (index != INDEX_NONE)
+		{
+			Samples.Add(points[index] + StartLocation);
+		}
+	}
+}
+
 void UPoissonDiscUtilities::Distribute3D(TArray<FVector>& Samples, int32 Seed /* = 0 */, FVector Size /* = FVector2D(1.0f , 1.0f) */, float MinimumDistance /* = 1.0f */, int32 MaxStepSamples /* = 30 */, bool WrapX /* = false */, bool WrapY /* = false */, bool WrapZ /* = false */)
 {
 	uint64 iCells, iCellsX, iCellsY, iCellsZ, iCell, iCellX, iCellY, iCellZ;
@@ -27,15 +27,23 @@
 #include "Delaunator/Public/DelaunayHelper.h"
 
 #include "RandomSampling/PoissonDiscUtilities.h"
+#include "DualMeshCache.h"
+#include "DualMeshDistanceField.h"
 #include "TriangleDualMesh.h"
 
 #define BAD_ANGLE_LIMIT 20.0f
 
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPoissonSamplingTest, "Procedural Generation.Poisson Disk Sampling.Check Sampling", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::LowPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVariablePoissonSamplingTest, "Procedural Generation.Poisson Disk Sampling.Check Variable Sampling", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::LowPriority)
 
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPointInequalityTest, "Procedural Generation.DualMesh.Check Point Inequality", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::LowPriority)
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTriangleInequalityTest, "Procedural Generation.DualMesh.Check Triangle Inequality", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMeshConnectivityTest, "Procedural Generation.DualMesh.Check Region Circulation", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGhostStructureTest, "Procedural Generation.DualMesh.Check Ghost Structure", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPointLocationTest, "Procedural Generation.DualMesh.Check Point Location", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBarycentricSamplingTest, "Procedural Generation.DualMesh.Check Barycentric Sampling", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDistanceFieldTest, "Procedural Generation.DualMesh.Check Distance Field", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMeshCacheTest, "Procedural Generation.DualMesh.Check Mesh Cache", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
 
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FConstructDualMeshTest, "Procedural Generation.DualMesh.Construct Dual Mesh", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::HighPriority)
 
@@ -107,6 +115,61 @@ bool FPoissonSamplingTest::RunTest(const FString& Parameters)
 	return true;
 }
 
+bool FVariablePoissonSamplingTest::RunTest(const FString& Parameters)
+{
+	// Tightly packed on the left half, loosely packed on the right half
+	FVector2D size = FVector2D(1000.0f, 1000.0f);
+	auto getDistance = [](const FVector2D& Point)
+	{
+		return Point.X < 500.0f ? 10.0f : 40.0f;
+	};
+
+	TArray<FVector2D> points;
+	UPoissonDiscUtilities::DistributeVariable2D(points, 0, size, FVector2D::ZeroVector, 10.0f, getDistance);
+
+	UE_LOG(LogDualMesh, Log, TEXT("Generated %d variable poisson-distributed points"), points.Num());
+
+	if (points.Num() == 0)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("PoissonDisc didn't distribute any points!"));
+		return false;
+	}
+
+	int32 leftCount = 0;
+	for (int i = 0; i < points.Num(); i++)
+	{
+		FVector2D point = points[i];
+		if (point.X < 0.0f || point.Y < 0.0f || point.X > size.X || point.Y > size.Y)
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("PoissonDisc generated out of bounds point!"));
+			return false;
+		}
+		if (point.X < 500.0f)
+		{
+			leftCount++;
+		}
+
+		for (int j = i + 1; j < points.Num(); j++)
+		{
+			// Whichever point came second had to keep its own distance from the first,
+			// so every pair is at least the smaller of their two distances apart
+			float minDistance = FMath::Min(getDistance(point), getDistance(points[j]));
+			if (FVector2D::Distance(point, points[j]) < minDistance)
+			{
+				UE_LOG(LogDualMesh, Error, TEXT("PoissonDisc generated points too close together: (%f, %f) and (%f, %f)"), point.X, point.Y, points[j].X, points[j].Y);
+				return false;
+			}
+		}
+	}
+
+	if (leftCount <= points.Num() - leftCount)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("The tightly packed half only got %d of %d points!"), leftCount, points.Num());
+		return false;
+	}
+	return true;
+}
+
 bool FPointInequalityTest::RunTest(const FString& Parameters)
 {
 	FDelaunayMesh graph = FDelaunayMesh(GeneratePoints());
@@ -285,8 +348,410 @@ bool FMeshConnectivityTest::RunTest(const FString& Parameters)
 	return true;
 }
 
+bool FGhostStructureTest::RunTest(const FString& Parameters)
+{
+	FVector2D size = FVector2D(1000.0f, 1000.0f);
+	TArray<FVector2D> points = GeneratePoints();
+	FDualMesh mesh = FDualMesh(points, size);
+
+	// Build the ghost structure the old way, by copying everything into new arrays,
+	// and make sure the in-place version comes up with the exact same topology
+	FDelaunayMesh graph = FDelaunayMesh(points);
+	const int32 numSolidSides = graph.DelaunayTriangles.Num();
+	const FPointIndex ghostRegion = graph.Coordinates.Num();
+	int32 numUnpairedSides = 0;
+	FSideIndex firstUnpairedEdge = FSideIndex();
+	TArray<FSideIndex> regionsUnpairedSides;
+	regionsUnpairedSides.SetNumZeroed(graph.Coordinates.Num());
+	for (FSideIndex i = 0; i < numSolidSides; i++)
+	{
+		if (!graph.HalfEdges[i].IsValid())
+		{
+			numUnpairedSides++;
+			regionsUnpairedSides[graph.DelaunayTriangles[i]] = i;
+			firstUnpairedEdge = i;
+		}
+	}
+
+	TArray<FVector2D> expectedVertices = graph.Coordinates;
+	expectedVertices.Add(FVector2D(size.X / 2.0f, size.Y / 2.0f));
+	TArray<FPointIndex> expectedStartRegions = graph.DelaunayTriangles;
+	expectedStartRegions.SetNumZeroed(numSolidSides + 3 * numUnpairedSides);
+	TArray<FSideIndex> expectedOppositeSides = graph.HalfEdges;
+	expectedOppositeSides.SetNumZeroed(numSolidSides + 3 * numUnpairedSides);
+
+	FSideIndex s = firstUnpairedEdge;
+	for (int i = 0; i < numUnpairedSides; i++)
+	{
+		FSideIndex ghostSide = numSolidSides + 3 * i;
+		expectedOppositeSides[s] = ghostSide;
+		expectedOppositeSides[ghostSide] = s;
+		expectedStartRegions[ghostSide] = expectedStartRegions[UTriangleDualMesh::s_next_s(s)];
+		expectedStartRegions[ghostSide + 1] = expectedStartRegions[s];
+		expectedStartRegions[ghostSide + 2] = ghostRegion;
+		int k = numSolidSides + (3 * i + 4) % (3 * numUnpairedSides);
+		expectedOppositeSides[ghostSide + 2] = k;
+		expectedOppositeSides[k] = ghostSide + 2;
+		s = regionsUnpairedSides[expectedStartRegions[UTriangleDualMesh::s_next_s(s)]];
+	}
+
+	if (mesh.NumSolidSides != numSolidSides)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Expected %d solid sides, but the mesh had %d!"), numSolidSides, mesh.NumSolidSides);
+		return false;
+	}
+	if (mesh.Coordinates != expectedVertices)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Ghost structure regions did not match! Expected %d regions, got %d."), expectedVertices.Num(), mesh.Coordinates.Num());
+		return false;
+	}
+	if (mesh.DelaunayTriangles.Num() != expectedStartRegions.Num() || mesh.HalfEdges.Num() != expectedOppositeSides.Num())
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Expected %d sides, but the mesh had %d!"), expectedStartRegions.Num(), mesh.DelaunayTriangles.Num());
+		return false;
+	}
+	for (int32 i = 0; i < expectedStartRegions.Num(); i++)
+	{
+		if (mesh.DelaunayTriangles[i] != expectedStartRegions[i] || mesh.HalfEdges[i] != expectedOppositeSides[i])
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Side %d did not match! Expected region %d and opposite %d, got region %d and opposite %d."), i, (int32)expectedStartRegions[i], (int32)expectedOppositeSides[i], (int32)mesh.DelaunayTriangles[i], (int32)mesh.HalfEdges[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
 bool FConstructDualMeshTest::RunTest(const FString& Parameters)
 {
 	UTriangleDualMesh* mesh = GenerateMeshBuilder();
 	return mesh != NULL;
+}
+
+bool FMeshCacheTest::RunTest(const FString& Parameters)
+{
+	FDateTime buildStart = FDateTime::UtcNow();
+	UTriangleDualMesh* mesh = GenerateMeshBuilder();
+	FTimespan buildTime = FDateTime::UtcNow() - buildStart;
+	if (mesh == NULL)
+	{
+		return false;
+	}
+
+	const FString key = TEXT("Mesh Cache Test");
+	TArray<uint8> bytes;
+	FDualMeshCache::Serialize(mesh, key, 42, bytes);
+
+	FDateTime loadStart = FDateTime::UtcNow();
+	int32 rngSteps = 0;
+	UTriangleDualMesh* loaded = FDualMeshCache::Deserialize(bytes.GetData(), bytes.Num(), key, rngSteps);
+	FTimespan loadTime = FDateTime::UtcNow() - loadStart;
+	if (loaded == NULL)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Could not read back a serialized mesh!"));
+		return false;
+	}
+	UE_LOG(LogDualMesh, Display, TEXT("Building the mesh took %f seconds, loading %d bytes of it took %f seconds."), buildTime.GetTotalSeconds(), bytes.Num(), loadTime.GetTotalSeconds());
+
+	const FDualMesh& expected = mesh->GetRawMesh();
+	const FDualMesh& actual = loaded->GetRawMesh();
+	if (rngSteps != 42 || loaded->NumBoundaryRegions != mesh->NumBoundaryRegions || actual.NumSolidSides != expected.NumSolidSides || actual.MaxSize != expected.MaxSize)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Mesh cache header did not match!"));
+		return false;
+	}
+	if (actual.Coordinates != expected.Coordinates || actual.PointToEdge != expected.PointToEdge)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Mesh cache regions did not match!"));
+		return false;
+	}
+	if (actual.DelaunayTriangles.Num() != expected.DelaunayTriangles.Num() || actual.HalfEdges.Num() != expected.HalfEdges.Num())
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Expected %d sides, but the cached mesh had %d!"), expected.DelaunayTriangles.Num(), actual.DelaunayTriangles.Num());
+		return false;
+	}
+	for (int32 i = 0; i < expected.DelaunayTriangles.Num(); i++)
+	{
+		if (actual.DelaunayTriangles[i] != expected.DelaunayTriangles[i] || actual.HalfEdges[i] != expected.HalfEdges[i])
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Cached side %d did not match!"), i);
+			return false;
+		}
+	}
+	if (loaded->NumRegions != mesh->NumRegions || loaded->NumTriangles != mesh->NumTriangles || loaded->NumSolidRegions != mesh->NumSolidRegions)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Cached mesh did not rebuild the same derived data!"));
+		return false;
+	}
+
+	// A different key or a single flipped byte should both be turned away
+	if (FDualMeshCache::Deserialize(bytes.GetData(), bytes.Num(), TEXT("Some Other Key"), rngSteps) != NULL)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Mesh cache accepted the wrong key!"));
+		return false;
+	}
+
+	// So should indices outside the mesh, even with a good checksum
+	TArray<uint8> badBytes;
+	FDualMesh& rawMesh = mesh->GetRawMesh();
+	const FSideIndex oldHalfEdge = rawMesh.HalfEdges[0];
+	rawMesh.HalfEdges[0] = rawMesh.HalfEdges.Num();
+	FDualMeshCache::Serialize(mesh, key, 42, badBytes);
+	rawMesh.HalfEdges[0] = oldHalfEdge;
+	if (FDualMeshCache::Deserialize(badBytes.GetData(), badBytes.Num(), key, rngSteps) != NULL)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Mesh cache accepted a side pointing outside the mesh!"));
+		return false;
+	}
+	bytes[bytes.Num() / 2] ^= 0xFF;
+	if (FDualMeshCache::Deserialize(bytes.GetData(), bytes.Num(), key, rngSteps) != NULL)
+	{
+		UE_LOG(LogDualMesh, Error, TEXT("Mesh cache accepted corrupt data!"));
+		return false;
+	}
+	return true;
+}
+
+bool FPointLocationTest::RunTest(const FString& Parameters)
+{
+	UTriangleDualMesh* mesh = GenerateMeshBuilder();
+	if (mesh == NULL)
+	{
+		return false;
+	}
+
+	FRandomStream rng(0);
+	TArray<FVector2D> positions;
+	positions.SetNumUninitialized(10000);
+	for (int32 i = 0; i < positions.Num(); i++)
+	{
+		positions[i] = FVector2D(rng.FRandRange(0.0f, 1000.0f), rng.FRandRange(0.0f, 1000.0f));
+	}
+
+	const TArray<FVector2D>& points = mesh->GetPoints();
+	for (const FVector2D& position : positions)
+	{
+		FPointIndex expected;
+		float expectedDistance = MAX_flt;
+		for (int32 r = 0; r < mesh->NumSolidRegions; r++)
+		{
+			const float distance = FVector2D::DistSquared(points[r], position);
+			if (distance < expectedDistance)
+			{
+				expected = r;
+				expectedDistance = distance;
+			}
+		}
+		const FPointIndex region = mesh->FindRegionAt(position);
+		if (!region.IsValid() || FVector2D::DistSquared(points[region], position) > expectedDistance)
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Closest region to (%f, %f) should have been %d, but we found %d!"), position.X, position.Y, (int32)expected, (int32)region);
+			return false;
+		}
+
+		const FTriangleIndex t = mesh->FindTriangleAt(position);
+		if (t.IsValid())
+		{
+			const FDelaunayTriangle triangle = mesh->t_triangle(t);
+			const FVector2D& a = points[triangle.AIndex];
+			const FVector2D& b = points[triangle.BIndex];
+			const FVector2D& c = points[triangle.CIndex];
+			const float orientation = (b - a) ^ (c - a);
+			if (((b - a) ^ (position - a)) * orientation < -KINDA_SMALL_NUMBER || ((c - b) ^ (position - b)) * orientation < -KINDA_SMALL_NUMBER
+				|| ((a - c) ^ (position - c)) * orientation < -KINDA_SMALL_NUMBER)
+			{
+				UE_LOG(LogDualMesh, Error, TEXT("Triangle %d doesn't contain (%f, %f)!"), (int32)t, position.X, position.Y);
+				return false;
+			}
+		}
+	}
+
+	// Benchmark single lookups against batched ones
+	FDateTime startTime = FDateTime::UtcNow();
+	int32 found = 0;
+	for (const FVector2D& position : positions)
+	{
+		found += mesh->FindRegionAt(position).IsValid() ? 1 : 0;
+	}
+	FTimespan singleTime = FDateTime::UtcNow() - startTime;
+
+	// Sort positions along rows, the way a game would usually ask for them
+	positions.Sort([](const FVector2D& A, const FVector2D& B)
+	{
+		const int32 rowA = FMath::FloorToInt(A.Y / 10.0f);
+		const int32 rowB = FMath::FloorToInt(B.Y / 10.0f);
+		return rowA != rowB ? rowA < rowB : A.X < B.X;
+	});
+	TArray<FPointIndex> regions;
+	startTime = FDateTime::UtcNow();
+	mesh->FindRegionsAt(positions, regions);
+	FTimespan batchTime = FDateTime::UtcNow() - startTime;
+
+	UE_LOG(LogDualMesh, Display, TEXT("Located %d points: %.0f lookups per second one at a time, %.0f lookups per second batched."), found,
+		positions.Num() / FMath::Max(singleTime.GetTotalSeconds(), 1e-6), positions.Num() / FMath::Max(batchTime.GetTotalSeconds(), 1e-6));
+	return regions.Num() == positions.Num() && !regions.Contains(FPointIndex());
+}
+
+bool FBarycentricSamplingTest::RunTest(const FString& Parameters)
+{
+	UTriangleDualMesh* mesh = GenerateMeshBuilder();
+	if (mesh == NULL)
+	{
+		return false;
+	}
+
+	// Interpolating a linear function should give back that function exactly
+	const TArray<FVector2D>& points = mesh->GetPoints();
+	TArray<float> r_value;
+	r_value.SetNumUninitialized(points.Num());
+	for (int32 r = 0; r < points.Num(); r++)
+	{
+		r_value[r] = 0.25f * points[r].X - 0.5f * points[r].Y + 10.0f;
+	}
+
+	FRandomStream rng(0);
+	TArray<FVector2D> positions;
+	positions.SetNumUninitialized(100000);
+	for (int32 i = 0; i < positions.Num(); i++)
+	{
+		positions[i] = FVector2D(rng.FRandRange(0.0f, 1000.0f), rng.FRandRange(0.0f, 1000.0f));
+	}
+	positions.Sort([](const FVector2D& A, const FVector2D& B)
+	{
+		const int32 rowA = FMath::FloorToInt(A.Y / 10.0f);
+		const int32 rowB = FMath::FloorToInt(B.Y / 10.0f);
+		return rowA != rowB ? rowA < rowB : A.X < B.X;
+	});
+
+	FDateTime startTime = FDateTime::UtcNow();
+	TArray<FTriangleIndex> triangles;
+	mesh->FindTrianglesAt(positions, triangles);
+	const TArray<FPointIndex>& corners = mesh->GetRawMesh().DelaunayTriangles;
+	TArray<float> samples;
+	samples.SetNumZeroed(positions.Num());
+	for (int32 i = 0; i < positions.Num(); i++)
+	{
+		const FTriangleIndex t = triangles[i];
+		if (t.IsValid())
+		{
+			const FVector weights = mesh->t_barycentric(t, positions[i]);
+			samples[i] = weights.X * r_value[corners[3 * t]] + weights.Y * r_value[corners[3 * t + 1]] + weights.Z * r_value[corners[3 * t + 2]];
+		}
+	}
+	FTimespan sampleTime = FDateTime::UtcNow() - startTime;
+
+	for (int32 i = 0; i < positions.Num(); i++)
+	{
+		if (!triangles[i].IsValid())
+		{
+			continue;
+		}
+		const float expected = 0.25f * positions[i].X - 0.5f * positions[i].Y + 10.0f;
+		if (!FMath::IsNearlyEqual(samples[i], expected, 0.01f))
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Sampled %f at (%f, %f), but expected %f!"), samples[i], positions[i].X, positions[i].Y, expected);
+			return false;
+		}
+	}
+
+	UE_LOG(LogDualMesh, Display, TEXT("Sampled %d points at %.0f samples per second."), positions.Num(), positions.Num() / FMath::Max(sampleTime.GetTotalSeconds(), 1e-6));
+	return true;
+}
+
+bool FDistanceFieldTest::RunTest(const FString& Parameters)
+{
+	UTriangleDualMesh* mesh = GenerateMeshBuilder();
+	if (mesh == NULL)
+	{
+		return false;
+	}
+
+	// Block a vertical wall through the middle of the map, apart from a gap at the top
+	auto sideWeight = [mesh](FSideIndex s)
+	{
+		const FVector2D begin = mesh->r_pos(mesh->s_begin_r(s));
+		const FVector2D end = mesh->r_pos(mesh->s_end_r(s));
+		const bool bCrossesWall = (begin.X < 500.0f) != (end.X < 500.0f) && begin.Y < 800.0f;
+		return bCrossesWall ? -1.0f : 1.0f;
+	};
+
+	TArray<FPointIndex> seeds;
+	seeds.Add(mesh->FindRegionAt(FVector2D(100.0f, 100.0f)));
+	seeds.Add(mesh->FindRegionAt(FVector2D(900.0f, 500.0f)));
+
+	FDateTime startTime = FDateTime::UtcNow();
+	TArray<float> distances;
+	TArray<FSideIndex> parents;
+	FDualMeshDistanceField::ComputeRegionDistances(mesh, seeds, sideWeight, distances, &parents);
+	FTimespan fieldTime = FDateTime::UtcNow() - startTime;
+
+	// Plain Dijkstra to check against
+	startTime = FDateTime::UtcNow();
+	TArray<float> expected;
+	expected.Init(MAX_flt, mesh->NumRegions);
+	TArray<TPair<float, int32>> heap;
+	auto heapPredicate = [](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; };
+	for (FPointIndex seed : seeds)
+	{
+		expected[seed] = 0.0f;
+		heap.HeapPush(TPair<float, int32>(0.0f, seed), heapPredicate);
+	}
+	while (heap.Num() > 0)
+	{
+		TPair<float, int32> current;
+		heap.HeapPop(current, heapPredicate);
+		if (current.Key > expected[current.Value])
+		{
+			continue;
+		}
+		for (FSideIndex s : mesh->r_circulate_s(current.Value))
+		{
+			const FPointIndex neighbor = mesh->s_end_r(s);
+			if (mesh->r_ghost(neighbor) || sideWeight(s) < 0.0f)
+			{
+				continue;
+			}
+			const float distance = current.Key + FVector2D::Distance(mesh->r_pos(current.Value), mesh->r_pos(neighbor));
+			if (distance < expected[neighbor])
+			{
+				expected[neighbor] = distance;
+				heap.HeapPush(TPair<float, int32>(distance, neighbor), heapPredicate);
+			}
+		}
+	}
+	FTimespan dijkstraTime = FDateTime::UtcNow() - startTime;
+
+	for (int32 r = 0; r < mesh->NumRegions; r++)
+	{
+		const float expectedDistance = expected[r] == MAX_flt ? -1.0f : expected[r];
+		if (!FMath::IsNearlyEqual(distances[r], expectedDistance, 0.01f))
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Region %d should have been %f away from a seed, but it was %f!"), r, expectedDistance, distances[r]);
+			return false;
+		}
+		// Following a region's parent should take us one edge closer to a seed
+		if (parents[r].IsValid())
+		{
+			const FPointIndex parent = mesh->s_end_r(parents[r]);
+			if ((int32)mesh->s_begin_r(parents[r]) != r || !FMath::IsNearlyEqual(distances[parent] + FVector2D::Distance(mesh->r_pos(r), mesh->r_pos(parent)), distances[r], 0.01f))
+			{
+				UE_LOG(LogDualMesh, Error, TEXT("Region %d has a parent side which doesn't lead back toward a seed!"), r);
+				return false;
+			}
+		}
+	}
+
+	// Tiny buckets shouldn't change the answer
+	TArray<float> smallBucketDistances;
+	FDualMeshDistanceField::ComputeRegionDistances(mesh, seeds, sideWeight, smallBucketDistances, NULL, 1.0f);
+	for (int32 r = 0; r < mesh->NumRegions; r++)
+	{
+		if (!FMath::IsNearlyEqual(distances[r], smallBucketDistances[r], 0.01f))
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Region %d was %f away with small buckets, but %f away with default buckets!"), r, smallBucketDistances[r], distances[r]);
+			return false;
+		}
+	}
+
+	UE_LOG(LogDualMesh, Display, TEXT("Found distances to %d regions in %f ms, against %f ms for a serial Dijkstra search."), mesh->NumRegions, fieldTime.GetTotalMilliseconds(), dijkstraTime.GetTotalMilliseconds());
+	return true;
 }
\ No newline at end of file
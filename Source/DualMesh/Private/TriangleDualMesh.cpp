@@ -21,13 +21,16 @@
 #include "TriangleDualMesh.h"
 #include "DrawDebugHelpers.h"
 #include "GameFramework/Actor.h"
+#include "DualMeshParallel.h"
 
 FDualMesh::FDualMesh(const TArray<FVector2D>& GivenPoints, const FVector2D& MaxMapSize)
-	: FDelaunayMesh(GivenPoints)
+	: FDelaunayMesh(GivenPoints, true)
 {
 	MaxSize = MaxMapSize;
 	NumSolidSides = DelaunayTriangles.Num();
 	AddGhostStructure();
+	// The ghost structure pairs up every side, so the index is built afterwards
+	BuildPointToEdge();
 
 	UE_LOG(LogDualMesh, Log, TEXT("Final dual mesh had %d solid sides and a map size of %f, %f."), NumSolidSides, MaxSize.X, MaxSize.Y);
 }
@@ -38,7 +41,7 @@ void FDualMesh::AddGhostStructure()
 	int32 numUnpairedSides = 0;
 	FPointIndex firstUnpairedEdge = FPointIndex();
 	TArray<FPointIndex> regionsUnpairedSides;
-	regionsUnpairedSides.SetNumZeroed(NumSolidSides);
+	regionsUnpairedSides.SetNumZeroed(ghostRegion);
 	for (FPointIndex i = 0; i < NumSolidSides; i++)
 	{
 		if (!HalfEdges[i].IsValid())
@@ -49,42 +52,40 @@ void FDualMesh::AddGhostStructure()
 		}
 	}
 
-	TArray<FVector2D> newVertices;
-	newVertices.Append(Coordinates);
-	newVertices.Add(FVector2D(MaxSize.X / 2.0f, MaxSize.Y / 2.0f));
-
-	TArray<FPointIndex> sideNewStartRegions;
-	sideNewStartRegions.Append(DelaunayTriangles);
-	sideNewStartRegions.SetNumZeroed(NumSolidSides + 3 * numUnpairedSides);
-
-	TArray<FSideIndex> sideNewOppositeSides;
-	sideNewOppositeSides.Append(HalfEdges);
-	sideNewOppositeSides.SetNumZeroed(NumSolidSides + 3 * numUnpairedSides);
+	// Grow the arrays in place.
+	// CreatePoints() already reserved enough space for this, so
+	// none of these should need to reallocate.
+	Coordinates.Add(FVector2D(MaxSize.X / 2.0f, MaxSize.Y / 2.0f));
+	DelaunayTriangles.AddZeroed(3 * numUnpairedSides);
+	HalfEdges.AddZeroed(3 * numUnpairedSides);
 
 	int s = firstUnpairedEdge;
 	for (int i = 0; i < numUnpairedSides; i++)
 	{
 		// Construct a ghost side for s
 		FSideIndex ghostSide = NumSolidSides + 3 * i;
-		sideNewOppositeSides[s] = ghostSide;
-		sideNewOppositeSides[ghostSide] = s;
-		sideNewStartRegions[ghostSide] = sideNewStartRegions[UTriangleDualMesh::s_next_s(s)];
+		HalfEdges[s] = ghostSide;
+		HalfEdges[ghostSide] = s;
+		DelaunayTriangles[ghostSide] = DelaunayTriangles[UTriangleDualMesh::s_next_s(s)];
 
 		// Construct the rest of the ghost triangle
-		sideNewStartRegions[ghostSide + 1] = sideNewStartRegions[s];
-		sideNewStartRegions[ghostSide + 2] = ghostRegion;
+		DelaunayTriangles[ghostSide + 1] = DelaunayTriangles[s];
+		DelaunayTriangles[ghostSide + 2] = ghostRegion;
 
 		int k = NumSolidSides + (3 * i + 4) % (3 * numUnpairedSides);
-		sideNewOppositeSides[ghostSide + 2] = k;
-		sideNewOppositeSides[k] = ghostSide + 2;
+		HalfEdges[ghostSide + 2] = k;
+		HalfEdges[k] = ghostSide + 2;
 
-		s = regionsUnpairedSides[sideNewStartRegions[UTriangleDualMesh::s_next_s(s)]];
+		s = regionsUnpairedSides[DelaunayTriangles[UTriangleDualMesh::s_next_s(s)]];
 	}
+}
 
-	// Put the new arrays back into this structure
-	Coordinates = newVertices;
-	DelaunayTriangles = sideNewStartRegions;
-	HalfEdges = sideNewOppositeSides;
+UTriangleDualMesh::UTriangleDualMesh()
+{
+	bHasTriangleWaterCache = false;
+	_grid_width = 0;
+	_grid_height = 0;
+	_grid_cell_size = FVector2D::ZeroVector;
 }
 
 FTriangleIndex UTriangleDualMesh::s_to_t(FSideIndex s)
@@ -124,9 +125,9 @@ float UTriangleDualMesh::t_y(FTriangleIndex t) const
 
 FVector2D UTriangleDualMesh::r_pos(FPointIndex r) const
 {
-	if(_r_vertex.IsValidIndex(r))
+	if(Mesh.Coordinates.IsValidIndex(r))
 	{
-		return _r_vertex[r];
+		return Mesh.Coordinates[r];
 	}
 	else
 	{
@@ -148,7 +149,14 @@ FVector2D UTriangleDualMesh::t_pos(FTriangleIndex t) const
 
 FPointIndex UTriangleDualMesh::s_begin_r(FSideIndex s) const
 {
-	return UDelaunayHelper::GetPointIndexFromHalfEdge(Mesh, s);
+	if (Mesh.DelaunayTriangles.IsValidIndex(s))
+	{
+		return Mesh.DelaunayTriangles[s];
+	}
+	else
+	{
+		return FPointIndex();
+	}
 }
 
 FPointIndex UTriangleDualMesh::s_end_r(FSideIndex s) const
@@ -163,6 +171,10 @@ FTriangleIndex UTriangleDualMesh::s_inner_t(FSideIndex s) const
 
 FTriangleIndex UTriangleDualMesh::s_outer_t(FSideIndex s) const
 {
+	if (_t_neighbors.IsValidIndex(s))
+	{
+		return FTriangleIndex(_t_neighbors[s]);
+	}
 	return UTriangleDualMesh::s_to_t(s_opposite_s(s));
 }
 
@@ -171,6 +183,24 @@ FSideIndex UTriangleDualMesh::s_opposite_s(FSideIndex s) const
 	return UDelaunayHelper::OppositeHalfEdge(Mesh, s);
 }
 
+FSideIndex UTriangleDualMesh::r_in_s(FPointIndex r) const
+{
+	if (!Mesh.PointToEdge.IsValidIndex(r) || Mesh.PointToEdge[r] == INDEX_NONE)
+	{
+		return FSideIndex();
+	}
+	return FSideIndex(Mesh.PointToEdge[r]);
+}
+
+FDelaunayTriangle UTriangleDualMesh::t_triangle(FTriangleIndex t) const
+{
+	if (t >= (SIZE_T)NumTriangles)
+	{
+		return FDelaunayTriangle();
+	}
+	return UDelaunayHelper::ConvertTriangleIDToTriangle(Mesh, t * 3);
+}
+
 TArray<FSideIndex> UTriangleDualMesh::t_circulate_s(FTriangleIndex t) const
 {
 	return UDelaunayHelper::EdgesOfTriangle(t * 3);
@@ -183,7 +213,7 @@ TArray<FPointIndex> UTriangleDualMesh::t_circulate_r(FTriangleIndex t) const
 	out_r.SetNum(3);
 	for (int i = 0; i < 3; i++) 
 	{ 
-		out_r[i] = UDelaunayHelper::GetPointIndexFromHalfEdge(Mesh, out_s[i]);
+		out_r[i] = s_begin_r(out_s[i]);
 	} 
 	return out_r;
 }
@@ -203,22 +233,22 @@ TArray<FTriangleIndex> UTriangleDualMesh::t_circulate_t(FTriangleIndex t) const
 TArray<FSideIndex> UTriangleDualMesh::r_circulate_s(FPointIndex r) const
 {
 	TArray<FSideIndex> out_s;
-	if(!_r_in_s.Contains(r))
+	const FSideIndex s0 = r_in_s(r);
+	if (!s0.IsValid())
 	{
 		UE_LOG(LogDualMesh, Warning, TEXT("Region list did not contain point %d!"), r);
 		return out_s;
 	}
 
-	const FSideIndex s0 = _r_in_s[r];
 	FSideIndex incoming = s0;
 	do
 	{
-		if (!_halfedges.IsValidIndex(incoming))
+		if (!Mesh.HalfEdges.IsValidIndex(incoming))
 		{
 			UE_LOG(LogDualMesh, Error, TEXT("Incoming side was invalid!"));
 			return out_s;
 		}
-		FSideIndex next = _halfedges[incoming];
+		FSideIndex next = Mesh.HalfEdges[incoming];
 		if (!next.IsValid())
 		{
 			UE_LOG(LogDualMesh, Error, TEXT("Next side was invalid!"));
@@ -226,7 +256,7 @@ TArray<FSideIndex> UTriangleDualMesh::r_circulate_s(FPointIndex r) const
 		}
 		out_s.Add(next);
 		FSideIndex outgoing = UTriangleDualMesh::s_next_s(incoming);
-		incoming = _halfedges[outgoing];
+		incoming = Mesh.HalfEdges[outgoing];
 	} while (incoming.IsValid() && incoming != s0);
 	return out_s;
 }
@@ -234,45 +264,38 @@ TArray<FSideIndex> UTriangleDualMesh::r_circulate_s(FPointIndex r) const
 TArray<FPointIndex> UTriangleDualMesh::r_circulate_r(FPointIndex r) const
 {
 	TArray<FPointIndex> out_r;
-	if (!_r_in_s.Contains(r))
+	const FSideIndex s0 = r_in_s(r);
+	if (!s0.IsValid())
 	{
 		UE_LOG(LogDualMesh, Warning, TEXT("Region list did not contain point %d!"), r);
 		return out_r;
 	}
 
-	const FSideIndex s0 = _r_in_s[r];
-	if (s0.IsValid())
-	{
-		FSideIndex incoming = s0;
-		do {
-			FPointIndex next = s_begin_r(incoming);
-			if (!next.IsValid())
-			{
-				UE_LOG(LogDualMesh, Error, TEXT("Next region was invalid!"));
-				return out_r;
-			}
-			out_r.Add(next);
-			FSideIndex outgoing = UTriangleDualMesh::s_next_s(incoming);
-			incoming = _halfedges[outgoing];
-		} while (incoming.IsValid() && incoming != s0);
-	}
-	else
-	{
-		UE_LOG(LogDualMesh, Warning, TEXT("Attempted to start from an invalid region (%d)."), r);
-	}
+	FSideIndex incoming = s0;
+	do {
+		FPointIndex next = s_begin_r(incoming);
+		if (!next.IsValid())
+		{
+			UE_LOG(LogDualMesh, Error, TEXT("Next region was invalid!"));
+			return out_r;
+		}
+		out_r.Add(next);
+		FSideIndex outgoing = UTriangleDualMesh::s_next_s(incoming);
+		incoming = Mesh.HalfEdges[outgoing];
+	} while (incoming.IsValid() && incoming != s0);
 	return out_r;
 }
 
 TArray<FTriangleIndex> UTriangleDualMesh::r_circulate_t(FPointIndex r) const
 {
 	TArray<FTriangleIndex> out_t;
-	if (!_r_in_s.Contains(r))
+	const FSideIndex s0 = r_in_s(r);
+	if (!s0.IsValid())
 	{
 		UE_LOG(LogDualMesh, Warning, TEXT("Region list did not contain point %d!"), r);
 		return out_t;
 	}
 
-	const FSideIndex s0 = _r_in_s[r];
 	FSideIndex incoming = s0;
 	do
 	{
@@ -284,7 +307,7 @@ TArray<FTriangleIndex> UTriangleDualMesh::r_circulate_t(FPointIndex r) const
 		}
 		out_t.Add(next);
 		FSideIndex outgoing = UTriangleDualMesh::s_next_s(incoming);
-		incoming = _halfedges[outgoing];
+		incoming = Mesh.HalfEdges[outgoing];
 	} while (incoming.IsValid() && incoming != s0);
 	return out_t;
 }
@@ -332,39 +355,64 @@ bool UTriangleDualMesh::r_boundary(FPointIndex r) const
 void UTriangleDualMesh::InitializeMesh(const FDualMesh& Input, int32 BoundaryRegions)
 {
 	Mesh = Input;
+	InitializeDerivedData(BoundaryRegions);
+}
+
+void UTriangleDualMesh::InitializeMesh(FDualMesh&& Input, int32 BoundaryRegions)
+{
+	Mesh = MoveTemp(Input);
+	InitializeDerivedData(BoundaryRegions);
+}
+
+void UTriangleDualMesh::InitializeDerivedData(int32 BoundaryRegions)
+{
 	NumBoundaryRegions = BoundaryRegions;
 	NumSolidSides = Mesh.NumSolidSides;
-	_r_vertex = Mesh.Coordinates;
-	_triangles.SetNum(Mesh.DelaunayTriangles.Num() / 3);
-	for (FTriangleIndex t = 0; t < Mesh.DelaunayTriangles.Num(); t += 3)
-	{
-		_triangles[t / 3] = UDelaunayHelper::ConvertTriangleIDToTriangle(Mesh, t);
-	}
-	_halfedges = Mesh.HalfEdges;
 
-	NumSides = _halfedges.Num();
-	NumRegions = _r_vertex.Num();
+	NumSides = Mesh.HalfEdges.Num();
+	NumRegions = Mesh.Coordinates.Num();
 	NumSolidRegions = NumRegions - 1;
-	NumTriangles = _triangles.Num();
+	NumTriangles = Mesh.DelaunayTriangles.Num() / 3;
 	NumSolidTriangles = NumSolidSides / 3;
 
-	for (FSideIndex s = 0; s < _halfedges.Num(); s++)
+	// Any triangles from a previous mesh are stale now
+	_triangles.Empty();
+	ClearTriangleWaterCache();
+
+	// Every side is paired once the ghost structure is in place,
+	// so every side has a triangle on the other side of it
+	_t_neighbors.SetNumUninitialized(NumSides);
+	for (int32 s = 0; s < NumSides; s++)
+	{
+		_t_neighbors[s] = (int32)(Mesh.HalfEdges[s] / 3);
+	}
+
+	// Bucket the sides by the region they start at
+	_r_side_offsets.SetNumZeroed(NumRegions + 1);
+	for (int32 s = 0; s < NumSides; s++)
+	{
+		_r_side_offsets[Mesh.DelaunayTriangles[s] + 1]++;
+	}
+	for (int32 r = 0; r < NumRegions; r++)
 	{
-		FPointIndex endpoint = UDelaunayHelper::GetPointIndexFromHalfEdge(Mesh, UTriangleDualMesh::s_next_s(s));
-		if (!_r_in_s.Contains(endpoint) || !_halfedges[s].IsValid())
+		_r_side_offsets[r + 1] += _r_side_offsets[r];
+	}
+	_r_sides.SetNumUninitialized(NumSides);
+	{
+		TArray<int32> nextSlot = _r_side_offsets;
+		for (int32 s = 0; s < NumSides; s++)
 		{
-			_r_in_s.Add(endpoint, s);
+			_r_sides[nextSlot[Mesh.DelaunayTriangles[s]]++] = s;
 		}
 	}
 
 	// Construct triangle coordinates
 	_t_vertex.SetNum(NumTriangles);
-	for (FSideIndex s = 0; s < _halfedges.Num(); s += 3)
+	for (FSideIndex s = 0; s < NumSides; s += 3)
 	{
-		FDelaunayTriangle triangle = UDelaunayHelper::GetTriangleFromHalfEdge(Mesh, s);
-		FVector2D a = triangle.A;
-		FVector2D b = triangle.B;
-		FVector2D c = triangle.C;
+		const FVector2D& a = Mesh.Coordinates[Mesh.DelaunayTriangles[s]];
+		const FVector2D& b = Mesh.Coordinates[Mesh.DelaunayTriangles[s + 1]];
+		const FVector2D& c = Mesh.Coordinates[Mesh.DelaunayTriangles[s + 2]];
 
 		if (s_ghost(s))
 		{
@@ -380,6 +428,243 @@ void UTriangleDualMesh::InitializeMesh(const FDualMesh& Input, int32 BoundaryReg
 			_t_vertex[s / 3] = FVector2D((a.X + b.X + c.X) / 3.0f, (a.Y + b.Y + c.Y) / 3.0f);
 		}
 	}
+
+	BuildPointLocationGrid();
+}
+
+void UTriangleDualMesh::BuildPointLocationGrid()
+{
+	_grid_t.Empty();
+	_grid_width = 0;
+	_grid_height = 0;
+	if (NumSolidTriangles <= 0 || Mesh.MaxSize.X <= 0.0f || Mesh.MaxSize.Y <= 0.0f)
+	{
+		return;
+	}
+
+	// Aim for about two triangles per cell, so most walks are only a step or two long
+	const float cellSize = FMath::Sqrt(2.0f * Mesh.MaxSize.X * Mesh.MaxSize.Y / NumSolidTriangles);
+	_grid_width = FMath::Clamp(FMath::CeilToInt(Mesh.MaxSize.X / cellSize), 1, 4096);
+	_grid_height = FMath::Clamp(FMath::CeilToInt(Mesh.MaxSize.Y / cellSize), 1, 4096);
+	_grid_cell_size = FVector2D(Mesh.MaxSize.X / _grid_width, Mesh.MaxSize.Y / _grid_height);
+	_grid_t.Init(-1, _grid_width * _grid_height);
+
+	TArray<int32> frontier;
+	frontier.Reserve(_grid_t.Num());
+	for (int32 t = 0; t < NumSolidTriangles; t++)
+	{
+		const int32 cell = GetGridCell(_t_vertex[t]);
+		if (_grid_t[cell] < 0)
+		{
+			_grid_t[cell] = t;
+			frontier.Add(cell);
+		}
+	}
+
+	// Empty cells borrow the triangle of the closest cell that has one
+	for (int32 i = 0; i < frontier.Num(); i++)
+	{
+		const int32 cell = frontier[i];
+		const int32 x = cell % _grid_width;
+		const int32 y = cell / _grid_width;
+		const int32 neighbors[4] = {
+			x > 0 ? cell - 1 : -1,
+			x < _grid_width - 1 ? cell + 1 : -1,
+			y > 0 ? cell - _grid_width : -1,
+			y < _grid_height - 1 ? cell + _grid_width : -1
+		};
+		for (int32 neighbor : neighbors)
+		{
+			if (neighbor >= 0 && _grid_t[neighbor] < 0)
+			{
+				_grid_t[neighbor] = _grid_t[cell];
+				frontier.Add(neighbor);
+			}
+		}
+	}
+}
+
+int32 UTriangleDualMesh::GetGridCell(const FVector2D& Position) const
+{
+	const int32 x = FMath::Clamp(FMath::FloorToInt(Position.X / _grid_cell_size.X), 0, _grid_width - 1);
+	const int32 y = FMath::Clamp(FMath::FloorToInt(Position.Y / _grid_cell_size.Y), 0, _grid_height - 1);
+	return y * _grid_width + x;
+}
+
+FTriangleIndex UTriangleDualMesh::FindTriangleAt(const FVector2D& Position) const
+{
+	return FindTriangleAt(Position, FTriangleIndex());
+}
+
+FTriangleIndex UTriangleDualMesh::FindTriangleAt(const FVector2D& Position, FTriangleIndex StartTriangle) const
+{
+	if (_grid_t.Num() == 0)
+	{
+		return FTriangleIndex();
+	}
+
+	// Only walk from the start triangle if it's closer than the grid would get us
+	int32 t = -1;
+	if (StartTriangle.IsValid() && StartTriangle < (SIZE_T)NumSolidTriangles)
+	{
+		const float maxStartDistance = 2.0f * (_grid_cell_size.X + _grid_cell_size.Y);
+		if (FVector2D::DistSquared(_t_vertex[StartTriangle], Position) < maxStartDistance * maxStartDistance)
+		{
+			t = (int32)StartTriangle.Value;
+		}
+	}
+	if (t < 0)
+	{
+		t = _grid_t[GetGridCell(Position)];
+	}
+
+	const TArray<FVector2D>& points = Mesh.Coordinates;
+	const TArray<FPointIndex>& triangles = Mesh.DelaunayTriangles;
+	int32 previous = -1;
+	// A straight walk across a Delaunay triangulation can't loop forever,
+	// but cap it anyway in case of degenerate triangles
+	for (int32 step = 0; step < NumSolidTriangles; step++)
+	{
+		const FVector2D* corners[3] = { &points[triangles[3 * t]], &points[triangles[3 * t + 1]], &points[triangles[3 * t + 2]] };
+		const float orientation = (*corners[1] - *corners[0]) ^ (*corners[2] - *corners[0]);
+
+		// Step across any side which has Position on the far side of it,
+		// preferring not to step straight back to the triangle we just left
+		int32 next = -1;
+		for (int32 i = 0; i < 3; i++)
+		{
+			const FVector2D& from = *corners[i];
+			const FVector2D& to = *corners[(i + 1) % 3];
+			if (((to - from) ^ (Position - from)) * orientation < 0.0f)
+			{
+				next = _t_neighbors[3 * t + i];
+				if (next != previous)
+				{
+					break;
+				}
+			}
+		}
+
+		if (next < 0)
+		{
+			return FTriangleIndex(t);
+		}
+		if (next >= NumSolidTriangles)
+		{
+			// Walked out past the hull
+			return FTriangleIndex();
+		}
+		previous = t;
+		t = next;
+	}
+	return FTriangleIndex();
+}
+
+FPointIndex UTriangleDualMesh::FindClosestRegion(const FVector2D& Position, FTriangleIndex Triangle) const
+{
+	if (_grid_t.Num() == 0)
+	{
+		return FPointIndex();
+	}
+
+	// Positions off the mesh still have a closest region, so start from the grid if there's no triangle
+	const int32 t = Triangle.IsValid() ? (int32)Triangle.Value : _grid_t[GetGridCell(Position)];
+	const TArray<FVector2D>& points = Mesh.Coordinates;
+	const TArray<FPointIndex>& triangles = Mesh.DelaunayTriangles;
+	const int32 ghost = NumRegions - 1;
+
+	int32 closest = (int32)triangles[3 * t];
+	float closestDistance = FVector2D::DistSquared(points[closest], Position);
+	for (int32 i = 1; i < 3; i++)
+	{
+		const int32 r = (int32)triangles[3 * t + i];
+		const float distance = FVector2D::DistSquared(points[r], Position);
+		if (distance < closestDistance)
+		{
+			closest = r;
+			closestDistance = distance;
+		}
+	}
+
+	// The closest corner usually is the closest region, but not always.
+	// Moving to whichever neighbor is closer until none are always ends at the closest region.
+	bool bMoved = true;
+	while (bMoved)
+	{
+		bMoved = false;
+		for (int32 i = _r_side_offsets[closest]; i < _r_side_offsets[closest + 1]; i++)
+		{
+			const int32 s = _r_sides[i];
+			const int32 r = (int32)triangles[s % 3 == 2 ? s - 2 : s + 1];
+			if (r == ghost)
+			{
+				continue;
+			}
+			const float distance = FVector2D::DistSquared(points[r], Position);
+			if (distance < closestDistance)
+			{
+				closest = r;
+				closestDistance = distance;
+				bMoved = true;
+			}
+		}
+	}
+	return FPointIndex(closest);
+}
+
+FVector UTriangleDualMesh::t_barycentric(FTriangleIndex t, const FVector2D& Position) const
+{
+	const FVector2D& a = Mesh.Coordinates[Mesh.DelaunayTriangles[3 * t]];
+	const FVector2D& b = Mesh.Coordinates[Mesh.DelaunayTriangles[3 * t + 1]];
+	const FVector2D& c = Mesh.Coordinates[Mesh.DelaunayTriangles[3 * t + 2]];
+	const float area = (b - a) ^ (c - a);
+	if (FMath::IsNearlyZero(area))
+	{
+		return FVector(1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f);
+	}
+	const float weightB = ((Position - a) ^ (c - a)) / area;
+	const float weightC = ((b - a) ^ (Position - a)) / area;
+	return FVector(1.0f - weightB - weightC, weightB, weightC);
+}
+
+FPointIndex UTriangleDualMesh::FindRegionAt(const FVector2D& Position) const
+{
+	return FindClosestRegion(Position, FindTriangleAt(Position));
+}
+
+void UTriangleDualMesh::FindTrianglesAt(TArrayView<const FVector2D> Positions, TArray<FTriangleIndex>& OutTriangles) const
+{
+	OutTriangles.SetNumUninitialized(Positions.Num());
+	FDualMeshParallel::ForEachChunk(Positions.Num(), [&](int32 Start, int32 End)
+	{
+		FTriangleIndex last;
+		for (int32 i = Start; i < End; i++)
+		{
+			OutTriangles[i] = FindTriangleAt(Positions[i], last);
+			if (OutTriangles[i].IsValid())
+			{
+				last = OutTriangles[i];
+			}
+		}
+	});
+}
+
+void UTriangleDualMesh::FindRegionsAt(TArrayView<const FVector2D> Positions, TArray<FPointIndex>& OutRegions) const
+{
+	OutRegions.SetNumUninitialized(Positions.Num());
+	FDualMeshParallel::ForEachChunk(Positions.Num(), [&](int32 Start, int32 End)
+	{
+		FTriangleIndex last;
+		for (int32 i = Start; i < End; i++)
+		{
+			const FTriangleIndex t = FindTriangleAt(Positions[i], last);
+			OutRegions[i] = FindClosestRegion(Positions[i], t);
+			if (t.IsValid())
+			{
+				last = t;
+			}
+		}
+	});
 }
 
 FVector2D UTriangleDualMesh::GetSize() const
@@ -387,9 +672,73 @@ FVector2D UTriangleDualMesh::GetSize() const
 	return Mesh.MaxSize;
 }
 
+SIZE_T UTriangleDualMesh::GetAllocatedSize() const
+{
+	return Mesh.GetAllocatedSize() + _t_vertex.GetAllocatedSize() + _triangles.GetAllocatedSize() + _t_neighbors.GetAllocatedSize()
+		+ _r_side_offsets.GetAllocatedSize() + _r_sides.GetAllocatedSize() + _grid_t.GetAllocatedSize()
+		+ _t_ocean_count.GetAllocatedSize() + _t_water.GetAllocatedSize();
+}
+
+void UTriangleDualMesh::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetAllocatedSize());
+}
+
+void UTriangleDualMesh::CacheTriangleWater(const TArray<bool>& r_water, const TArray<bool>& r_ocean)
+{
+	if (r_water.Num() != NumRegions || r_ocean.Num() != NumRegions)
+	{
+		UE_LOG(LogDualMesh, Warning, TEXT("Tried to cache triangle water with %d water regions and %d ocean regions, but the mesh has %d regions!"), r_water.Num(), r_ocean.Num(), NumRegions);
+		ClearTriangleWaterCache();
+		return;
+	}
+
+	_t_ocean_count.SetNumUninitialized(NumTriangles);
+	_t_water.SetNumUninitialized(NumTriangles);
+	const TArray<FPointIndex>& triangles = Mesh.DelaunayTriangles;
+	FDualMeshParallel::ForEach(NumTriangles, [&](int32 t)
+	{
+		const FPointIndex a = triangles[3 * t];
+		const FPointIndex b = triangles[3 * t + 1];
+		const FPointIndex c = triangles[3 * t + 2];
+		_t_ocean_count[t] = (uint8)r_ocean[a] + (uint8)r_ocean[b] + (uint8)r_ocean[c];
+		_t_water[t] = r_water[a] || r_water[b] || r_water[c];
+	});
+
+	bHasTriangleWaterCache = true;
+}
+
+void UTriangleDualMesh::ClearTriangleWaterCache()
+{
+	_t_ocean_count.Empty();
+	_t_water.Empty();
+	bHasTriangleWaterCache = false;
+}
+
+bool UTriangleDualMesh::HasTriangleWaterCache() const
+{
+	return bHasTriangleWaterCache && _t_water.Num() == NumTriangles;
+}
+
+int32 UTriangleDualMesh::t_ocean_count(FTriangleIndex t) const
+{
+	return _t_ocean_count[t];
+}
+
+bool UTriangleDualMesh::t_water(FTriangleIndex t) const
+{
+	return _t_water[t];
+}
+
 TArray<FVector2D>& UTriangleDualMesh::GetPoints()
 {
-	return _r_vertex;
+	return Mesh.Coordinates;
+}
+
+const TArray<FVector2D>& UTriangleDualMesh::GetPoints() const
+{
+	return Mesh.Coordinates;
 }
 
 TArray<FVector2D>& UTriangleDualMesh::GetTriangleCentroids()
@@ -399,11 +748,34 @@ TArray<FVector2D>& UTriangleDualMesh::GetTriangleCentroids()
 
 TArray<FSideIndex>& UTriangleDualMesh::GetHalfEdges()
 {
-	return _halfedges;
+	return Mesh.HalfEdges;
+}
+
+const TArray<int32>& UTriangleDualMesh::GetTriangleNeighbors() const
+{
+	return _t_neighbors;
+}
+
+const TArray<int32>& UTriangleDualMesh::GetRegionSideOffsets() const
+{
+	return _r_side_offsets;
+}
+
+const TArray<int32>& UTriangleDualMesh::GetRegionSides() const
+{
+	return _r_sides;
 }
 
 TArray<FDelaunayTriangle>& UTriangleDualMesh::GetTriangles()
 {
+	if (_triangles.Num() != NumTriangles)
+	{
+		_triangles.SetNum(NumTriangles);
+		for (FTriangleIndex t = 0; t < NumTriangles; t++)
+		{
+			_triangles[t] = t_triangle(t);
+		}
+	}
 	return _triangles;
 }
 
@@ -412,6 +784,11 @@ FDualMesh& UTriangleDualMesh::GetRawMesh()
 	return Mesh;
 }
 
+const FDualMesh& UTriangleDualMesh::GetRawMesh() const
+{
+	return Mesh;
+}
+
 void UTriangleDualMesh::Draw(const AActor* WorldObject) const
 {
 	Draw(WorldObject->GetWorld());
@@ -429,9 +806,9 @@ void UTriangleDualMesh::DrawDelaunayVertices(const UWorld* World) const
 {
 	// Draw delaunay vertices as red dots
 	int32 count = 0;
-	for (int r = 0; r < _r_vertex.Num(); r++)
+	for (int r = 0; r < Mesh.Coordinates.Num(); r++)
 	{
-		FVector2D vertex = _r_vertex[r];
+		FVector2D vertex = Mesh.Coordinates[r];
 		float zCoord = r_ghost(r) ? -500.0f : 0.0f;
 		FVector vertexWorldSpace = FVector(vertex.X, vertex.Y, zCoord);
 		DrawDebugPoint(World, vertexWorldSpace, 10.0f, FColor::Red, false, 999.0f);
@@ -444,13 +821,13 @@ void UTriangleDualMesh::DrawVoronoiEdges(const UWorld* World) const
 {
 	// Draw voronoi polygons as green lines
 	int32 count = 0;
-	for (int e = 0; e < _halfedges.Num(); e++)
+	for (int e = 0; e < Mesh.HalfEdges.Num(); e++)
 	{
-		if (e < _halfedges[e])
+		if (e < Mesh.HalfEdges[e])
 		{
 			FDelaunayTriangle triangleP = UDelaunayHelper::GetTriangleFromHalfEdge(Mesh, e);
-			FDelaunayTriangle triangleQ = UDelaunayHelper::GetTriangleFromHalfEdge(Mesh, _halfedges[e]);
-			if (!triangleP.IsValid() || !triangleQ.IsValid())// || s_ghost(e) || s_ghost(_halfedges[e]))
+			FDelaunayTriangle triangleQ = UDelaunayHelper::GetTriangleFromHalfEdge(Mesh, Mesh.HalfEdges[e]);
+			if (!triangleP.IsValid() || !triangleQ.IsValid())// || s_ghost(e) || s_ghost(Mesh.HalfEdges[e]))
 			{
 				continue;
 			}
@@ -469,14 +846,14 @@ void UTriangleDualMesh::DrawVoronoiEdges(const UWorld* World) const
 void UTriangleDualMesh::DrawDelaunayEdges(const UWorld* World) const
 {
 	int32 count = 0;
-	for (FSideIndex e = 0; e < _halfedges.Num(); e++)
+	for (FSideIndex e = 0; e < Mesh.HalfEdges.Num(); e++)
 	{
-		if (e < _halfedges[e])
+		if (e < Mesh.HalfEdges[e])
 		{
-			FPointIndex pIndex = UDelaunayHelper::GetPointIndexFromHalfEdge(Mesh, e);
-			FPointIndex qIndex = UDelaunayHelper::GetPointIndexFromHalfEdge(Mesh, UDelaunayHelper::NextHalfEdge(e));
-			const FVector2D p = _r_vertex[pIndex];
-			const FVector2D q = _r_vertex[qIndex];
+			FPointIndex pIndex = s_begin_r(e);
+			FPointIndex qIndex = s_end_r(e);
+			const FVector2D p = Mesh.Coordinates[pIndex];
+			const FVector2D q = Mesh.Coordinates[qIndex];
 			float pZCoord = r_ghost(pIndex) ? -1000.0f : 0.0f;
 			float qZCoord = r_ghost(qIndex) ? -1000.0f : 0.0f;
 			FVector pVector = FVector(p.X, p.Y, pZCoord);
@@ -491,13 +868,13 @@ void UTriangleDualMesh::DrawDelaunayEdges(const UWorld* World) const
 void UTriangleDualMesh::DrawVoronoiPoints(const UWorld* World) const
 {
 	int32 count = 0;
-	for (FTriangleIndex t = 0; t < _triangles.Num(); t++)
+	for (FTriangleIndex t = 0; t < NumTriangles; t++)
 	{
 		if (t_ghost(t))
 		{
 			continue;
 		}
-		FDelaunayTriangle triangle = _triangles[t];
+		FDelaunayTriangle triangle = t_triangle(t);
 		FVector2D vertex = triangle.GetCircumcenter();
 		FVector vertexWorldSpace = FVector(vertex.X, vertex.Y, 0.0f);
 		DrawDebugPoint(World, vertexWorldSpace, 10.0f, FColor::Blue, false, 999.0f);
@@ -55,6 +55,9 @@ public:
 	TArray<FVector2D> GetBoundaryPoints() const;
 	void ClearNonBoundaryPoints();
 	void AddPoisson(FRandomStream& Rng, FVector2D MapOffset = FVector2D(0.0f, 0.0f), float Spacing = 1.0f, int32 MaxStepSamples = 30);
+	// Same as AddPoisson, but the spacing around each point comes from GetSpacing.
+	// MinSpacing is the smallest spacing GetSpacing will return.
+	void AddVariablePoisson(FRandomStream& Rng, TFunctionRef<float(const FVector2D&)> GetSpacing, FVector2D MapOffset = FVector2D(0.0f, 0.0f), float MinSpacing = 1.0f, int32 MaxStepSamples = 30);
 
 	UTriangleDualMesh* Create();
 };
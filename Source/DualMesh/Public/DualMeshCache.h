@@ -0,0 +1,60 @@
+/*
+* Based on https://github.com/redblobgames/dual-mesh
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Saves generated dual meshes to disk so they can be loaded instead of rebuilt.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTriangleDualMesh;
+
+/**
+* A versioned binary cache of dual mesh topology.
+*
+* Files hold the points, half-edges, triangles, hull and point -> side index of
+* the raw mesh, along with the boundary and solid counts. Everything else is
+* rebuilt from those on load. A CRC of the data is checked before anything is
+* used, and the full key is stored in the file so hash collisions are caught.
+*
+* Cache files live in Saved/DualMeshCache, one per key.
+*/
+struct DUALMESH_API FDualMeshCache
+{
+public:
+	// Bump this whenever the file layout changes, so old files get rebuilt.
+	static const uint32 Version;
+
+	// Where the cache file for a key lives.
+	static FString GetCachePath(const FString& Key);
+
+	/**
+	* Writes a mesh out to bytes.
+	* RngSteps is stored alongside the mesh, so callers can leave their random
+	* stream where building the mesh would have left it.
+	*/
+	static void Serialize(const UTriangleDualMesh* Mesh, const FString& Key, int32 RngSteps, TArray<uint8>& OutBytes);
+	// Reads a mesh back from bytes. Returns NULL if the data is corrupt, out of date, or was saved under a different key.
+	// Every index is range-checked before the mesh is built, so this is safe to call on untrusted data.
+	static UTriangleDualMesh* Deserialize(const uint8* Data, int64 Size, const FString& Key, int32& OutRngSteps);
+
+	// Serializes a mesh into its cache file.
+	static bool Save(const UTriangleDualMesh* Mesh, const FString& Key, int32 RngSteps);
+	// Memory-maps the cache file for a key and deserializes it. Returns NULL if there's no valid cache file.
+	static UTriangleDualMesh* Load(const FString& Key, int32& OutRngSteps);
+};
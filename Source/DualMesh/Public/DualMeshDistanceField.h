@@ -0,0 +1,67 @@
+/*
+* Based on https://github.com/redblobgames/dual-mesh
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Shortest path distances over the dual mesh, measured in world units.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Delaunator/Public/DelaunayHelper.h"
+
+class UTriangleDualMesh;
+
+/**
+* Multi-source shortest path distances over the dual mesh.
+*
+* Breadth-first searches count hops, so their distances depend on how densely
+* points were placed. These searches use the Euclidean length of every edge
+* instead, so a distance means the same thing no matter how the mesh was built.
+*
+* Searches use delta-stepping: nodes are binned into buckets of BucketWidth
+* units, and each bucket's edges are relaxed in parallel. Edges shorter than
+* the bucket width are relaxed until the bucket settles; longer ones are relaxed
+* once afterwards, since they can only reach later buckets. Results don't depend
+* on the number of threads.
+*/
+struct DUALMESH_API FDualMeshDistanceField
+{
+public:
+	/**
+	* Returns how much crossing side s costs, per unit of length.
+	* 1 is a normal edge, 0 is a free edge, and anything negative can't be crossed.
+	* Called from multiple threads at once.
+	*/
+	typedef TFunctionRef<float(FSideIndex)> FSideWeightFunction;
+
+	/**
+	* Finds the distance from the nearest seed to every region, walking along
+	* Delaunay edges. Edges into the ghost region are never crossed.
+	* Regions which can't be reached get a distance of -1.
+	* OutParentSides, if given, holds the side leading from each region back toward
+	* its seed. Seeds and unreached regions get an invalid side.
+	* If BucketWidth is 0 or less, the mean edge length is used.
+	* Returns the mean length of the edges that can be crossed, which callers can
+	* use to turn distances back into rough hop counts.
+	*/
+	static float ComputeRegionDistances(const UTriangleDualMesh* Mesh, TArrayView<const FPointIndex> Seeds, FSideWeightFunction SideWeight, TArray<float>& OutDistances, TArray<FSideIndex>* OutParentSides = NULL, float BucketWidth = 0.0f);
+	/**
+	* As above, but walks from triangle centroid to triangle centroid across
+	* Voronoi edges. Ghost triangles are included.
+	*/
+	static float ComputeTriangleDistances(const UTriangleDualMesh* Mesh, TArrayView<const FTriangleIndex> Seeds, FSideWeightFunction SideWeight, TArray<float>& OutDistances, TArray<FSideIndex>* OutParentSides = NULL, float BucketWidth = 0.0f);
+};
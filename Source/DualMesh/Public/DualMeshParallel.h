@@ -0,0 +1,87 @@
+/*
+* Based on https://github.com/redblobgames/dual-mesh
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Helpers for running per-element passes over a dual mesh on multiple threads.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/ParallelFor.h"
+
+/**
+* Runs "for each region/triangle/side" kernels in parallel.
+*
+* Elements are split into contiguous chunks of at least GetMinBatchSize()
+* elements, and every chunk runs on its own task. Kernels may read anything,
+* but should only write to the slots belonging to the element they were given.
+*
+* Set DualMesh.ParallelMinBatchSize to change the chunk size, or
+* DualMesh.ForceSerial to 1 to run everything on the calling thread.
+*/
+struct DUALMESH_API FDualMeshParallel
+{
+public:
+	// The smallest number of elements we'll hand to a single task.
+	static int32 GetMinBatchSize();
+	// Whether all kernels should run on the calling thread, for debugging.
+	static bool ShouldRunSerial();
+
+	/**
+	* Calls Kernel(Start, End) for contiguous chunks covering [0, Num).
+	* Useful if a kernel wants scratch memory that it can reuse for a whole chunk.
+	* If MinBatchSize is 0 or less, the DualMesh.ParallelMinBatchSize CVar is used.
+	*/
+	template<typename ChunkKernelType>
+	static void ForEachChunk(int32 Num, const ChunkKernelType& Kernel, int32 MinBatchSize = 0)
+	{
+		if (Num <= 0)
+		{
+			return;
+		}
+		const int32 batchSize = FMath::Max(1, MinBatchSize > 0 ? MinBatchSize : GetMinBatchSize());
+		if (Num <= batchSize || ShouldRunSerial())
+		{
+			Kernel(0, Num);
+			return;
+		}
+
+		const int32 numChunks = FMath::DivideAndRoundUp(Num, batchSize);
+		ParallelFor(numChunks, [&Kernel, Num, batchSize](int32 Chunk)
+		{
+			const int32 start = Chunk * batchSize;
+			const int32 end = FMath::Min(start + batchSize, Num);
+			Kernel(start, end);
+		});
+	}
+
+	/**
+	* Calls Kernel(Index) for every index in [0, Num).
+	* If MinBatchSize is 0 or less, the DualMesh.ParallelMinBatchSize CVar is used.
+	*/
+	template<typename KernelType>
+	static void ForEach(int32 Num, const KernelType& Kernel, int32 MinBatchSize = 0)
+	{
+		ForEachChunk(Num, [&Kernel](int32 Start, int32 End)
+		{
+			for (int32 i = Start; i < End; i++)
+			{
+				Kernel(i);
+			}
+		}, MinBatchSize);
+	}
+};
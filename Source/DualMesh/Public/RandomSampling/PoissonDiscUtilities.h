@@ -43,6 +43,19 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, meta = (DisplayName = "Distribute in 2D (Poisson Disc)"), Category = "Procedural Generation|Random Sampling|Distribution")
 	static void Distribute2D(TArray<FVector2D>& Samples, int32 Seed = 0, FVector2D Size = FVector2D(1.0, 1.0), FVector2D StartLocation = FVector2D(0.0f, 0.0f), float MinimumDistance = 1.0f, int32 MaxStepSamples = 30, bool WrapX = false, bool WrapY = false);
 
+	/**
+	* Generate samples using a PoissonDisc distribution in 2D space, where the spacing changes from place to place.
+	* Each new sample keeps GetDistance(Sample) away from every other sample.
+	* @param Samples - Returned TArray of FVector2D containing the sample positions.
+	* @param Seed - Seed used for generation of samples.
+	* @param Size - Size of area to generate samples in.
+	* @param StartLocation - Offset added to every sample. GetDistance is called with this offset applied.
+	* @param MinimumDistance - The smallest distance GetDistance will return. Smaller distances get clamped to this.
+	* @param GetDistance - Returns the minimum distance between samples around a point.
+	* @param MaxStepSamples - Maximum samples to generate each step.
+	*/
+	static void DistributeVariable2D(TArray<FVector2D>& Samples, int32 Seed, FVector2D Size, FVector2D StartLocation, float MinimumDistance, TFunctionRef<float(const FVector2D&)> GetDistance, int32 MaxStepSamples = 30);
+
 	/**
 	* Generate samples using a PoissonDisc distribution in 3D space.
 	* @param Samples - Returned TArray of FVector containing the sample positions.
@@ -86,14 +86,46 @@ class DUALMESH_API UTriangleDualMesh : public UObject
 	friend class UDualMeshBuilder;
 
 protected:
-	TArray<FSideIndex> _halfedges;
-	TArray<FDelaunayTriangle> _triangles;
-	TArray<FVector2D> _r_vertex;
 	TArray<FVector2D> _t_vertex;
-	TMap<FPointIndex, FSideIndex> _r_in_s;
-
+	// Only filled in if someone calls GetTriangles().
+	// Everything else builds triangles on demand from the raw mesh.
+	TArray<FDelaunayTriangle> _triangles;
+	// The triangle on the other side of each side.
+	// Indexed by side, so triangle t's neighbors are at 3 * t, 3 * t + 1 and 3 * t + 2.
+	TArray<int32> _t_neighbors;
+	// Region -> side adjacency in compressed sparse row form.
+	// The sides starting at region r are _r_sides[_r_side_offsets[r]] up to _r_sides[_r_side_offsets[r + 1]].
+	TArray<int32> _r_side_offsets;
+	TArray<int32> _r_sides;
+	// A coarse grid over the map, holding a solid triangle close to each cell.
+	// Point lookups start at their cell's triangle and walk the rest of the way.
+	TArray<int32> _grid_t;
+	int32 _grid_width;
+	int32 _grid_height;
+	FVector2D _grid_cell_size;
+
+	// Per-triangle water data, filled in by CacheTriangleWater().
+	// Whoever changes the region water arrays is responsible for clearing it.
+	TArray<uint8> _t_ocean_count;
+	TArray<bool> _t_water;
+	bool bHasTriangleWaterCache;
+
+	// The one copy of the mesh topology.
+	// Regions, half-edges and the region -> side index all live here.
 	FDualMesh Mesh;
 
+protected:
+	// Sets up the element counts, triangle centroids and triangle neighbors once Mesh is filled in.
+	void InitializeDerivedData(int32 BoundaryRegions);
+	// Bins the solid triangles into the point location grid.
+	void BuildPointLocationGrid();
+	int32 GetGridCell(const FVector2D& Position) const;
+	// Walks the Delaunay graph from the corners of Triangle to the region closest to Position.
+	FPointIndex FindClosestRegion(const FVector2D& Position, FTriangleIndex Triangle) const;
+
+public:
+	UTriangleDualMesh();
+
 public:
 	int32 NumSides;
 	int32 NumSolidSides;
@@ -127,6 +159,13 @@ public:
 	FTriangleIndex s_outer_t(FSideIndex s) const;
 
 	FSideIndex s_opposite_s(FSideIndex s) const;
+	// Gets a side leading into region r, or an invalid side if r isn't in the mesh.
+	FSideIndex r_in_s(FPointIndex r) const;
+
+	// Builds the triangle struct for t from the raw mesh.
+	FDelaunayTriangle t_triangle(FTriangleIndex t) const;
+	// The barycentric weights of Position in triangle t, in the same order as the triangle's corners.
+	FVector t_barycentric(FTriangleIndex t, const FVector2D& Position) const;
 
 	TArray<FSideIndex> t_circulate_s(FTriangleIndex t) const;
 	TArray<FPointIndex> t_circulate_r(FTriangleIndex t) const;
@@ -145,13 +184,51 @@ public:
 	bool r_boundary(FPointIndex r) const;
 
 	void InitializeMesh(const FDualMesh& Input, int32 BoundaryRegions);
+	void InitializeMesh(FDualMesh&& Input, int32 BoundaryRegions);
 	FVector2D GetSize() const;
+	// Gets the number of bytes used by the mesh topology and centroids.
+	SIZE_T GetAllocatedSize() const;
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
+	// Counts the ocean and water corners of every triangle in a single parallel pass.
+	// Anything which writes to the region water arrays afterwards must call ClearTriangleWaterCache().
+	void CacheTriangleWater(const TArray<bool>& r_water, const TArray<bool>& r_ocean);
+	void ClearTriangleWaterCache();
+	// Whether the triangle water cache is filled in and hasn't been cleared since.
+	bool HasTriangleWaterCache() const;
+	// The number of corners of t which are ocean. Only valid if there's a cache.
+	int32 t_ocean_count(FTriangleIndex t) const;
+	// Whether any corner of t is water. Only valid if there's a cache.
+	bool t_water(FTriangleIndex t) const;
 
 	TArray<FVector2D>& GetPoints();
+	const TArray<FVector2D>& GetPoints() const;
 	TArray<FVector2D>& GetTriangleCentroids();
 	TArray<FSideIndex>& GetHalfEdges();
+	const TArray<int32>& GetTriangleNeighbors() const;
+	// Offsets into GetRegionSides() for every region, plus one final entry for the end of the array.
+	const TArray<int32>& GetRegionSideOffsets() const;
+	// Every side, grouped by the region it starts at.
+	// Side s belongs to triangle s / 3, and leads to region s_end_r(s).
+	const TArray<int32>& GetRegionSides() const;
+
+	// Finds the solid triangle containing Position, or an invalid index if Position is outside the mesh.
+	// The mesh is never modified by lookups, so any number of threads can look up points at once.
+	FTriangleIndex FindTriangleAt(const FVector2D& Position) const;
+	// As above, but walks from StartTriangle if it's nearby.
+	// Passing in the last triangle found makes lookups of nearby points much cheaper.
+	FTriangleIndex FindTriangleAt(const FVector2D& Position, FTriangleIndex StartTriangle) const;
+	// Finds the solid region closest to Position, i.e. the region whose Voronoi cell contains it.
+	FPointIndex FindRegionAt(const FVector2D& Position) const;
+	// Looks up a batch of positions across multiple threads.
+	// Lookups are fastest if positions which are near each other are also next to each other in the array.
+	void FindTrianglesAt(TArrayView<const FVector2D> Positions, TArray<FTriangleIndex>& OutTriangles) const;
+	void FindRegionsAt(TArrayView<const FVector2D> Positions, TArray<FPointIndex>& OutRegions) const;
+	// Note -- the triangle array is built the first time this is called.
+	// This takes a lot of memory on large meshes; prefer t_triangle() where possible.
 	TArray<FDelaunayTriangle>& GetTriangles();
 	FDualMesh& GetRawMesh();
+	const FDualMesh& GetRawMesh() const;
 
 	void Draw(const AActor* WorldObject) const;
 	void Draw(const UWorld* World) const;
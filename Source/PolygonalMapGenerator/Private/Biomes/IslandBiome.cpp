@@ -17,12 +17,13 @@
 */
 
 #include "Biomes/IslandBiome.h"
+#include "DualMeshParallel.h"
 
 void UIslandBiome::AssignCoast_Implementation(TArray<bool>& r_coast, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
 {
 	r_coast.Empty(Mesh->NumRegions);
 	r_coast.SetNumZeroed(Mesh->NumRegions);
-	for (FPointIndex r1 = 0; r1 < r_coast.Num(); r1++)
+	FDualMeshParallel::ForEach(r_coast.Num(), [&](int32 r1)
 	{
 		if (!r_ocean[r1])
 		{
@@ -36,29 +37,30 @@ void UIslandBiome::AssignCoast_Implementation(TArray<bool>& r_coast, UTriangleDu
 				}
 			}
 		}
-	}
+	});
 }
 
 void UIslandBiome::AssignTemperature_Implementation(TArray<float>& r_temperature, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<float>& r_elevation, const TArray<float>& r_moisture, float NorthernTemperature, float SouthernTemperature) const
 {
 	r_temperature.Empty(Mesh->NumRegions);
 	r_temperature.SetNumZeroed(Mesh->NumRegions);
-	for (FPointIndex r = 0; r < r_temperature.Num(); r++)
+	const float mapHeight = Mesh->GetSize().Y;
+	FDualMeshParallel::ForEach(r_temperature.Num(), [&](int32 r)
 	{
-		float lat = Mesh->r_y(r) / Mesh->GetSize().Y; // 0.0 - 1.0
+		float lat = Mesh->r_y(r) / mapHeight; // 0.0 - 1.0
 		float biased_temp = FMath::Lerp(NorthernTemperature, SouthernTemperature, lat);
 		r_temperature[r] = 1.0f - r_elevation[r] + biased_temp;
-	}
+	});
 }
 
 void UIslandBiome::AssignBiome_Implementation(TArray<FBiomeData>& r_biome, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<bool>& r_coast, const TArray<float>& r_temperature, const TArray<float>& r_moisture) const
 {
 	r_biome.Empty(Mesh->NumRegions);
 	r_biome.SetNumZeroed(Mesh->NumRegions);
-	for (FPointIndex r = 0; r < r_biome.Num(); r++)
+	FDualMeshParallel::ForEach(r_biome.Num(), [&](int32 r)
 	{
 		r_biome[r] = UIslandMapUtils::GetBiome(BiomeData, r_ocean[r], r_water[r], r_coast[r], r_temperature[r], r_moisture[r]);
-	}
+	});
 }
 
 void UIslandBiome::assign_r_coast(TArray<bool>& r_coast, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
@@ -75,3 +77,84 @@ void UIslandBiome::assign_r_biome(TArray<FBiomeData>& r_biome, UTriangleDualMesh
 {
 	AssignBiome(r_biome, Mesh, r_ocean, r_water, r_coast, r_temperature, r_moisture);
 }
+
+void UIslandBiome::assign_r_coast_temperature_biome(TArray<bool>& r_coast, TArray<float>& r_temperature, TArray<FBiomeData>& r_biome, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<float>& r_elevation, const TArray<float>& r_moisture, float NorthernTemperature, float SouthernTemperature) const
+{
+	if (CanFuseAssignments())
+	{
+		AssignFused(r_coast, r_temperature, r_biome, Mesh, r_ocean, r_water, r_elevation, r_moisture, NorthernTemperature, SouthernTemperature);
+	}
+	else
+	{
+		assign_r_coast(r_coast, Mesh, r_ocean);
+		assign_r_temperature(r_temperature, Mesh, r_ocean, r_water, r_elevation, r_moisture, NorthernTemperature, SouthernTemperature);
+		assign_r_biome(r_biome, Mesh, r_ocean, r_water, r_coast, r_temperature, r_moisture);
+	}
+}
+
+bool UIslandBiome::CanFuseAssignments() const
+{
+	UClass* biomeClass = GetClass();
+	if (biomeClass->IsFunctionImplementedInBlueprint(GET_FUNCTION_NAME_CHECKED(UIslandBiome, AssignCoast)) ||
+		biomeClass->IsFunctionImplementedInBlueprint(GET_FUNCTION_NAME_CHECKED(UIslandBiome, AssignTemperature)) ||
+		biomeClass->IsFunctionImplementedInBlueprint(GET_FUNCTION_NAME_CHECKED(UIslandBiome, AssignBiome)))
+	{
+		return false;
+	}
+
+	// Native overrides of the _Implementation functions can't be seen through reflection,
+	// so any native subclass has to go through the BlueprintNativeEvents
+	while (biomeClass != NULL && !biomeClass->HasAnyClassFlags(CLASS_Native))
+	{
+		biomeClass = biomeClass->GetSuperClass();
+	}
+	return biomeClass == UIslandBiome::StaticClass();
+}
+
+void UIslandBiome::AssignFused(TArray<bool>& r_coast, TArray<float>& r_temperature, TArray<FBiomeData>& r_biome, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<float>& r_elevation, const TArray<float>& r_moisture, float NorthernTemperature, float SouthernTemperature) const
+{
+	// Every slot gets overwritten, so reuse the buffers from the last run if they're already the right size
+	const int32 numRegions = Mesh->NumRegions;
+	if (r_coast.Num() != numRegions)
+	{
+		r_coast.SetNumUninitialized(numRegions);
+	}
+	if (r_temperature.Num() != numRegions)
+	{
+		r_temperature.SetNumUninitialized(numRegions);
+	}
+	if (r_biome.Num() != numRegions)
+	{
+		r_biome.SetNum(numRegions);
+	}
+
+	const TArray<FVector2D>& r_vertex = Mesh->GetPoints();
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	const TArray<FPointIndex>& s_start_r = Mesh->GetRawMesh().DelaunayTriangles;
+	const float mapHeight = Mesh->GetSize().Y;
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r1)
+	{
+		bool bIsCoast = false;
+		if (!r_ocean[r1])
+		{
+			for (int32 i = r_side_offsets[r1]; i < r_side_offsets[r1 + 1]; i++)
+			{
+				if (r_ocean[s_start_r[UTriangleDualMesh::s_next_s(r_sides[i])]])
+				{
+					bIsCoast = true;
+					break;
+				}
+			}
+		}
+		r_coast[r1] = bIsCoast;
+
+		// Matches r_y, which gives -1 for regions without a position
+		const float y = r1 < r_vertex.Num() ? r_vertex[r1].Y : -1.0f;
+		const float biased_temp = FMath::Lerp(NorthernTemperature, SouthernTemperature, y / mapHeight);
+		const float temperature = 1.0f - r_elevation[r1] + biased_temp;
+		r_temperature[r1] = temperature;
+
+		r_biome[r1] = UIslandMapUtils::GetBiome(BiomeData, r_ocean[r1], r_water[r1], bIsCoast, temperature, r_moisture[r1]);
+	});
+}
@@ -16,6 +16,13 @@
 * limitations under the License.
 */
 #include "Elevation/IslandElevation.h"
+#include "DualMeshDistanceField.h"
+#include "DualMeshParallel.h"
+
+UIslandElevation::UIslandElevation()
+{
+	bUseGeometricDistances = false;
+}
 
 TArray<FTriangleIndex> UIslandElevation::FindCoastTriangles(UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
 {
@@ -38,6 +45,16 @@ TArray<FTriangleIndex> UIslandElevation::FindCoastTriangles(UTriangleDualMesh* M
 	return coasts_t.Array();
 }
 
+bool UIslandElevation::IsTriangleOceanCached(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
+{
+	if (Mesh->HasTriangleWaterCache())
+	{
+		// True if 2 or more points of the triangle are ocean
+		return Mesh->t_ocean_count(t) >= 2;
+	}
+	return IsTriangleOcean(t, Mesh, r_ocean);
+}
+
 bool UIslandElevation::IsTriangleOcean(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
 {
 	TArray<FPointIndex> trianglePoints = Mesh->t_circulate_r(t);
@@ -66,11 +83,11 @@ bool UIslandElevation::IsSideLake(FSideIndex s, UTriangleDualMesh* Mesh, const T
 void UIslandElevation::DistributeElevations(TArray<float> &t_elevation, UTriangleDualMesh* Mesh, const TArray<int32> &t_coastdistance, const TArray<bool>& r_ocean, int32 MinDistance, int32 MaxDistance) const
 {
 	// We initially base elevation on distance from a coast
-	for (FTriangleIndex t = 0; t < t_coastdistance.Num(); t++)
+	FDualMeshParallel::ForEach(t_coastdistance.Num(), [&](int32 t)
 	{
 		float d = (float)t_coastdistance[t];
 		// Ocean values scale linearly down, so they're "upside-down mountains"
-		if (IsTriangleOcean(t, Mesh, r_ocean))
+		if (IsTriangleOceanCached(t, Mesh, r_ocean))
 		{
 			t_elevation[t] = -d / (float)MinDistance;
 		}
@@ -78,17 +95,16 @@ void UIslandElevation::DistributeElevations(TArray<float> &t_elevation, UTriangl
 		{
 			t_elevation[t] = d / (float)MaxDistance;
 		}
-	}
+	});
 }
 
 void UIslandElevation::UpdateCoastDistance(TArray<int32> &t_coastdistance, UTriangleDualMesh* Mesh, FTriangleIndex Triangle, int32 Distance) const
 {
 	// Update the coast distance array to make sure we're still pointing to the nearest coast
 	t_coastdistance[Triangle] = Distance;
-	TArray<FSideIndex> out_s = Mesh->t_circulate_s(Triangle);
-	for (int i = 0; i < out_s.Num(); i++)
+	for (int i = 0; i < 3; i++)
 	{
-		FSideIndex s = out_s[i];
+		FSideIndex s = 3 * Triangle + i;
 		FTriangleIndex neighbor_t = Mesh->s_outer_t(s);
 		if (t_coastdistance[neighbor_t] > Distance + 1)
 		{
@@ -97,8 +113,77 @@ void UIslandElevation::UpdateCoastDistance(TArray<int32> &t_coastdistance, UTria
 	}
 }
 
+void UIslandElevation::AssignGeometricTriangleElevations(TArray<float>& t_elevation, TArray<int32>& t_coastdistance, TArray<FSideIndex>& t_downslope_s, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const
+{
+	t_elevation.Empty(Mesh->NumTriangles);
+	t_elevation.SetNumZeroed(Mesh->NumTriangles);
+	t_coastdistance.Empty(Mesh->NumTriangles);
+	t_coastdistance.SetNumZeroed(Mesh->NumTriangles);
+
+	TArray<FTriangleIndex> coasts_t = FindCoastTriangles(Mesh, r_ocean);
+	if (coasts_t.Num() == 0)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("No triangles were marked as coast!"));
+		t_downslope_s.Empty(Mesh->NumTriangles);
+		t_downslope_s.SetNum(Mesh->NumTriangles);
+		return;
+	}
+
+	// Lake sides cost nothing to cross, so every corner of a lake ends up at the same distance
+	TArray<float> t_distance;
+	const float meanLength = FDualMeshDistanceField::ComputeTriangleDistances(Mesh, coasts_t, [&](FSideIndex s)
+	{
+		return IsSideLake(s, Mesh, r_water, r_ocean) ? 0.0f : 1.0f;
+	}, t_distance, &t_downslope_s);
+
+	// Find how far the furthest triangle is from the coast, both underwater and overland
+	TArray<bool> t_ocean;
+	t_ocean.SetNumUninitialized(Mesh->NumTriangles);
+	FDualMeshParallel::ForEach(Mesh->NumTriangles, [&](int32 t)
+	{
+		t_ocean[t] = IsTriangleOceanCached(t, Mesh, r_ocean);
+	});
+	float minDistance = meanLength;
+	float maxDistance = meanLength;
+	int32 unreached = 0;
+	for (int32 t = 0; t < t_distance.Num(); t++)
+	{
+		const float distance = t_distance[t];
+		if (distance < 0.0f)
+		{
+			unreached++;
+		}
+		else if (t_ocean[t])
+		{
+			minDistance = FMath::Max(minDistance, distance);
+		}
+		else
+		{
+			maxDistance = FMath::Max(maxDistance, distance);
+		}
+	}
+	if (unreached > 0)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Found %d triangles which couldn't reach a coast."), unreached);
+	}
+
+	FDualMeshParallel::ForEach(Mesh->NumTriangles, [&](int32 t)
+	{
+		const float distance = FMath::Max(t_distance[t], 0.0f);
+		t_coastdistance[t] = t_distance[t] < 0.0f ? -1 : FMath::RoundToInt(distance / meanLength);
+		// Ocean values scale linearly down, so they're "upside-down mountains"
+		t_elevation[t] = t_ocean[t] ? -distance / minDistance : distance / maxDistance;
+	});
+}
+
 void UIslandElevation::AssignTriangleElevations_Implementation(TArray<float>& t_elevation, TArray<int32>& t_coastdistance, TArray<FSideIndex>& t_downslope_s, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, FRandomStream& DrainageRng) const
 {
+	if (bUseGeometricDistances)
+	{
+		AssignGeometricTriangleElevations(t_elevation, t_coastdistance, t_downslope_s, Mesh, r_ocean, r_water);
+		return;
+	}
+
 	// TODO: this messes up lakes, as they will no longer all be at the same elevation
 
 	// Initialize all triangles to be -1 triangles away from the nearest coast
@@ -142,15 +227,12 @@ void UIslandElevation::AssignTriangleElevations_Implementation(TArray<float>& t_
 		// Get the next triangle and pop it from the queue
 		FTriangleIndex current_t = queue_t[0];
 		queue_t.RemoveAt(0);
-		// Find all sides of the current triangle
-		TArray<FSideIndex> out_s = Mesh->t_circulate_s(current_t);
-
 		// Iterate over each side of the triangle, starting from a random offset
-		int32 iOffset = DrainageRng.RandRange(0, out_s.Num() - 1);
-		for (int i = 0; i < out_s.Num(); i++)
+		int32 iOffset = DrainageRng.RandRange(0, 2);
+		for (int i = 0; i < 3; i++)
 		{
 			// Get the index of the side we're working on
-			FSideIndex s = out_s[(i + iOffset) % out_s.Num()];
+			FSideIndex s = 3 * current_t + (i + iOffset) % 3;
 			// Check to see if this side is a lake
 			// If it is, keep the distance from the nearest coast the same (to ensure that lakes keep elevation)
 			// If it isn't, increment the distance from the nearest coast
@@ -170,9 +252,10 @@ void UIslandElevation::AssignTriangleElevations_Implementation(TArray<float>& t_
 
 				// If this tile is ocean, see if we need to update how far away this underwater tile 
 				// is from a coast
-				if (IsTriangleOcean(neighbor_t, Mesh, r_ocean) && newDistance > minDistance) { minDistance = newDistance; }
+				bool ocean = IsTriangleOceanCached(neighbor_t, Mesh, r_ocean);
+				if (ocean && newDistance > minDistance) { minDistance = newDistance; }
 				// If this tile is land, see if we need to update how far away this land tile is from a coast
-				else if (!IsTriangleOcean(neighbor_t, Mesh, r_ocean) && newDistance > maxDistance) { maxDistance = newDistance; }
+				else if (!ocean && newDistance > maxDistance) { maxDistance = newDistance; }
 
 				if (lake)
 				{
@@ -212,7 +295,7 @@ void UIslandElevation::RedistributeTriangleElevations_Implementation(TArray<floa
 	TArray<FTriangleIndex> nonocean_t;
 	for (FTriangleIndex t = 0; t < t_elevation.Num(); t++)
 	{
-		if (!IsTriangleOcean(t, Mesh, r_ocean))
+		if (!IsTriangleOceanCached(t, Mesh, r_ocean))
 		{
 			nonocean_t.Add(t);
 		}
@@ -257,22 +340,25 @@ void UIslandElevation::AssignRegionElevations_Implementation(TArray<float>& r_el
 	r_elevation.Empty(Mesh->NumRegions);
 	r_elevation.SetNumZeroed(Mesh->NumRegions);
 
-	TArray<FTriangleIndex> out_t;
-	for (FPointIndex r = 0; r < Mesh->NumRegions; r++)
+	FDualMeshParallel::ForEachChunk(Mesh->NumRegions, [&](int32 Start, int32 End)
 	{
-		out_t = Mesh->r_circulate_t(r);
-		float elevation = 0.0f;
-		for (FTriangleIndex t : out_t)
+		TArray<FTriangleIndex> out_t;
+		for (int32 r = Start; r < End; r++)
 		{
-			elevation += t_elevation[t];
-		}
+			out_t = Mesh->r_circulate_t(r);
+			float elevation = 0.0f;
+			for (FTriangleIndex t : out_t)
+			{
+				elevation += t_elevation[t];
+			}
 
-		r_elevation[r] = elevation / out_t.Num();
-		if (r_ocean[r] && r_elevation[r] > max_ocean_elevation)
-		{
-			r_elevation[r] = max_ocean_elevation;
+			r_elevation[r] = elevation / out_t.Num();
+			if (r_ocean[r] && r_elevation[r] > max_ocean_elevation)
+			{
+				r_elevation[r] = max_ocean_elevation;
+			}
 		}
-	}
+	});
 }
 
 void UIslandElevation::assign_t_elevation(TArray<float>& t_elevation, TArray<int32>& t_coastdistance, TArray<FSideIndex>& t_downslope_s, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, FRandomStream& DrainageRng) const
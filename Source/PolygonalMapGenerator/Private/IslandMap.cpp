@@ -19,17 +19,27 @@
 #include "IslandMap.h"
 #include "DualMeshBuilder.h"
 #include "IslandMapUtils.h"
+#include "IslandMapSnapshot.h"
 #include "TimerManager.h"
+#include "Net/UnrealNetwork.h"
+#include "Hash/CityHash.h"
+#include "DualMeshParallel.h"
+#include "Async/Async.h"
+
+const int32 AIslandMap::GeneratorVersion = 2;
 
 // Sets default values
 AIslandMap::AIslandMap()
 {
 	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+	bAlwaysRelevant = true;
 	bDetermineRandomSeedAtRuntime = false;
 	Seed = 0;
 	DrainageSeed = 1;
 	RiverSeed = 2;
 	NumRivers = 30;
+	bBuildNavigation = true;
 
 #if !UE_BUILD_SHIPPING
 	LastRegenerationTime = FDateTime::MinValue();
@@ -61,8 +71,19 @@ AIslandMap::AIslandMap()
 	GenerateIsland();
 }*/
 
+void AIslandMap::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AIslandMap, Descriptor);
+}
+
 void AIslandMap::BeginPlay()
 {
+	if (GetNetMode() == NM_Client)
+	{
+		// Clients wait for the server to tell them what to generate
+		return;
+	}
 	GenerateIsland();
 }
 
@@ -101,6 +122,56 @@ void AIslandMap::OnIslandGenComplete_Implementation()
 	// Do nothing by default
 }
 
+void AIslandMap::OnRep_Descriptor()
+{
+	if (Descriptor.GeneratorVersion != GeneratorVersion)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Server is on island generator version %d, but we're on version %d."), Descriptor.GeneratorVersion, GeneratorVersion);
+		OnChecksumMismatch();
+		return;
+	}
+
+	Seed = Descriptor.Seed;
+	DrainageSeed = Descriptor.DrainageSeed;
+	RiverSeed = Descriptor.RiverSeed;
+	bDetermineRandomSeedAtRuntime = false;
+	BiomeBias = Descriptor.BiomeBias;
+	Shape = Descriptor.Shape;
+	NumRivers = Descriptor.NumRivers;
+	Smoothing = Descriptor.Smoothing;
+	PointGenerator = Descriptor.PointGenerator;
+	Biomes = Descriptor.Biomes;
+	Elevation = Descriptor.Elevation;
+	Moisture = Descriptor.Moisture;
+	Rivers = Descriptor.Rivers;
+	Water = Descriptor.Water;
+
+	GenerateIsland();
+
+	const uint64 checksum = ComputeChecksum();
+	if (checksum != Descriptor.Checksum)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Generated island checksum %016llx doesn't match the server's checksum %016llx."), checksum, Descriptor.Checksum);
+		OnChecksumMismatch();
+	}
+}
+
+void AIslandMap::OnChecksumMismatch_Implementation()
+{
+	UE_LOG(LogMapGen, Error, TEXT("Island on this client doesn't match the server's island!"));
+}
+
+void AIslandMap::BroadcastGenerationComplete()
+{
+	OnIslandPointGenerationComplete.Broadcast();
+	OnIslandWaterGenerationComplete.Broadcast();
+	OnIslandElevationGenerationComplete.Broadcast();
+	OnIslandRiverGenerationComplete.Broadcast();
+	OnIslandMoistureGenerationComplete.Broadcast();
+	OnIslandBiomeGenerationComplete.Broadcast();
+	OnIslandGenerationComplete.Broadcast();
+}
+
 void AIslandMap::GenerateIsland_Implementation()
 {
 	if (PointGenerator == NULL || Water == NULL || Elevation == NULL || Rivers == NULL || Moisture == NULL || Biomes == NULL)
@@ -159,7 +230,8 @@ void AIslandMap::GenerateIsland_Implementation()
 #endif
 
 	// Reset all arrays
-	CreatedRivers.Empty(NumRivers);
+	RiverNetwork.Empty(NumRivers);
+	RiverViews.Empty();
 	spring_t.Empty();
 	river_t.Empty(NumRivers);
 
@@ -179,19 +251,16 @@ void AIslandMap::GenerateIsland_Implementation()
 
 	s_flow.Empty(Mesh->NumSides);
 	s_flow.SetNumZeroed(Mesh->NumSides);
+	t_flow.Empty(Mesh->NumTriangles);
+	t_flow.SetNumZeroed(Mesh->NumTriangles);
+	t_watershed.Empty(Mesh->NumTriangles);
+	t_watershed.SetNumZeroed(Mesh->NumTriangles);
 
 	r_moisture.Empty(Mesh->NumRegions);
 	r_moisture.SetNumZeroed(Mesh->NumRegions);
 	r_waterdistance.Empty(Mesh->NumRegions);
 	r_waterdistance.SetNumZeroed(Mesh->NumRegions);
 
-	r_coast.Empty(Mesh->NumRegions);
-	r_coast.SetNumZeroed(Mesh->NumRegions);
-	r_temperature.Empty(Mesh->NumRegions);
-	r_temperature.SetNumZeroed(Mesh->NumRegions);
-	r_biome.Empty(Mesh->NumRegions);
-	r_biome.SetNumZeroed(Mesh->NumRegions);
-
 #if !UE_BUILD_SHIPPING
 	finishedTime = FDateTime::UtcNow();
 	difference = finishedTime - startTime;
@@ -202,6 +271,9 @@ void AIslandMap::GenerateIsland_Implementation()
 	// Water
 	Water->assign_r_water(r_water, Rng, Mesh, Shape);
 	Water->assign_r_ocean(r_ocean, Mesh, r_water);
+	Water->assign_r_lake(r_lake_id, Lakes, Mesh, r_water, r_ocean);
+	// Elevation and rivers look at triangle water a lot, so count it up front
+	Mesh->CacheTriangleWater(r_water, r_ocean);
 	OnIslandWaterGenerationComplete.Broadcast();
 
 #if !UE_BUILD_SHIPPING
@@ -215,6 +287,7 @@ void AIslandMap::GenerateIsland_Implementation()
 	Elevation->assign_t_elevation(t_elevation, t_coastdistance, t_downslope_s, Mesh, r_ocean, r_water, DrainageRng);
 	Elevation->redistribute_t_elevation(t_elevation, Mesh, r_ocean);
 	Elevation->assign_r_elevation(r_elevation, Mesh, t_elevation, r_ocean);
+	Water->AssignLakeElevations(Lakes, r_elevation);
 	OnIslandElevationGenerationComplete.Broadcast();
 
 #if !UE_BUILD_SHIPPING
@@ -224,26 +297,48 @@ void AIslandMap::GenerateIsland_Implementation()
 	UE_LOG(LogMapGen, Log, TEXT("Generated map elevation in %f seconds."), difference.GetTotalSeconds());
 #endif
 
+	// Drainage
+	AccumulateFlow();
+
+#if !UE_BUILD_SHIPPING
+	finishedTime = FDateTime::UtcNow();
+	difference = finishedTime - startTime;
+	startTime = finishedTime;
+	UE_LOG(LogMapGen, Log, TEXT("Accumulated flow for %d triangles in %f seconds."), Mesh->NumTriangles, difference.GetTotalSeconds());
+#endif
+
 	// Rivers
-	spring_t = Rivers->find_spring_t(Mesh, r_water, t_elevation, t_downslope_s);
-	UIslandMapUtils::RandomShuffle(spring_t, RiverRng);
-	river_t.SetNum(NumRivers < spring_t.Num() ? NumRivers : spring_t.Num());
-	for (int i = 0; i < river_t.Num(); i++)
+	if (Rivers->RiverFlowThreshold > 0)
 	{
-		river_t[i] = spring_t[i];
+		// Every stream which drains enough land becomes a river
+		spring_t = Rivers->find_river_head_t(Mesh, r_water, t_flow, t_downslope_s);
+		river_t = spring_t;
 	}
-	Rivers->assign_s_flow(s_flow, CreatedRivers, Mesh, t_downslope_s, river_t, RiverRng);
+	else
+	{
+		spring_t = Rivers->find_spring_t(Mesh, r_water, t_elevation, t_downslope_s);
+		UIslandMapUtils::RandomShuffle(spring_t, RiverRng);
+		river_t.SetNum(NumRivers < spring_t.Num() ? NumRivers : spring_t.Num());
+		for (int i = 0; i < river_t.Num(); i++)
+		{
+			river_t[i] = spring_t[i];
+		}
+	}
+	CacheRiverFlags();
+	Rivers->assign_s_flow(s_flow, RiverNetwork, Mesh, t_downslope_s, river_t, RiverRng);
+	// Nothing past this point looks at triangle water, so don't leave a cache around to go stale
+	Mesh->ClearTriangleWaterCache();
 	OnIslandRiverGenerationComplete.Broadcast();
 
 #if !UE_BUILD_SHIPPING
 	finishedTime = FDateTime::UtcNow();
 	difference = finishedTime - startTime;
 	startTime = finishedTime;
-	UE_LOG(LogMapGen, Log, TEXT("Generated %d map rivers in %f seconds."), CreatedRivers.Num(), difference.GetTotalSeconds());
+	UE_LOG(LogMapGen, Log, TEXT("Generated %d map rivers in %f seconds."), RiverNetwork.Num(), difference.GetTotalSeconds());
 #endif
 
 	// Moisture
-	Moisture->assign_r_moisture(r_moisture, r_waterdistance, Mesh, r_water, Moisture->find_moisture_seeds_r(Mesh, s_flow, r_ocean, r_water));
+	Moisture->assign_r_moisture(r_moisture, r_waterdistance, Mesh, r_water, Moisture->find_moisture_seeds_r(Mesh, s_flow, Lakes));
 	Moisture->redistribute_r_moisture(r_moisture, Mesh, r_water, BiomeBias.Rainfall, 1.0f + BiomeBias.Rainfall);
 	OnIslandMoistureGenerationComplete.Broadcast();
 
@@ -255,9 +350,7 @@ void AIslandMap::GenerateIsland_Implementation()
 #endif
 
 	// Biomes
-	Biomes->assign_r_coast(r_coast, Mesh, r_ocean);
-	Biomes->assign_r_temperature(r_temperature, Mesh, r_ocean, r_water, r_elevation, r_moisture, BiomeBias.NorthernTemperature, BiomeBias.SouthernTemperature);
-	Biomes->assign_r_biome(r_biome, Mesh, r_ocean, r_water, r_coast, r_temperature, r_moisture);
+	Biomes->assign_r_coast_temperature_biome(r_coast, r_temperature, r_biome, Mesh, r_ocean, r_water, r_elevation, r_moisture, BiomeBias.NorthernTemperature, BiomeBias.SouthernTemperature);
 	OnIslandBiomeGenerationComplete.Broadcast();
 
 #if !UE_BUILD_SHIPPING
@@ -266,13 +359,109 @@ void AIslandMap::GenerateIsland_Implementation()
 	startTime = finishedTime;
 	UE_LOG(LogMapGen, Log, TEXT("Generated map biomes in %f seconds."), difference.GetTotalSeconds());
 	FTimespan completedTime = finishedTime - LastRegenerationTime;
-	UE_LOG(LogMapGen, Log, TEXT("Total map generation time: %f seconds."), completedTime.GetTotalSeconds());
+	UE_LOG(LogMapGen, Log, TEXT("Total map generation time for %d regions: %f seconds."), Mesh->NumRegions, completedTime.GetTotalSeconds());
 #endif
 
+	CacheSampleAttributes();
+	BuildNavigationGraph();
+
+	// Let clients know how to generate the same island
+	if (HasAuthority() && GetNetMode() != NM_Standalone)
+	{
+		Descriptor.GeneratorVersion = GeneratorVersion;
+		Descriptor.Seed = Seed;
+		Descriptor.DrainageSeed = DrainageSeed;
+		Descriptor.RiverSeed = RiverSeed;
+		Descriptor.BiomeBias = BiomeBias;
+		Descriptor.Shape = Shape;
+		Descriptor.NumRivers = NumRivers;
+		Descriptor.Smoothing = Smoothing;
+		Descriptor.PointGenerator = PointGenerator;
+		Descriptor.Biomes = Biomes;
+		Descriptor.Elevation = Elevation;
+		Descriptor.Moisture = Moisture;
+		Descriptor.Rivers = Rivers;
+		Descriptor.Water = Water;
+		Descriptor.Checksum = ComputeChecksum();
+	}
+
 	// Do whatever we need to do when the island generation is done
 	OnIslandGenerationComplete.Broadcast();
 }
 
+bool AIslandMap::SaveSnapshot(const FString& Path, bool bQuantizeFloats) const
+{
+	return FIslandMapSnapshot::SaveToFile(this, Path, bQuantizeFloats);
+}
+
+bool AIslandMap::LoadSnapshot(const FString& Path)
+{
+	if (!FIslandMapSnapshot::LoadFromFile(this, Path))
+	{
+		return false;
+	}
+	CacheDerivedData();
+	BroadcastGenerationComplete();
+	return true;
+}
+
+bool AIslandMap::SaveSnapshotToBytes(TArray<uint8>& OutBytes, bool bQuantizeFloats) const
+{
+	return FIslandMapSnapshot::Save(this, OutBytes, bQuantizeFloats);
+}
+
+bool AIslandMap::LoadSnapshotFromBytes(const TArray<uint8>& Bytes)
+{
+	if (!FIslandMapSnapshot::Load(this, Bytes.GetData(), Bytes.Num()))
+	{
+		return false;
+	}
+	CacheDerivedData();
+	BroadcastGenerationComplete();
+	return true;
+}
+
+uint64 AIslandMap::ComputeChecksum() const
+{
+	if (Mesh == NULL)
+	{
+		return 0;
+	}
+
+	// Positions are hashed to the nearest unit, so tiny floating point differences between
+	// machines don't count as a mismatch. Everything else hashed here is discrete, but still
+	// depends on elevation, so a client with noticeably different elevation will still be caught.
+	const TArray<FVector2D>& points = Mesh->GetRawMesh().Coordinates;
+	TArray<int32> values;
+	values.SetNumUninitialized(points.Num() * 2);
+	for (int32 i = 0; i < points.Num(); i++)
+	{
+		values[2 * i] = FMath::RoundToInt(points[i].X);
+		values[2 * i + 1] = FMath::RoundToInt(points[i].Y);
+	}
+	uint64 hash = CityHash64((const char*)values.GetData(), values.Num() * sizeof(int32));
+
+	hash = CityHash64WithSeed((const char*)r_water.GetData(), r_water.Num() * sizeof(bool), hash);
+	hash = CityHash64WithSeed((const char*)r_ocean.GetData(), r_ocean.Num() * sizeof(bool), hash);
+	hash = CityHash64WithSeed((const char*)r_coast.GetData(), r_coast.Num() * sizeof(bool), hash);
+
+	values.SetNumUninitialized(t_downslope_s.Num());
+	for (int32 t = 0; t < t_downslope_s.Num(); t++)
+	{
+		values[t] = t_downslope_s[t].IsValid() ? (int32)t_downslope_s[t].Value : -1;
+	}
+	hash = CityHash64WithSeed((const char*)values.GetData(), values.Num() * sizeof(int32), hash);
+	hash = CityHash64WithSeed((const char*)s_flow.GetData(), s_flow.Num() * sizeof(int32), hash);
+
+	values.SetNumUninitialized(river_t.Num());
+	for (int32 i = 0; i < river_t.Num(); i++)
+	{
+		values[i] = (int32)river_t[i].Value;
+	}
+	hash = CityHash64WithSeed((const char*)values.GetData(), values.Num() * sizeof(int32), hash);
+	return hash;
+}
+
 TArray<FIslandPolygon>& AIslandMap::GetVoronoiPolygons()
 {
 	if (VoronoiPolygons.Num() == 0)
@@ -297,6 +486,247 @@ TArray<FIslandPolygon>& AIslandMap::GetVoronoiPolygons()
 	return VoronoiPolygons;
 }
 
+FPointIndex AIslandMap::FindRegionAt(const FVector2D& Position) const
+{
+	if (Mesh == NULL)
+	{
+		return FPointIndex();
+	}
+	return Mesh->FindRegionAt(Position);
+}
+
+FTriangleIndex AIslandMap::FindTriangleAt(const FVector2D& Position) const
+{
+	if (Mesh == NULL)
+	{
+		return FTriangleIndex();
+	}
+	return Mesh->FindTriangleAt(Position);
+}
+
+void AIslandMap::FindRegionsAt(const TArray<FVector2D>& Positions, TArray<FPointIndex>& OutRegions) const
+{
+	if (Mesh == NULL)
+	{
+		OutRegions.Init(FPointIndex(), Positions.Num());
+		return;
+	}
+	Mesh->FindRegionsAt(Positions, OutRegions);
+}
+
+void AIslandMap::CacheDerivedData()
+{
+	if (Water != NULL && Mesh != NULL)
+	{
+		Water->assign_r_lake(r_lake_id, Lakes, Mesh, r_water, r_ocean);
+		Water->AssignLakeElevations(Lakes, r_elevation);
+	}
+	else
+	{
+		r_lake_id.Empty();
+		Lakes.Empty();
+	}
+	if (Mesh != NULL)
+	{
+		Mesh->CacheTriangleWater(r_water, r_ocean);
+	}
+	AccumulateFlow();
+	if (Mesh != NULL)
+	{
+		Mesh->ClearTriangleWaterCache();
+	}
+	CacheRiverFlags();
+	CacheSampleAttributes();
+	BuildNavigationGraph();
+}
+
+void AIslandMap::AccumulateFlow()
+{
+	if (Rivers == NULL || Mesh == NULL)
+	{
+		t_flow.Empty();
+		t_watershed.Empty();
+		return;
+	}
+	Rivers->assign_t_flow(t_flow, t_watershed, Mesh, t_downslope_s, r_ocean);
+}
+
+void AIslandMap::CacheRiverFlags()
+{
+	const int32 numTriangles = Mesh != NULL ? Mesh->NumTriangles : 0;
+	t_spring.Init(false, numTriangles);
+	t_river.Init(false, numTriangles);
+	for (FTriangleIndex t : spring_t)
+	{
+		if (t.IsValid() && (int32)t < numTriangles)
+		{
+			t_spring[(int32)t] = true;
+		}
+	}
+	for (FTriangleIndex t : river_t)
+	{
+		if (t.IsValid() && (int32)t < numTriangles)
+		{
+			t_river[(int32)t] = true;
+		}
+	}
+}
+
+void AIslandMap::CacheSampleAttributes()
+{
+	const int32 numRegions = r_elevation.Num();
+	if (r_moisture.Num() != numRegions || r_temperature.Num() != numRegions)
+	{
+		r_sample_attributes.Empty();
+		return;
+	}
+	r_sample_attributes.SetNumUninitialized(numRegions);
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
+	{
+		r_sample_attributes[r] = FVector4(r_elevation[r], r_moisture[r], r_temperature[r], 0.0f);
+	});
+}
+
+VectorRegister AIslandMap::BlendAttributesAt(const FVector2D& Position, FTriangleIndex& InOutTriangle) const
+{
+	if (Mesh == NULL || r_sample_attributes.Num() != Mesh->NumRegions)
+	{
+		return VectorZero();
+	}
+
+	const FTriangleIndex t = Mesh->FindTriangleAt(Position, InOutTriangle);
+	if (!t.IsValid())
+	{
+		// Off the mesh, so just use the closest region
+		const FPointIndex r = Mesh->FindRegionAt(Position);
+		return r.IsValid() ? VectorLoadAligned(&r_sample_attributes[r]) : VectorZero();
+	}
+	InOutTriangle = t;
+
+	const TArray<FPointIndex>& corners = Mesh->GetRawMesh().DelaunayTriangles;
+	const FVector weights = Mesh->t_barycentric(t, Position);
+	VectorRegister result = VectorMultiply(VectorLoadAligned(&r_sample_attributes[corners[3 * t]]), VectorSetFloat1(weights.X));
+	result = VectorMultiplyAdd(VectorLoadAligned(&r_sample_attributes[corners[3 * t + 1]]), VectorSetFloat1(weights.Y), result);
+	result = VectorMultiplyAdd(VectorLoadAligned(&r_sample_attributes[corners[3 * t + 2]]), VectorSetFloat1(weights.Z), result);
+	return result;
+}
+
+void AIslandMap::BuildNavigationGraph()
+{
+	if (!bBuildNavigation || Mesh == NULL)
+	{
+		NavigationGraph.Reset();
+		return;
+	}
+
+#if !UE_BUILD_SHIPPING
+	FDateTime startTime = FDateTime::UtcNow();
+#endif
+
+	NavigationGraph = MakeShared<FIslandNavigationGraph, ESPMode::ThreadSafe>(Mesh, r_elevation, r_water, r_ocean, s_flow, NavigationSettings);
+
+#if !UE_BUILD_SHIPPING
+	FTimespan difference = FDateTime::UtcNow() - startTime;
+	UE_LOG(LogMapGen, Log, TEXT("Built a navigation graph with %d clusters and %d entrances in %f seconds."), NavigationGraph->GetNumClusters(), NavigationGraph->GetNumEntrances(), difference.GetTotalSeconds());
+#endif
+}
+
+bool AIslandMap::FindPath(FPointIndex Start, FPointIndex Goal, TArray<FPointIndex>& OutPath) const
+{
+	if (!NavigationGraph.IsValid())
+	{
+		OutPath.Empty();
+		return false;
+	}
+	return NavigationGraph->FindPath(Start, Goal, OutPath);
+}
+
+void AIslandMap::RequestPath(FPointIndex Start, FPointIndex Goal, FOnIslandPathFound OnPathFound) const
+{
+	TSharedPtr<const FIslandNavigationGraph, ESPMode::ThreadSafe> graph = NavigationGraph;
+	Async<void>(EAsyncExecution::ThreadPool, [graph, Start, Goal, OnPathFound]()
+	{
+		TArray<FPointIndex> path;
+		if (graph.IsValid())
+		{
+			graph->FindPath(Start, Goal, path);
+		}
+		AsyncTask(ENamedThreads::GameThread, [OnPathFound, path]()
+		{
+			OnPathFound.ExecuteIfBound(path);
+		});
+	});
+}
+
+TFuture<TArray<FPointIndex>> AIslandMap::FindPathAsync(FPointIndex Start, FPointIndex Goal) const
+{
+	TSharedPtr<const FIslandNavigationGraph, ESPMode::ThreadSafe> graph = NavigationGraph;
+	return Async<TArray<FPointIndex>>(EAsyncExecution::ThreadPool, [graph, Start, Goal]()
+	{
+		TArray<FPointIndex> path;
+		if (graph.IsValid())
+		{
+			graph->FindPath(Start, Goal, path);
+		}
+		return path;
+	});
+}
+
+TSharedPtr<const FIslandNavigationGraph, ESPMode::ThreadSafe> AIslandMap::GetNavigationGraph() const
+{
+	return NavigationGraph;
+}
+
+float AIslandMap::SampleElevation(const FVector2D& Position) const
+{
+	return SampleAttributesAt(Position).Elevation;
+}
+
+float AIslandMap::SampleMoisture(const FVector2D& Position) const
+{
+	return SampleAttributesAt(Position).Moisture;
+}
+
+float AIslandMap::SampleTemperature(const FVector2D& Position) const
+{
+	return SampleAttributesAt(Position).Temperature;
+}
+
+FIslandAttributeSample AIslandMap::SampleAttributesAt(const FVector2D& Position) const
+{
+	FTriangleIndex t;
+	FVector4 values;
+	VectorStoreAligned(BlendAttributesAt(Position, t), &values);
+
+	FIslandAttributeSample sample;
+	sample.Elevation = values.X;
+	sample.Moisture = values.Y;
+	sample.Temperature = values.Z;
+	return sample;
+}
+
+void AIslandMap::SampleAttributesBatch(const TArray<FVector2D>& Positions, TArray<FIslandAttributeSample>& OutSamples) const
+{
+	SampleAttributes(Positions, OutSamples);
+}
+
+void AIslandMap::SampleAttributes(TArrayView<const FVector2D> Positions, TArray<FIslandAttributeSample>& OutSamples) const
+{
+	OutSamples.SetNumUninitialized(Positions.Num());
+	FDualMeshParallel::ForEachChunk(Positions.Num(), [&](int32 Start, int32 End)
+	{
+		FTriangleIndex t;
+		FVector4 values;
+		for (int32 i = Start; i < End; i++)
+		{
+			VectorStoreAligned(BlendAttributesAt(Positions[i], t), &values);
+			OutSamples[i].Elevation = values.X;
+			OutSamples[i].Moisture = values.Y;
+			OutSamples[i].Temperature = values.Z;
+		}
+	});
+}
+
 TArray<bool>& AIslandMap::GetWaterRegions()
 {
 	return r_water;
@@ -433,6 +863,33 @@ FBiomeData AIslandMap::GetPointBiome(FPointIndex Region) const
 	}
 }
 
+TArray<int32>& AIslandMap::GetRegionLakeIds()
+{
+	return r_lake_id;
+}
+
+int32 AIslandMap::GetRegionLakeId(FPointIndex Region) const
+{
+	if (r_lake_id.IsValidIndex(Region))
+	{
+		return r_lake_id[Region];
+	}
+	else
+	{
+		return -1;
+	}
+}
+
+TArray<FIslandLake>& AIslandMap::GetLakes()
+{
+	return Lakes;
+}
+
+int32 AIslandMap::GetNumLakes() const
+{
+	return Lakes.Num();
+}
+
 TArray<int32>& AIslandMap::GetTriangleCoastDistances()
 {
 	return t_coastdistance;
@@ -477,6 +934,78 @@ TArray<int32>& AIslandMap::GetSideFlow()
 	return s_flow;
 }
 
+TArray<int32>& AIslandMap::GetTriangleFlow()
+{
+	return t_flow;
+}
+
+int32 AIslandMap::GetTriangleFlowAt(FTriangleIndex Triangle) const
+{
+	if (t_flow.IsValidIndex(Triangle))
+	{
+		return t_flow[Triangle];
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+TArray<int32>& AIslandMap::GetTriangleWatersheds()
+{
+	return t_watershed;
+}
+
+int32 AIslandMap::GetTriangleWatershed(FTriangleIndex Triangle) const
+{
+	if (t_watershed.IsValidIndex(Triangle))
+	{
+		return t_watershed[Triangle];
+	}
+	else
+	{
+		return -1;
+	}
+}
+
+FIslandRiverNetwork& AIslandMap::GetRiverNetwork()
+{
+	return RiverNetwork;
+}
+
+const FIslandRiverNetwork& AIslandMap::GetRiverNetwork() const
+{
+	return RiverNetwork;
+}
+
+int32 AIslandMap::GetNumRivers() const
+{
+	return RiverNetwork.Num();
+}
+
+TArray<URiver*> AIslandMap::GetRivers()
+{
+	if (RiverViews.Num() == RiverNetwork.Num())
+	{
+		return RiverViews;
+	}
+
+	RiverViews.Empty(RiverNetwork.Num());
+	for (int32 i = 0; i < RiverNetwork.Num(); i++)
+	{
+		URiver* river = NewObject<URiver>(this);
+		river->RiverTriangles = TArray<FTriangleIndex>(RiverNetwork.GetTriangles(i).GetData(), RiverNetwork.Length(i));
+		river->Downslopes = TArray<FSideIndex>(RiverNetwork.GetDownslopes(i).GetData(), RiverNetwork.Length(i));
+		RiverViews.Add(river);
+	}
+	for (int32 i = 0; i < RiverNetwork.Num(); i++)
+	{
+		const int32 feedsInto = RiverNetwork.FeedsInto[i];
+		RiverViews[i]->FeedsInto = RiverViews.IsValidIndex(feedsInto) ? RiverViews[feedsInto] : NULL;
+	}
+	return RiverViews;
+}
+
 TArray<FTriangleIndex>& AIslandMap::GetSpringTriangles()
 {
 	return spring_t;
@@ -484,7 +1013,7 @@ TArray<FTriangleIndex>& AIslandMap::GetSpringTriangles()
 
 bool AIslandMap::IsTriangleSpring(FTriangleIndex Triangle) const
 {
-	return spring_t.Contains(Triangle);
+	return Triangle.IsValid() && (int32)Triangle < t_spring.Num() && t_spring[(int32)Triangle];
 }
 
 TArray<FTriangleIndex>& AIslandMap::GetRiverTriangles()
@@ -494,5 +1023,5 @@ TArray<FTriangleIndex>& AIslandMap::GetRiverTriangles()
 
 bool AIslandMap::IsTriangleRiver(FTriangleIndex Triangle) const
 {
-	return river_t.Contains(Triangle);
+	return Triangle.IsValid() && (int32)Triangle < t_river.Num() && t_river[(int32)Triangle];
 }
@@ -1,14 +1,52 @@
 // Copyright 2018 Schemepunk Studios
 
 #include "IslandMapMesh.h"
+#include "DualMeshParallel.h"
+#include "Async/Async.h"
+#include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
 
 AIslandMapMesh::AIslandMapMesh()
 {
 	ZScale = 10000.0f;
+	bChunkMesh = false;
+	ChunksPerSide = 8;
+	bSimplifiedCollision = true;
+	CollisionVertexSpacing = 4000.0f;
+	CollisionBuildId = 0;
+	NumLODs = 4;
+	LODVertexSpacing = 2500.0f;
+	LODDistance = 20000.0f;
+	NumChunkLODs = 1;
+	bMergeDeepOcean = false;
+	DeepOceanCoastDistance = 3;
+	DeepOceanCellSize = 8000.0f;
+
+	// Only ticks while there are chunk LODs to pick between
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickInterval = 0.25f;
 
 	MapMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("GeneratedMesh"));
 	RootComponent = MapMesh;
 	MapMesh->bUseAsyncCooking = true;
+
+	CollisionMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("CollisionMesh"));
+	CollisionMesh->SetupAttachment(MapMesh);
+	CollisionMesh->bUseAsyncCooking = true;
+	CollisionMesh->SetHiddenInGame(true);
+	CollisionMesh->bCastDynamicShadow = false;
+}
+
+void AIslandMapMesh::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	APlayerCameraManager* camera = UGameplayStatics::GetPlayerCameraManager(this, 0);
+	if (camera != NULL)
+	{
+		UpdateChunkLODs(camera->GetCameraLocation());
+	}
 }
 
 void AIslandMapMesh::OnIslandGenComplete_Implementation()
@@ -18,5 +56,339 @@ void AIslandMapMesh::OnIslandGenComplete_Implementation()
 
 void AIslandMapMesh::CreateIslandMesh()
 {
-	UIslandMapUtils::GenerateMesh(this, MapMesh, ZScale);
+	if (bSimplifiedCollision)
+	{
+		CreateCollisionMesh();
+		if (GetNetMode() == NM_DedicatedServer)
+		{
+			// Dedicated servers never render anything, so collision is all they need
+			return;
+		}
+	}
+	else
+	{
+		CollisionMesh->ClearAllMeshSections();
+	}
+
+	if (bChunkMesh)
+	{
+		CreateChunkMeshes();
+	}
+	else if (bMergeDeepOcean)
+	{
+		UIslandMapUtils::GenerateMapMeshMergedOcean(Mesh, MapMesh, ZScale, r_elevation, r_coast, r_biome, r_ocean, t_coastdistance, DeepOceanCoastDistance, DeepOceanCellSize, !bSimplifiedCollision);
+	}
+	else
+	{
+		UIslandMapUtils::GenerateMesh(this, MapMesh, ZScale, !bSimplifiedCollision);
+	}
+}
+
+void AIslandMapMesh::CreateCollisionMesh()
+{
+	CollisionMesh->ClearAllMeshSections();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+
+	// The mesh can be regenerated or reloaded on the game thread while we're building,
+	// so the worker gets its own copy of everything it reads and never touches a UObject
+	const int32 buildId = ++CollisionBuildId;
+	TWeakObjectPtr<AIslandMapMesh> weakThis(this);
+	TSharedRef<FMapMeshPoints, ESPMode::ThreadSafe> points = MakeShared<FMapMeshPoints, ESPMode::ThreadSafe>(Mesh);
+	TArray<float> elevation = r_elevation;
+	const float zScale = ZScale;
+	const float spacing = CollisionVertexSpacing;
+
+	Async<void>(EAsyncExecution::ThreadPool, [weakThis, points, elevation, zScale, spacing, buildId]()
+	{
+		TSharedRef<TArray<FVector>, ESPMode::ThreadSafe> vertices = MakeShared<TArray<FVector>, ESPMode::ThreadSafe>();
+		TSharedRef<TArray<int32>, ESPMode::ThreadSafe> triangles = MakeShared<TArray<int32>, ESPMode::ThreadSafe>();
+		UIslandMapUtils::BuildSimplifiedCollision(points.Get(), zScale, elevation, spacing, vertices.Get(), triangles.Get());
+
+		// Sections have to be created on the game thread; the physics cooking itself stays async
+		AsyncTask(ENamedThreads::GameThread, [weakThis, vertices, triangles, buildId]()
+		{
+			AIslandMapMesh* map = weakThis.Get();
+			if (map == NULL || map->CollisionBuildId != buildId)
+			{
+				return;
+			}
+			map->CollisionMesh->CreateMeshSection(0, vertices.Get(), triangles.Get(), TArray<FVector>(), TArray<FVector2D>(), TArray<FColor>(), TArray<FProcMeshTangent>(), true);
+			map->CollisionMesh->SetMeshSectionVisible(0, false);
+		});
+	});
+}
+
+void AIslandMapMesh::CreateChunkMeshes()
+{
+	MapMesh->ClearAllMeshSections();
+	for (UProceduralMeshComponent* chunkMesh : ChunkMeshes)
+	{
+		if (chunkMesh != NULL)
+		{
+			chunkMesh->DestroyComponent();
+		}
+	}
+	ChunkMeshes.Empty();
+	for (UProceduralMeshComponent* chunkMesh : ChunkLODMeshes)
+	{
+		if (chunkMesh != NULL)
+		{
+			chunkMesh->DestroyComponent();
+		}
+	}
+	ChunkLODMeshes.Empty();
+	LODRegionMaps.Empty();
+	NumChunkLODs = 1;
+	SetActorTickEnabled(false);
+
+	if (Mesh == NULL)
+	{
+		return;
+	}
+
+	UIslandMapUtils::AssignTriangleChunks(Mesh, ChunksPerSide, t_chunk, ChunkOffsets, ChunkTriangles);
+	const int32 numChunks = ChunkOffsets.Num() - 1;
+	ChunkMeshes.SetNum(numChunks);
+	for (int32 i = 0; i < numChunks; i++)
+	{
+		UProceduralMeshComponent* chunkMesh = NewObject<UProceduralMeshComponent>(this, *FString::Printf(TEXT("MapChunk%d"), i));
+		chunkMesh->bUseAsyncCooking = true;
+		chunkMesh->SetupAttachment(MapMesh);
+		chunkMesh->RegisterComponent();
+		ChunkMeshes[i] = chunkMesh;
+	}
+	ChunkLODs.Init(0, numChunks);
+
+	CreateChunkLODs();
+	MarkAllChunksDirty();
+	RebuildDirtyChunks();
+}
+
+void AIslandMapMesh::CreateChunkLODs()
+{
+	if (NumLODs <= 1)
+	{
+		return;
+	}
+
+	const int32 numRegions = Mesh->NumRegions;
+	const int32 numChunks = ChunkMeshes.Num();
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+
+	// Coastlines, rivers, and anything on the edge of a chunk stay at full detail.
+	// Keeping the chunk edges the same at every LOD means neighboring chunks always meet without cracks.
+	// Regions only cluster with other regions in the same chunk which are the same kind of water.
+	TArray<bool> preservedRegions;
+	TArray<int32> regionGroups;
+	preservedRegions.SetNumUninitialized(numRegions);
+	regionGroups.SetNumUninitialized(numRegions);
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
+	{
+		const int32 firstSide = r_side_offsets[r];
+		const int32 lastSide = r_side_offsets[r + 1];
+		const int32 chunk = firstSide < lastSide ? t_chunk[r_sides[firstSide] / 3] : 0;
+		bool bPreserve = r_coast.IsValidIndex(r) && r_coast[r];
+		for (int32 i = firstSide; i < lastSide && !bPreserve; i++)
+		{
+			const int32 s = r_sides[i];
+			const FSideIndex opposite = Mesh->s_opposite_s(s);
+			bPreserve = t_chunk[s / 3] != chunk
+				|| (s_flow.IsValidIndex(s) && s_flow[s] > 0)
+				|| (opposite.IsValid() && s_flow.IsValidIndex(opposite) && s_flow[opposite] > 0);
+		}
+		preservedRegions[r] = bPreserve;
+		regionGroups[r] = 2 * chunk + (r_water.IsValidIndex(r) && r_water[r] ? 1 : 0);
+	});
+
+	NumChunkLODs = NumLODs;
+	UIslandMapUtils::BuildLODRegionMaps(Mesh, NumChunkLODs - 1, LODVertexSpacing, preservedRegions, regionGroups, LODRegionMaps);
+
+	// The ghost chunk sits under the map, so it only needs the one level of detail
+	const int32 ghostChunk = numChunks - 1;
+	ChunkLODMeshes.SetNumZeroed((NumChunkLODs - 1) * numChunks);
+	for (int32 lod = 1; lod < NumChunkLODs; lod++)
+	{
+		for (int32 i = 0; i < ghostChunk; i++)
+		{
+			UProceduralMeshComponent* chunkMesh = NewObject<UProceduralMeshComponent>(this, *FString::Printf(TEXT("MapChunk%d_LOD%d"), i, lod));
+			chunkMesh->SetupAttachment(MapMesh);
+			chunkMesh->SetVisibility(false);
+			chunkMesh->RegisterComponent();
+			ChunkLODMeshes[(lod - 1) * numChunks + i] = chunkMesh;
+		}
+	}
+	SetActorTickEnabled(true);
+}
+
+UProceduralMeshComponent* AIslandMapMesh::GetChunkMesh(int32 Chunk, int32 LOD) const
+{
+	if (LOD == 0)
+	{
+		return ChunkMeshes.IsValidIndex(Chunk) ? ChunkMeshes[Chunk] : NULL;
+	}
+	const int32 index = (LOD - 1) * ChunkMeshes.Num() + Chunk;
+	return ChunkLODMeshes.IsValidIndex(index) ? ChunkLODMeshes[index] : NULL;
+}
+
+void AIslandMapMesh::MarkRegionsDirty(const TArray<FPointIndex>& Regions)
+{
+	if (Mesh == NULL || !bChunkMesh || DirtyChunks.Num() == 0)
+	{
+		return;
+	}
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	for (FPointIndex r : Regions)
+	{
+		if (!r.IsValid() || r >= (SIZE_T)Mesh->NumRegions)
+		{
+			continue;
+		}
+		// A region's vertices show up in every triangle around it
+		for (int32 i = r_side_offsets[r]; i < r_side_offsets[r + 1]; i++)
+		{
+			DirtyChunks[t_chunk[r_sides[i] / 3]] = true;
+		}
+	}
+}
+
+void AIslandMapMesh::MarkAllChunksDirty()
+{
+	DirtyChunks.Init(true, ChunkMeshes.Num());
+}
+
+void AIslandMapMesh::RebuildDirtyChunks()
+{
+	if (Mesh == NULL || !bChunkMesh)
+	{
+		return;
+	}
+
+	TArray<int32> dirty;
+	for (int32 i = 0; i < DirtyChunks.Num(); i++)
+	{
+		if (DirtyChunks[i] && ChunkMeshes.IsValidIndex(i) && ChunkMeshes[i] != NULL)
+		{
+			dirty.Add(i);
+		}
+	}
+	if (dirty.Num() == 0)
+	{
+		return;
+	}
+
+	// Build every level of detail of every dirty chunk in parallel...
+	const int32 numChunks = ChunkMeshes.Num();
+	const int32 numJobs = dirty.Num() * NumChunkLODs;
+	TArray<TArray<FMapMeshData>> chunkSections;
+	TArray<TArray<UMaterialInterface*>> chunkMaterials;
+	chunkSections.SetNum(numJobs);
+	chunkMaterials.SetNum(numJobs);
+	ChunkTriangleCounts.SetNumZeroed(numChunks * NumChunkLODs);
+	FDualMeshParallel::ForEach(numJobs, [&](int32 i)
+	{
+		const int32 chunk = dirty[i % dirty.Num()];
+		const int32 lod = i / dirty.Num();
+		if (GetChunkMesh(chunk, lod) == NULL)
+		{
+			return;
+		}
+
+		TArrayView<const int32> triangles(ChunkTriangles.GetData() + ChunkOffsets[chunk], ChunkOffsets[chunk + 1] - ChunkOffsets[chunk]);
+		if (lod == 0)
+		{
+			UIslandMapUtils::BuildBiomeSections(Mesh, triangles, ZScale, r_elevation, r_coast, r_biome, chunkSections[i], chunkMaterials[i]);
+			ChunkTriangleCounts[chunk] = triangles.Num();
+		}
+		else
+		{
+			TArray<int32> regionTriangles;
+			UIslandMapUtils::CollapseTriangles(Mesh, triangles, LODRegionMaps[lod - 1], regionTriangles);
+			UIslandMapUtils::BuildRegionBiomeSections(Mesh, regionTriangles, ZScale, r_elevation, r_coast, r_biome, chunkSections[i], chunkMaterials[i]);
+			ChunkTriangleCounts[lod * numChunks + chunk] = regionTriangles.Num() / 3;
+		}
+	}, 1);
+
+	// ...then hand them over to their components on this thread
+	for (int32 i = 0; i < numJobs; i++)
+	{
+		const int32 chunk = dirty[i % dirty.Num()];
+		const int32 lod = i / dirty.Num();
+		UProceduralMeshComponent* chunkMesh = GetChunkMesh(chunk, lod);
+		if (chunkMesh == NULL)
+		{
+			continue;
+		}
+		chunkMesh->ClearAllMeshSections();
+		// Only the full-detail mesh ever has collision
+		UIslandMapUtils::CreateBiomeSections(chunkMesh, chunkSections[i], chunkMaterials[i], lod == 0 && !bSimplifiedCollision);
+		DirtyChunks[chunk] = false;
+	}
+
+	UE_LOG(LogMapGen, Log, TEXT("Rebuilt %d of %d map chunks."), dirty.Num(), numChunks);
+	for (int32 lod = 1; lod < NumChunkLODs; lod++)
+	{
+		int32 fullTriangles = 0;
+		int32 lodTriangles = 0;
+		for (int32 chunk : dirty)
+		{
+			if (GetChunkMesh(chunk, lod) != NULL)
+			{
+				fullTriangles += ChunkTriangleCounts[chunk];
+				lodTriangles += ChunkTriangleCounts[lod * numChunks + chunk];
+			}
+		}
+		UE_LOG(LogMapGen, Log, TEXT("LOD %d has %d triangles, %.1f%% of the %d at full detail."), lod, lodTriangles, fullTriangles > 0 ? 100.0f * lodTriangles / fullTriangles : 0.0f, fullTriangles);
+	}
+}
+
+void AIslandMapMesh::UpdateChunkLODs(const FVector& ViewLocation)
+{
+	if (NumChunkLODs <= 1)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < ChunkMeshes.Num(); i++)
+	{
+		if (ChunkMeshes[i] == NULL || !ChunkLODs.IsValidIndex(i))
+		{
+			continue;
+		}
+
+		// Every LOD covers the same area, so the full-detail bounds work for all of them
+		const float distance = FMath::Sqrt(ChunkMeshes[i]->Bounds.GetBox().ComputeSquaredDistanceToPoint(ViewLocation));
+		int32 lod = 0;
+		float switchDistance = LODDistance;
+		while (lod + 1 < NumChunkLODs && distance >= switchDistance && GetChunkMesh(i, lod + 1) != NULL)
+		{
+			lod++;
+			switchDistance *= 2.0f;
+		}
+
+		if (lod != ChunkLODs[i])
+		{
+			GetChunkMesh(i, ChunkLODs[i])->SetVisibility(false);
+			GetChunkMesh(i, lod)->SetVisibility(true);
+			ChunkLODs[i] = lod;
+		}
+	}
+}
+
+int32 AIslandMapMesh::GetVisibleTriangleCount() const
+{
+	int32 count = 0;
+	for (int32 i = 0; i < ChunkLODs.Num(); i++)
+	{
+		const int32 index = ChunkLODs[i] * ChunkMeshes.Num() + i;
+		if (ChunkTriangleCounts.IsValidIndex(index))
+		{
+			count += ChunkTriangleCounts[index];
+		}
+	}
+	return count;
 }
@@ -0,0 +1,831 @@
+/*
+* From http://www.redblobgames.com/maps/mapgen2/
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* A compact binary snapshot of a fully generated island.
+*/
+
+#include "IslandMapSnapshot.h"
+#include "IslandMap.h"
+#include "DualMeshCache.h"
+#include "DualMeshParallel.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+
+const uint32 FIslandMapSnapshot::Version = 1;
+
+namespace IslandMapSnapshot
+{
+	// "ISNP"
+	static const uint32 Magic = 0x504E5349;
+	// zlib can't expand data by more than about 1032:1, so anything claiming more than this is lying
+	static const int64 MaxCompressionRatio = 1032;
+	static const int64 SectionAlignment = 16;
+	static const TCHAR* MeshKey = TEXT("IslandMapSnapshot");
+
+	enum ESection
+	{
+		Info,
+		Mesh,
+		RegionFlags,
+		Elevation,
+		Climate,
+		Distances,
+		Flow,
+		Biomes,
+		Rivers,
+		NumSections
+	};
+
+	static const TCHAR* SectionNames[NumSections] =
+	{
+		TEXT("Info"),
+		TEXT("Mesh"),
+		TEXT("Region Flags"),
+		TEXT("Elevation"),
+		TEXT("Climate"),
+		TEXT("Distances"),
+		TEXT("Flow"),
+		TEXT("Biomes"),
+		TEXT("Rivers")
+	};
+
+	// Set on a section if it's stored zlib compressed
+	static const uint32 SectionCompressed = 1;
+
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 NumSections;
+		uint32 Padding;
+	};
+
+	struct FSectionEntry
+	{
+		uint32 Flags;
+		// CRC of the uncompressed bytes
+		uint32 Crc;
+		int64 Offset;
+		int64 RawSize;
+		int64 StoredSize;
+	};
+
+	static int64 ToInt(int32 Value)
+	{
+		return Value;
+	}
+
+	static int64 ToInt(const FSideIndex& Value)
+	{
+		return Value.IsValid() ? (int64)Value.Value : -1;
+	}
+
+	static int64 ToInt(const FTriangleIndex& Value)
+	{
+		return Value.IsValid() ? (int64)Value.Value : -1;
+	}
+
+	static void FromInt(int64 Value, int32& OutValue)
+	{
+		OutValue = (int32)Value;
+	}
+
+	static void FromInt(int64 Value, FSideIndex& OutValue)
+	{
+		OutValue = Value < 0 ? INVALID_DELAUNAY_INDEX : (SIZE_T)Value;
+	}
+
+	static void FromInt(int64 Value, FTriangleIndex& OutValue)
+	{
+		OutValue = Value < 0 ? INVALID_DELAUNAY_INDEX : (SIZE_T)Value;
+	}
+
+	struct FWriter
+	{
+		TArray<uint8> Bytes;
+
+		void Write(const void* Data, int64 Size)
+		{
+			const int32 start = Bytes.AddUninitialized((int32)Size);
+			FMemory::Memcpy(Bytes.GetData() + start, Data, Size);
+		}
+
+		template<typename T>
+		void WritePod(const T& Value)
+		{
+			Write(&Value, sizeof(T));
+		}
+
+		void WriteVarInt(uint64 Value)
+		{
+			while (Value >= 0x80)
+			{
+				Bytes.Add((uint8)(Value | 0x80));
+				Value >>= 7;
+			}
+			Bytes.Add((uint8)Value);
+		}
+
+		void WriteSignedVarInt(int64 Value)
+		{
+			// Zig-zag encode, so small negative numbers stay small
+			WriteVarInt(((uint64)Value << 1) ^ (uint64)(Value >> 63));
+		}
+
+		void WriteString(const FString& Value)
+		{
+			FTCHARToUTF8 utf8(*Value);
+			WriteVarInt(utf8.Length());
+			Write(utf8.Get(), utf8.Length());
+		}
+
+		// Neighboring regions, triangles and sides tend to have similar values,
+		// so storing the difference from the last value keeps most of these to a byte or two
+		template<typename T>
+		void WriteDeltas(const TArray<T>& Values)
+		{
+			WriteDeltas(TArrayView<const T>(Values));
+		}
+
+		template<typename T>
+		void WriteDeltas(TArrayView<const T> Values)
+		{
+			WriteVarInt(Values.Num());
+			int64 previous = 0;
+			for (int32 i = 0; i < Values.Num(); i++)
+			{
+				const int64 current = ToInt(Values[i]);
+				WriteSignedVarInt(current - previous);
+				previous = current;
+			}
+		}
+
+		void WriteBits(const TArray<bool>& Values)
+		{
+			WriteVarInt(Values.Num());
+			const int32 start = Bytes.AddZeroed((Values.Num() + 7) / 8);
+			for (int32 i = 0; i < Values.Num(); i++)
+			{
+				if (Values[i])
+				{
+					Bytes[start + i / 8] |= 1 << (i % 8);
+				}
+			}
+		}
+
+		void WriteFloats(const TArray<float>& Values, bool bQuantize)
+		{
+			WriteVarInt(Values.Num());
+			WritePod<uint8>(bQuantize ? 1 : 0);
+			if (!bQuantize)
+			{
+				Write(Values.GetData(), Values.Num() * sizeof(float));
+				return;
+			}
+
+			float min = Values.Num() > 0 ? Values[0] : 0.0f;
+			float max = min;
+			for (float value : Values)
+			{
+				min = FMath::Min(min, value);
+				max = FMath::Max(max, value);
+			}
+			WritePod(min);
+			WritePod(max);
+
+			const float scale = max > min ? 65535.0f / (max - min) : 0.0f;
+			const int32 start = Bytes.AddUninitialized(Values.Num() * sizeof(uint16));
+			for (int32 i = 0; i < Values.Num(); i++)
+			{
+				const uint16 quantized = (uint16)FMath::Clamp(FMath::RoundToInt((Values[i] - min) * scale), 0, 65535);
+				FMemory::Memcpy(Bytes.GetData() + start + i * sizeof(uint16), &quantized, sizeof(uint16));
+			}
+		}
+	};
+
+	struct FReader
+	{
+		const uint8* Data;
+		int64 Size;
+		int64 Offset;
+		bool bError;
+
+		FReader(const uint8* InData, int64 InSize)
+			: Data(InData), Size(InSize), Offset(0), bError(false)
+		{
+		}
+
+		int64 Remaining() const
+		{
+			return Size - Offset;
+		}
+
+		const uint8* Read(int64 Bytes)
+		{
+			if (bError || Bytes < 0 || Bytes > Remaining())
+			{
+				bError = true;
+				return NULL;
+			}
+			const uint8* result = Data + Offset;
+			Offset += Bytes;
+			return result;
+		}
+
+		template<typename T>
+		T ReadPod()
+		{
+			T value;
+			FMemory::Memzero(&value, sizeof(T));
+			if (const uint8* bytes = Read(sizeof(T)))
+			{
+				FMemory::Memcpy(&value, bytes, sizeof(T));
+			}
+			return value;
+		}
+
+		uint64 ReadVarInt()
+		{
+			uint64 value = 0;
+			for (int32 shift = 0; shift < 64; shift += 7)
+			{
+				const uint8* byte = Read(1);
+				if (byte == NULL)
+				{
+					return 0;
+				}
+				value |= (uint64)(*byte & 0x7F) << shift;
+				if ((*byte & 0x80) == 0)
+				{
+					return value;
+				}
+			}
+			bError = true;
+			return 0;
+		}
+
+		int64 ReadSignedVarInt()
+		{
+			const uint64 value = ReadVarInt();
+			return (int64)(value >> 1) ^ -(int64)(value & 1);
+		}
+
+		// Reads an element count, making sure there are enough bytes left for that many elements
+		int32 ReadCount(int64 MinBitsPerElement)
+		{
+			const uint64 count = ReadVarInt();
+			if (bError || count > (uint64)MAX_int32 || (int64)count * MinBitsPerElement > Remaining() * 8)
+			{
+				bError = true;
+				return 0;
+			}
+			return (int32)count;
+		}
+
+		FString ReadString()
+		{
+			const int32 length = ReadCount(8);
+			const uint8* bytes = Read(length);
+			if (bytes == NULL)
+			{
+				return FString();
+			}
+			FUTF8ToTCHAR tchar((const ANSICHAR*)bytes, length);
+			return FString(tchar.Length(), tchar.Get());
+		}
+
+		template<typename T>
+		void ReadDeltas(TArray<T>& OutValues)
+		{
+			const int32 num = ReadCount(8);
+			OutValues.SetNumUninitialized(num);
+			int64 previous = 0;
+			for (int32 i = 0; i < num && !bError; i++)
+			{
+				previous += ReadSignedVarInt();
+				FromInt(previous, OutValues[i]);
+			}
+		}
+
+		void ReadBits(TArray<bool>& OutValues)
+		{
+			const int32 num = ReadCount(1);
+			const uint8* bytes = Read((num + 7) / 8);
+			if (bytes == NULL)
+			{
+				return;
+			}
+			OutValues.SetNumUninitialized(num);
+			for (int32 i = 0; i < num; i++)
+			{
+				OutValues[i] = (bytes[i / 8] & (1 << (i % 8))) != 0;
+			}
+		}
+
+		void ReadFloats(TArray<float>& OutValues)
+		{
+			const int32 num = ReadCount(16);
+			const bool bQuantized = ReadPod<uint8>() != 0;
+			if (!bQuantized)
+			{
+				if (const uint8* bytes = Read((int64)num * sizeof(float)))
+				{
+					OutValues.SetNumUninitialized(num);
+					FMemory::Memcpy(OutValues.GetData(), bytes, num * sizeof(float));
+				}
+				return;
+			}
+
+			const float min = ReadPod<float>();
+			const float max = ReadPod<float>();
+			const uint8* bytes = Read((int64)num * sizeof(uint16));
+			if (bytes == NULL)
+			{
+				return;
+			}
+			const float scale = (max - min) / 65535.0f;
+			OutValues.SetNumUninitialized(num);
+			for (int32 i = 0; i < num; i++)
+			{
+				uint16 quantized;
+				FMemory::Memcpy(&quantized, bytes + i * sizeof(uint16), sizeof(uint16));
+				OutValues[i] = min + quantized * scale;
+			}
+		}
+	};
+
+	// Whether every index is below Limit. Invalid indices only pass if bAllowInvalid is set.
+	template<typename IndexType>
+	static bool AreIndicesBelow(const TArray<IndexType>& Indices, int32 Limit, bool bAllowInvalid)
+	{
+		for (const IndexType& index : Indices)
+		{
+			if (index.IsValid() ? (SIZE_T)index >= (SIZE_T)Limit : !bAllowInvalid)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Everything in a snapshot except the mesh, decoded into plain arrays.
+	// Nothing is copied onto the island until every section has decoded cleanly.
+	struct FDecodedIsland
+	{
+		int32 Seed;
+		int32 DrainageSeed;
+		int32 RiverSeed;
+		float Persistence;
+		TArray<float> Amplitudes;
+		int32 NumRegions;
+		int32 NumTriangles;
+		int32 NumSides;
+
+		TArray<bool> r_water;
+		TArray<bool> r_ocean;
+		TArray<bool> r_coast;
+		TArray<float> r_elevation;
+		TArray<int32> r_waterdistance;
+		TArray<float> r_moisture;
+		TArray<float> r_temperature;
+		TArray<FBiomeData> r_biome;
+
+		TArray<int32> t_coastdistance;
+		TArray<float> t_elevation;
+		TArray<FSideIndex> t_downslope_s;
+		TArray<int32> s_flow;
+		TArray<FTriangleIndex> spring_t;
+		TArray<FTriangleIndex> river_t;
+
+		FIslandRiverNetwork Rivers;
+	};
+
+	static bool DecodeSection(int32 Section, FReader& Reader, FDecodedIsland& Island)
+	{
+		switch (Section)
+		{
+		case Info:
+			Island.Seed = Reader.ReadPod<int32>();
+			Island.DrainageSeed = Reader.ReadPod<int32>();
+			Island.RiverSeed = Reader.ReadPod<int32>();
+			Island.Persistence = Reader.ReadPod<float>();
+			Reader.ReadFloats(Island.Amplitudes);
+			Island.NumRegions = Reader.ReadPod<int32>();
+			Island.NumTriangles = Reader.ReadPod<int32>();
+			Island.NumSides = Reader.ReadPod<int32>();
+			break;
+		case RegionFlags:
+			Reader.ReadBits(Island.r_water);
+			Reader.ReadBits(Island.r_ocean);
+			Reader.ReadBits(Island.r_coast);
+			break;
+		case Elevation:
+			Reader.ReadFloats(Island.r_elevation);
+			Reader.ReadFloats(Island.t_elevation);
+			break;
+		case Climate:
+			Reader.ReadFloats(Island.r_moisture);
+			Reader.ReadFloats(Island.r_temperature);
+			break;
+		case Distances:
+			Reader.ReadDeltas(Island.r_waterdistance);
+			Reader.ReadDeltas(Island.t_coastdistance);
+			break;
+		case Flow:
+			Reader.ReadDeltas(Island.t_downslope_s);
+			Reader.ReadDeltas(Island.s_flow);
+			Reader.ReadDeltas(Island.spring_t);
+			Reader.ReadDeltas(Island.river_t);
+			break;
+		case Rivers:
+		{
+			const int32 numRivers = Reader.ReadCount(24);
+			Island.Rivers.Empty(numRivers);
+			TArray<FTriangleIndex> riverTriangles;
+			TArray<FSideIndex> downslopes;
+			for (int32 i = 0; i < numRivers && !Reader.bError; i++)
+			{
+				Reader.ReadDeltas(riverTriangles);
+				Reader.ReadDeltas(downslopes);
+				const int32 feedsInto = (int32)Reader.ReadSignedVarInt();
+				if (feedsInto < -1 || feedsInto >= numRivers || riverTriangles.Num() != downslopes.Num())
+				{
+					return false;
+				}
+				Island.Rivers.AddRiver();
+				Island.Rivers.FeedsInto[i] = feedsInto;
+				for (int32 j = 0; j < riverTriangles.Num(); j++)
+				{
+					Island.Rivers.AddTriangle(riverTriangles[j], downslopes[j]);
+				}
+			}
+			break;
+		}
+		case Biomes:
+		{
+			// Biomes reference assets, so they have to be imported on the game thread
+			check(IsInGameThread());
+			const int32 numBiomes = Reader.ReadCount(8);
+			TArray<FBiomeData> palette;
+			palette.SetNum(numBiomes);
+			UScriptStruct* biomeStruct = FBiomeData::StaticStruct();
+			for (int32 i = 0; i < numBiomes && !Reader.bError; i++)
+			{
+				const FString text = Reader.ReadString();
+				if (biomeStruct->ImportText(*text, &palette[i], NULL, PPF_None, GWarn, biomeStruct->GetName()) == NULL)
+				{
+					return false;
+				}
+			}
+
+			TArray<int32> regionPalette;
+			Reader.ReadDeltas(regionPalette);
+			Island.r_biome.SetNum(regionPalette.Num());
+			for (int32 r = 0; r < regionPalette.Num() && !Reader.bError; r++)
+			{
+				if (!palette.IsValidIndex(regionPalette[r]))
+				{
+					return false;
+				}
+				Island.r_biome[r] = palette[regionPalette[r]];
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		return !Reader.bError;
+	}
+}
+
+bool FIslandMapSnapshot::Save(const AIslandMap* Map, TArray<uint8>& OutBytes, bool bQuantizeFloats)
+{
+	using namespace IslandMapSnapshot;
+	OutBytes.Empty();
+	if (Map == NULL || Map->Mesh == NULL)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Can't snapshot an island which hasn't been generated yet."));
+		return false;
+	}
+	const UTriangleDualMesh* mesh = Map->Mesh;
+
+	TArray<FWriter> sections;
+	sections.SetNum(NumSections);
+
+	FWriter& info = sections[Info];
+	info.WritePod(Map->Seed);
+	info.WritePod(Map->DrainageSeed);
+	info.WritePod(Map->RiverSeed);
+	info.WritePod(Map->Persistence);
+	info.WriteFloats(Map->Shape.Amplitudes, false);
+	info.WritePod(mesh->NumRegions);
+	info.WritePod(mesh->NumTriangles);
+	info.WritePod(mesh->NumSides);
+
+	FDualMeshCache::Serialize(mesh, MeshKey, 0, sections[Mesh].Bytes);
+
+	sections[RegionFlags].WriteBits(Map->r_water);
+	sections[RegionFlags].WriteBits(Map->r_ocean);
+	sections[RegionFlags].WriteBits(Map->r_coast);
+
+	sections[Elevation].WriteFloats(Map->r_elevation, bQuantizeFloats);
+	sections[Elevation].WriteFloats(Map->t_elevation, bQuantizeFloats);
+	sections[Climate].WriteFloats(Map->r_moisture, bQuantizeFloats);
+	sections[Climate].WriteFloats(Map->r_temperature, bQuantizeFloats);
+
+	sections[Distances].WriteDeltas(Map->r_waterdistance);
+	sections[Distances].WriteDeltas(Map->t_coastdistance);
+
+	sections[Flow].WriteDeltas(Map->t_downslope_s);
+	sections[Flow].WriteDeltas(Map->s_flow);
+	sections[Flow].WriteDeltas(Map->spring_t);
+	sections[Flow].WriteDeltas(Map->river_t);
+
+	// There are only a handful of distinct biomes, so write each one out once
+	TMap<FString, int32> paletteIndices;
+	TArray<FString> palette;
+	TArray<int32> regionPalette;
+	regionPalette.SetNumUninitialized(Map->r_biome.Num());
+	UScriptStruct* biomeStruct = FBiomeData::StaticStruct();
+	for (int32 r = 0; r < Map->r_biome.Num(); r++)
+	{
+		FString text;
+		biomeStruct->ExportText(text, &Map->r_biome[r], NULL, NULL, PPF_None, NULL);
+		int32* index = paletteIndices.Find(text);
+		if (index == NULL)
+		{
+			index = &paletteIndices.Add(text, palette.Add(text));
+		}
+		regionPalette[r] = *index;
+	}
+	sections[Biomes].WriteVarInt(palette.Num());
+	for (const FString& text : palette)
+	{
+		sections[Biomes].WriteString(text);
+	}
+	sections[Biomes].WriteDeltas(regionPalette);
+
+	const FIslandRiverNetwork& riverNetwork = Map->RiverNetwork;
+	sections[Rivers].WriteVarInt(riverNetwork.Num());
+	for (int32 i = 0; i < riverNetwork.Num(); i++)
+	{
+		sections[Rivers].WriteDeltas(riverNetwork.GetTriangles(i));
+		sections[Rivers].WriteDeltas(riverNetwork.GetDownslopes(i));
+		sections[Rivers].WriteSignedVarInt(riverNetwork.FeedsInto[i]);
+	}
+
+	// Sections compress independently of each other
+	TArray<FSectionEntry> entries;
+	entries.SetNumZeroed(NumSections);
+	TArray<TArray<uint8>> compressed;
+	compressed.SetNum(NumSections);
+	FDualMeshParallel::ForEach(NumSections, [&](int32 i)
+	{
+		const TArray<uint8>& raw = sections[i].Bytes;
+		entries[i].RawSize = raw.Num();
+		entries[i].Crc = FCrc::MemCrc32(raw.GetData(), raw.Num());
+
+		int32 compressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, raw.Num());
+		compressed[i].SetNumUninitialized(compressedSize);
+		if (raw.Num() > 0 && FCompression::CompressMemory(COMPRESS_ZLIB, compressed[i].GetData(), compressedSize, raw.GetData(), raw.Num()) && compressedSize < raw.Num())
+		{
+			compressed[i].SetNum(compressedSize);
+			entries[i].Flags = SectionCompressed;
+		}
+		else
+		{
+			compressed[i].Empty();
+		}
+	}, 1);
+
+	FHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.NumSections = NumSections;
+	header.Padding = 0;
+
+	int64 offset = Align(sizeof(FHeader) + NumSections * sizeof(FSectionEntry), SectionAlignment);
+	for (int32 i = 0; i < NumSections; i++)
+	{
+		const TArray<uint8>& stored = (entries[i].Flags & SectionCompressed) ? compressed[i] : sections[i].Bytes;
+		entries[i].Offset = offset;
+		entries[i].StoredSize = stored.Num();
+		offset = Align(offset + stored.Num(), SectionAlignment);
+	}
+
+	OutBytes.SetNumZeroed((int32)offset);
+	FMemory::Memcpy(OutBytes.GetData(), &header, sizeof(FHeader));
+	FMemory::Memcpy(OutBytes.GetData() + sizeof(FHeader), entries.GetData(), NumSections * sizeof(FSectionEntry));
+	for (int32 i = 0; i < NumSections; i++)
+	{
+		const TArray<uint8>& stored = (entries[i].Flags & SectionCompressed) ? compressed[i] : sections[i].Bytes;
+		FMemory::Memcpy(OutBytes.GetData() + entries[i].Offset, stored.GetData(), stored.Num());
+		UE_LOG(LogMapGen, Log, TEXT("Snapshot section %s: %lld bytes, %lld bytes stored."), SectionNames[i], entries[i].RawSize, entries[i].StoredSize);
+	}
+	UE_LOG(LogMapGen, Log, TEXT("Snapshot of %d regions is %d bytes."), mesh->NumRegions, OutBytes.Num());
+	return true;
+}
+
+bool FIslandMapSnapshot::Load(AIslandMap* Map, const uint8* Data, int64 Size)
+{
+	using namespace IslandMapSnapshot;
+	if (Map == NULL || Data == NULL)
+	{
+		return false;
+	}
+
+#if !UE_BUILD_SHIPPING
+	FDateTime startTime = FDateTime::UtcNow();
+#endif
+
+	FReader reader(Data, Size);
+	const FHeader header = reader.ReadPod<FHeader>();
+	if (reader.bError || header.Magic != Magic || header.Version != Version || header.NumSections != NumSections)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Island snapshot is from a different version, and can't be loaded."));
+		return false;
+	}
+
+	TArray<FSectionEntry> entries;
+	entries.SetNumUninitialized(NumSections);
+	for (int32 i = 0; i < NumSections; i++)
+	{
+		entries[i] = reader.ReadPod<FSectionEntry>();
+		// Snapshots can come over the network, so don't let a section ask for more memory than it could possibly need
+		if (reader.bError || entries[i].Offset < 0 || entries[i].StoredSize < 0 || entries[i].RawSize < 0 || entries[i].StoredSize > Size - entries[i].Offset
+			|| entries[i].RawSize > MAX_int32 || entries[i].RawSize > entries[i].StoredSize * MaxCompressionRatio + 64)
+		{
+			UE_LOG(LogMapGen, Warning, TEXT("Island snapshot has an invalid section table."));
+			return false;
+		}
+	}
+
+	// Uncompressed sections are read straight out of the file, compressed ones get unpacked in parallel
+	TArray<TArray<uint8>> uncompressed;
+	uncompressed.SetNum(NumSections);
+	TArray<bool> sectionValid;
+	sectionValid.SetNumZeroed(NumSections);
+	FDualMeshParallel::ForEach(NumSections, [&](int32 i)
+	{
+		const FSectionEntry& entry = entries[i];
+		const uint8* stored = Data + entry.Offset;
+		if (entry.Flags & SectionCompressed)
+		{
+			uncompressed[i].SetNumUninitialized((int32)entry.RawSize);
+			if (!FCompression::UncompressMemory(COMPRESS_ZLIB, uncompressed[i].GetData(), uncompressed[i].Num(), stored, (int32)entry.StoredSize))
+			{
+				return;
+			}
+		}
+		else if (entry.StoredSize != entry.RawSize)
+		{
+			return;
+		}
+		const uint8* raw = (entry.Flags & SectionCompressed) ? uncompressed[i].GetData() : stored;
+		sectionValid[i] = FCrc::MemCrc32(raw, entry.RawSize) == entry.Crc;
+	}, 1);
+
+	TArray<FReader> sections;
+	for (int32 i = 0; i < NumSections; i++)
+	{
+		if (!sectionValid[i])
+		{
+			UE_LOG(LogMapGen, Warning, TEXT("Island snapshot section %s is corrupt."), SectionNames[i]);
+			return false;
+		}
+		sections.Add(FReader((entries[i].Flags & SectionCompressed) ? uncompressed[i].GetData() : Data + entries[i].Offset, entries[i].RawSize));
+	}
+
+	FDecodedIsland island;
+	int32 rngSteps;
+	UTriangleDualMesh* mesh = FDualMeshCache::Deserialize(sections[Mesh].Data, sections[Mesh].Size, MeshKey, rngSteps);
+	if (mesh == NULL || !DecodeSection(Info, sections[Info], island))
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Could not read the mesh out of an island snapshot."));
+		return false;
+	}
+
+	// Biomes have to be imported on this thread, but everything else can be decoded alongside each other
+	TArray<int32> parallelSections = { RegionFlags, Elevation, Climate, Distances, Flow, Rivers };
+	TArray<bool> decoded;
+	decoded.SetNumZeroed(parallelSections.Num());
+	FDualMeshParallel::ForEach(parallelSections.Num(), [&](int32 i)
+	{
+		decoded[i] = DecodeSection(parallelSections[i], sections[parallelSections[i]], island);
+	}, 1);
+	if (decoded.Contains(false) || !DecodeSection(Biomes, sections[Biomes], island))
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Could not decode an island snapshot."));
+		return false;
+	}
+
+	const int32 numRegions = mesh->NumRegions;
+	const int32 numTriangles = mesh->NumTriangles;
+	if (island.NumRegions != numRegions || island.NumTriangles != numTriangles || island.NumSides != mesh->NumSides
+		|| island.r_water.Num() != numRegions || island.r_ocean.Num() != numRegions || island.r_coast.Num() != numRegions
+		|| island.r_elevation.Num() != numRegions || island.r_waterdistance.Num() != numRegions || island.r_moisture.Num() != numRegions
+		|| island.r_temperature.Num() != numRegions || island.r_biome.Num() != numRegions
+		|| island.t_coastdistance.Num() != numTriangles || island.t_elevation.Num() != numTriangles || island.t_downslope_s.Num() != numTriangles
+		|| island.s_flow.Num() != mesh->NumSides)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Island snapshot arrays don't match the size of its mesh."));
+		return false;
+	}
+
+	// The checksums only catch accidental damage, so make sure every index points into
+	// the mesh before the island starts following them. Sinks and river mouths have no downslope.
+	if (!AreIndicesBelow(island.t_downslope_s, mesh->NumSides, true)
+		|| !AreIndicesBelow(island.spring_t, numTriangles, false) || !AreIndicesBelow(island.river_t, numTriangles, false)
+		|| !AreIndicesBelow(island.Rivers.Triangles, numTriangles, false) || !AreIndicesBelow(island.Rivers.Downslopes, mesh->NumSides, true))
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Island snapshot has indices outside of its mesh."));
+		return false;
+	}
+
+	Map->Mesh = mesh;
+	Map->Seed = island.Seed;
+	Map->DrainageSeed = island.DrainageSeed;
+	Map->RiverSeed = island.RiverSeed;
+	Map->Persistence = island.Persistence;
+	Map->Shape.Amplitudes = MoveTemp(island.Amplitudes);
+	// The streams start over from their seeds, rather than picking up where generation left off
+	Map->Rng.Initialize(island.Seed);
+	Map->DrainageRng.Initialize(island.DrainageSeed);
+	Map->RiverRng.Initialize(island.RiverSeed);
+
+	Map->r_water = MoveTemp(island.r_water);
+	Map->r_ocean = MoveTemp(island.r_ocean);
+	Map->r_coast = MoveTemp(island.r_coast);
+	Map->r_elevation = MoveTemp(island.r_elevation);
+	Map->r_waterdistance = MoveTemp(island.r_waterdistance);
+	Map->r_moisture = MoveTemp(island.r_moisture);
+	Map->r_temperature = MoveTemp(island.r_temperature);
+	Map->r_biome = MoveTemp(island.r_biome);
+	Map->t_coastdistance = MoveTemp(island.t_coastdistance);
+	Map->t_elevation = MoveTemp(island.t_elevation);
+	Map->t_downslope_s = MoveTemp(island.t_downslope_s);
+	Map->s_flow = MoveTemp(island.s_flow);
+	Map->spring_t = MoveTemp(island.spring_t);
+	Map->river_t = MoveTemp(island.river_t);
+	Map->VoronoiPolygons.Empty();
+
+	Map->RiverNetwork = MoveTemp(island.Rivers);
+	Map->RiverViews.Empty();
+
+#if !UE_BUILD_SHIPPING
+	FTimespan difference = FDateTime::UtcNow() - startTime;
+	UE_LOG(LogMapGen, Log, TEXT("Loaded an island snapshot with %d regions in %f seconds."), numRegions, difference.GetTotalSeconds());
+#endif
+	return true;
+}
+
+bool FIslandMapSnapshot::SaveToFile(const AIslandMap* Map, const FString& Path, bool bQuantizeFloats)
+{
+	TArray<uint8> bytes;
+	if (!Save(Map, bytes, bQuantizeFloats))
+	{
+		return false;
+	}
+	if (!FFileHelper::SaveArrayToFile(bytes, *Path))
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Could not write island snapshot to %s."), *Path);
+		return false;
+	}
+	return true;
+}
+
+bool FIslandMapSnapshot::LoadFromFile(AIslandMap* Map, const FString& Path)
+{
+	IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!platformFile.FileExists(*Path))
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("No island snapshot at %s."), *Path);
+		return false;
+	}
+
+	TUniquePtr<IMappedFileHandle> mappedFile(platformFile.OpenMapped(*Path));
+	TUniquePtr<IMappedFileRegion> mappedRegion(mappedFile.IsValid() ? mappedFile->MapRegion() : NULL);
+	if (mappedRegion.IsValid())
+	{
+		return Load(Map, mappedRegion->GetMappedPtr(), mappedRegion->GetMappedSize());
+	}
+
+	TArray<uint8> bytes;
+	return FFileHelper::LoadFileToArray(bytes, *Path) && Load(Map, bytes.GetData(), bytes.Num());
+}
@@ -19,6 +19,7 @@
 #include "RandomSampling/SimplexNoise.h"
 #include "DrawDebugHelpers.h"
 #include "IslandMap.h"
+#include "DualMeshParallel.h"
 
 void UIslandMapUtils::RandomShuffle(TArray<FTriangleIndex>& OutShuffledArray, FRandomStream& Rng)
 {
@@ -259,7 +260,7 @@ void UIslandMapUtils::DrawDelaunayFromMap(AIslandMap* Map)
 	{
 		return;
 	}
-	DrawDelaunayMesh(Map, Map->Mesh, Map->r_elevation, Map->s_flow, Map->CreatedRivers, Map->t_elevation, Map->r_biome);
+	DrawDelaunayMesh(Map, Map->Mesh, Map->r_elevation, Map->s_flow, Map->RiverNetwork, Map->t_elevation, Map->r_biome);
 }
 
 void UIslandMapUtils::DrawVoronoiFromMap(class AIslandMap* Map)
@@ -268,10 +269,10 @@ void UIslandMapUtils::DrawVoronoiFromMap(class AIslandMap* Map)
 	{
 		return;
 	}
-	DrawVoronoiMesh(Map, Map->Mesh, Map->GetVoronoiPolygons(), Map->s_flow, Map->CreatedRivers, Map->t_elevation);
+	DrawVoronoiMesh(Map, Map->Mesh, Map->GetVoronoiPolygons(), Map->s_flow, Map->RiverNetwork, Map->t_elevation);
 }
 
-void UIslandMapUtils::DrawDelaunayMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<float>& RegionElevations, const TArray<int32>& SideFlow, const TArray<URiver*>& Rivers, const TArray<float> &TriangleElevations, const TArray<FBiomeData>& RegionBiomes)
+void UIslandMapUtils::DrawDelaunayMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<float>& RegionElevations, const TArray<int32>& SideFlow, const FIslandRiverNetwork& Rivers, const TArray<float> &TriangleElevations, const TArray<FBiomeData>& RegionBiomes)
 {
 	if (Context == NULL || Mesh == NULL)
 	{
@@ -318,7 +319,7 @@ void UIslandMapUtils::DrawDelaunayMesh(AActor* Context, UTriangleDualMesh* Mesh,
 	DrawRivers(Context, Mesh, Rivers, SideFlow, TriangleElevations);
 }
 
-void UIslandMapUtils::DrawVoronoiMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<FIslandPolygon>& Polygons, const TArray<int32>& SideFlow, const TArray<URiver*>& Rivers, const TArray<float>& TriangleElevations)
+void UIslandMapUtils::DrawVoronoiMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<FIslandPolygon>& Polygons, const TArray<int32>& SideFlow, const FIslandRiverNetwork& Rivers, const TArray<float>& TriangleElevations)
 {
 	if (Context == NULL)
 	{
@@ -351,7 +352,7 @@ void UIslandMapUtils::DrawVoronoiMesh(AActor* Context, UTriangleDualMesh* Mesh,
 	DrawRivers(Context, Mesh, Rivers, SideFlow, TriangleElevations);
 }
 
-void UIslandMapUtils::DrawRivers(AActor* Context, UTriangleDualMesh* Mesh, const TArray<URiver*>& Rivers, const TArray<int32>& SideFlow, const TArray<float> &TriangleElevations)
+void UIslandMapUtils::DrawRivers(AActor* Context, UTriangleDualMesh* Mesh, const FIslandRiverNetwork& Rivers, const TArray<int32>& SideFlow, const TArray<float> &TriangleElevations)
 {
 	if (Context == NULL || Mesh == NULL)
 	{
@@ -363,23 +364,25 @@ void UIslandMapUtils::DrawRivers(AActor* Context, UTriangleDualMesh* Mesh, const
 #endif
 
 	UWorld* world = Context->GetWorld();
-	for (URiver* river : Rivers)
+	for (int32 river = 0; river < Rivers.Num(); river++)
 	{
-		if (river->RiverTriangles.Num() <= 1)
+		TArrayView<const FTriangleIndex> riverTriangles = Rivers.GetTriangles(river);
+		TArrayView<const FSideIndex> downslopes = Rivers.GetDownslopes(river);
+		if (riverTriangles.Num() <= 1)
 		{
 			UE_LOG(LogMapGen, Warning, TEXT("Created a very short river!"));
 			continue;
 		}
-		for (int i = 0; i < river->RiverTriangles.Num() - 1; i++)
+		for (int i = 0; i < riverTriangles.Num() - 1; i++)
 		{
-			FTriangleIndex t1 = river->RiverTriangles[i];
-			int32 flow = SideFlow[river->Downslopes[i]];
+			FTriangleIndex t1 = riverTriangles[i];
+			int32 flow = SideFlow[downslopes[i]];
 
 			FVector2D first2D = Mesh->t_pos(t1);
 			float z1 = TriangleElevations.IsValidIndex(t1) ? TriangleElevations[t1] : -1000.0f;
 			FVector first3D = FVector(first2D.X, first2D.Y, z1 * 10000);
 
-			FTriangleIndex t2 = river->RiverTriangles[i + 1];
+			FTriangleIndex t2 = riverTriangles[i + 1];
 			FVector2D second2D = Mesh->t_pos(t2);
 			float z2 = TriangleElevations.IsValidIndex(t2) ? TriangleElevations[t2] : -1000.0f;
 			FVector second3D = FVector(second2D.X, second2D.Y, z2 * 10000);
@@ -396,16 +399,16 @@ void UIslandMapUtils::DrawRivers(AActor* Context, UTriangleDualMesh* Mesh, const
 
 }
 
-void UIslandMapUtils::GenerateMesh(class AIslandMap* Map, UProceduralMeshComponent* MapMesh, float ZScale)
+void UIslandMapUtils::GenerateMesh(class AIslandMap* Map, UProceduralMeshComponent* MapMesh, float ZScale, bool bCreateCollision)
 {
 	if (Map == NULL)
 	{
 		return;
 	}
-	GenerateMapMeshMultiMaterial(Map->Mesh, MapMesh, ZScale, Map->r_elevation, Map->r_coast, Map->r_biome);
+	GenerateMapMeshMultiMaterial(Map->Mesh, MapMesh, ZScale, Map->r_elevation, Map->r_coast, Map->r_biome, bCreateCollision);
 }
 
-void UIslandMapUtils::GenerateMapMeshSingleMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation)
+void UIslandMapUtils::GenerateMapMeshSingleMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, bool bCreateCollision)
 {
 	if (Mesh == NULL || MapMesh == NULL)
 	{
@@ -413,165 +416,762 @@ void UIslandMapUtils::GenerateMapMeshSingleMaterial(UTriangleDualMesh* Mesh, UPr
 	}
 	const TArray<FVector2D>& points = Mesh->GetPoints();
 	const FDualMesh& rawMesh = Mesh->GetRawMesh();
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	const FVector2D mapSize = Mesh->GetSize();
+	const int32 numRegions = Mesh->NumRegions;
+	const int32 numTriangles = Mesh->NumTriangles;
 
+	// One vertex per region, shared by every triangle touching that region
 	FMapMeshData meshData;
+	meshData.Vertices.SetNumUninitialized(numRegions);
+	meshData.VertexColors.Init(FLinearColor(0.75, 0.75, 0.75, 1.0), numRegions);
+	meshData.Normals.SetNumUninitialized(numRegions);
+	meshData.UV0.SetNumUninitialized(numRegions);
+	meshData.Tangents.SetNumUninitialized(numRegions);
+	meshData.Triangles.SetNumUninitialized(rawMesh.DelaunayTriangles.Num());
 
-	meshData.Vertices.SetNumZeroed(points.Num());
-	meshData.VertexColors.SetNum(meshData.Vertices.Num());
-	meshData.Triangles.SetNumZeroed(rawMesh.DelaunayTriangles.Num());
-	meshData.Normals.SetNumZeroed(meshData.Triangles.Num());
-	meshData.UV0.SetNumZeroed(meshData.Triangles.Num());
-	meshData.Tangents.SetNumZeroed(meshData.Triangles.Num());
-
-	for (FPointIndex r = 0; r < meshData.Vertices.Num(); r++)
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
 	{
 		float z = Mesh->r_ghost(r) ? -10 * ZScale : RegionElevation[r] * ZScale;
 		meshData.Vertices[r] = FVector(points[r].X, points[r].Y, z);
-		meshData.VertexColors[r] = FLinearColor(0.75, 0.75, 0.75, 1.0);
+		// Planar projection over the whole map
+		meshData.UV0[r] = FVector2D(points[r].X / mapSize.X, points[r].Y / mapSize.Y);
+	});
+
+	// Face normals, left unnormalized so their length is twice the triangle's area
+	TArray<FVector> t_normal;
+	t_normal.SetNumUninitialized(numTriangles);
+	FDualMeshParallel::ForEach(numTriangles, [&](int32 t)
+	{
+		const int32 a = (int32)rawMesh.DelaunayTriangles[3 * t];
+		const int32 b = (int32)rawMesh.DelaunayTriangles[3 * t + 1];
+		const int32 c = (int32)rawMesh.DelaunayTriangles[3 * t + 2];
+		meshData.Triangles[3 * t] = a;
+		meshData.Triangles[3 * t + 1] = b;
+		meshData.Triangles[3 * t + 2] = c;
+		const FVector& aPos = meshData.Vertices[a];
+		const FVector& bPos = meshData.Vertices[b];
+		const FVector& cPos = meshData.Vertices[c];
+		t_normal[t] = (bPos - cPos) ^ (aPos - cPos);
+	});
+
+	// Each vertex gathers the normals of the triangles around it,
+	// so larger triangles have more of a say in the final normal
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
+	{
+		FVector normal = FVector::ZeroVector;
+		for (int32 i = r_side_offsets[r]; i < r_side_offsets[r + 1]; i++)
+		{
+			normal += t_normal[r_sides[i] / 3];
+		}
+		normal = normal.GetSafeNormal();
+		if (normal.IsZero())
+		{
+			normal = FVector::UpVector;
+		}
+		meshData.Normals[r] = normal;
+
+		// U runs along X, so the tangent is X projected onto the surface
+		FVector tangentX = (FVector::ForwardVector - normal * normal.X).GetSafeNormal();
+		if (tangentX.IsZero())
+		{
+			tangentX = FVector::ForwardVector;
+		}
+		meshData.Tangents[r] = FProcMeshTangent(tangentX, false);
+	});
+
+	MapMesh->CreateMeshSection_LinearColor(0, meshData.Vertices, meshData.Triangles, meshData.Normals, meshData.UV0, meshData.VertexColors, meshData.Tangents, bCreateCollision);
+}
+
+FPointIndex UIslandMapUtils::GetTriangleBiomeRegion(const UTriangleDualMesh* Mesh, FTriangleIndex Triangle, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes)
+{
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	return GetTriangleBiomeRegion(Mesh, triangles[3 * Triangle], triangles[3 * Triangle + 1], triangles[3 * Triangle + 2], CostalRegions, RegionBiomes);
+}
+
+FPointIndex UIslandMapUtils::GetTriangleBiomeRegion(const UTriangleDualMesh* Mesh, FPointIndex A, FPointIndex B, FPointIndex C, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes)
+{
+	// Determine which biome to use
+	// If we're on the boundary, use the boundary biome
+	// If we're part coast, use the coast biome (this prevents jagged triangles along the water)
+	// If 2+ points use the same biome, make the whole triangle that biome
+	// Otherwise, just use point A's biome
+	if (Mesh->r_boundary(A))
+	{
+		return A;
+	}
+	else if (Mesh->r_boundary(B))
+	{
+		return B;
+	}
+	else if (Mesh->r_boundary(C))
+	{
+		return C;
+	}
+	else if (CostalRegions[A])
+	{
+		// Coastal regions get handled after boundary regions
+		// This way, the boundary remains the same no matter what
+		return A;
+	}
+	else if (CostalRegions[B])
+	{
+		return B;
+	}
+	else if (CostalRegions[C])
+	{
+		return C;
+	}
+	else if (RegionBiomes[A].Tag == RegionBiomes[B].Tag)
+	{
+		// Finally, handle it based on biomes
+		return A;
 	}
-	for (FTriangleIndex t = 0; t < meshData.Triangles.Num(); t++)
+	else if (RegionBiomes[B].Tag == RegionBiomes[C].Tag)
 	{
-		meshData.Triangles[t] = (int32)rawMesh.DelaunayTriangles[t];
-		FDelaunayTriangle triangle = UDelaunayHelper::ConvertTriangleIDToTriangle(rawMesh, t);
-		FVector a = FVector(triangle.A.X, triangle.A.Y, RegionElevation[triangle.AIndex]);
-		FVector b = FVector(triangle.B.X, triangle.B.Y, RegionElevation[triangle.BIndex]);
-		FVector c = FVector(triangle.C.X, triangle.C.Y, RegionElevation[triangle.CIndex]);
-		meshData.Normals[t] = FVector::CrossProduct(c - a, b - a).GetSafeNormal();
-		meshData.UV0[t] = FVector2D::ZeroVector;
-		meshData.Tangents[t] = FProcMeshTangent((a - b).GetSafeNormal(), true);
+		return B;
+	}
+	else if (RegionBiomes[C].Tag == RegionBiomes[A].Tag)
+	{
+		return C;
+	}
+	else
+	{
+		return A;
+	}
+}
+
+void UIslandMapUtils::GenerateMapMeshMultiMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, bool bCreateCollision)
+{
+	if (Mesh == NULL || MapMesh == NULL)
+	{
+		return;
 	}
 
-	MapMesh->CreateMeshSection_LinearColor(0, meshData.Vertices, meshData.Triangles, meshData.Normals, meshData.UV0, meshData.VertexColors, meshData.Tangents, true);
+	TArray<int32> allTriangles;
+	allTriangles.SetNumUninitialized(Mesh->NumTriangles);
+	for (int32 t = 0; t < allTriangles.Num(); t++)
+	{
+		allTriangles[t] = t;
+	}
 
-	// Enable collision data
-	MapMesh->ContainsPhysicsTriMeshData(true);
+	TArray<FMapMeshData> sections;
+	TArray<UMaterialInterface*> sectionMaterials;
+	BuildBiomeSections(Mesh, allTriangles, ZScale, RegionElevation, CostalRegions, RegionBiomes, sections, sectionMaterials);
+	UE_LOG(LogMapGen, Log, TEXT("Map mesh has %d triangles and %d vertices."), allTriangles.Num(), 3 * allTriangles.Num());
+	CreateBiomeSections(MapMesh, sections, sectionMaterials, bCreateCollision);
 }
 
-void UIslandMapUtils::GenerateMapMeshMultiMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData> RegionBiomes)
+void UIslandMapUtils::GenerateMapMeshMergedOcean(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, const TArray<bool>& OceanRegions, const TArray<int32>& TriangleCoastDistances, int32 MinCoastDistance, float OceanCellSize, bool bCreateCollision)
 {
 	if (Mesh == NULL || MapMesh == NULL)
 	{
 		return;
 	}
+
+	// Everything that isn't deep ocean stays at full detail
+	TArray<bool> deepOcean;
+	FindDeepOceanRegions(Mesh, OceanRegions, TriangleCoastDistances, MinCoastDistance, deepOcean);
+	TArray<bool> preservedRegions;
+	preservedRegions.SetNumUninitialized(Mesh->NumRegions);
+	FDualMeshParallel::ForEach(Mesh->NumRegions, [&](int32 r)
+	{
+		preservedRegions[r] = !deepOcean[r];
+	});
+
+	// Only merge deep ocean that's actually connected, so a cell holding ocean on
+	// both sides of a spit or islet doesn't get a fan stretched over the land
+	TArray<int32> oceanGroups;
+	LabelConnectedRegions(Mesh, deepOcean, oceanGroups);
+
+	TArray<int32> regionMap;
+	ClusterRegions(Mesh, OceanCellSize, preservedRegions, oceanGroups, regionMap);
+	UndoFlippingCollapses(Mesh, regionMap);
+
+	TArray<int32> allTriangles;
+	allTriangles.SetNumUninitialized(Mesh->NumTriangles);
+	for (int32 t = 0; t < allTriangles.Num(); t++)
+	{
+		allTriangles[t] = t;
+	}
+	TArray<int32> regionTriangles;
+	CollapseTriangles(Mesh, allTriangles, regionMap, regionTriangles);
+
+	// CollapseTriangles() skips ghost triangles, but they still hang the edges of the map down
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	for (int32 t = Mesh->NumSolidTriangles; t < Mesh->NumTriangles; t++)
+	{
+		regionTriangles.Add((int32)triangles[3 * t]);
+		regionTriangles.Add((int32)triangles[3 * t + 1]);
+		regionTriangles.Add((int32)triangles[3 * t + 2]);
+	}
+
+	TArray<FMapMeshData> sections;
+	TArray<UMaterialInterface*> sectionMaterials;
+	BuildRegionBiomeSections(Mesh, regionTriangles, ZScale, RegionElevation, CostalRegions, RegionBiomes, sections, sectionMaterials);
+
+	const int32 numTriangles = regionTriangles.Num() / 3;
+	UE_LOG(LogMapGen, Log, TEXT("Merging deep ocean took the map mesh from %d triangles and %d vertices down to %d triangles and %d vertices (%.1f%%)."), Mesh->NumTriangles, 3 * Mesh->NumTriangles, numTriangles, 3 * numTriangles, Mesh->NumTriangles > 0 ? 100.0f * numTriangles / Mesh->NumTriangles : 0.0f);
+	CreateBiomeSections(MapMesh, sections, sectionMaterials, bCreateCollision);
+}
+
+void UIslandMapUtils::GenerateSimplifiedCollision(UTriangleDualMesh* Mesh, UProceduralMeshComponent* CollisionMesh, float ZScale, const TArray<float>& RegionElevation, float VertexSpacing)
+{
+	if (Mesh == NULL || CollisionMesh == NULL)
+	{
+		return;
+	}
+
+	TArray<FVector> vertices;
+	TArray<int32> triangles;
+	BuildSimplifiedCollision(FMapMeshPoints(Mesh), ZScale, RegionElevation, VertexSpacing, vertices, triangles);
+	CollisionMesh->CreateMeshSection(0, vertices, triangles, TArray<FVector>(), TArray<FVector2D>(), TArray<FColor>(), TArray<FProcMeshTangent>(), true);
+	CollisionMesh->SetMeshSectionVisible(0, false);
+}
+
+void UIslandMapUtils::BuildBiomeSections(const UTriangleDualMesh* Mesh, TArrayView<const int32> Triangles, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, TArray<FMapMeshData>& OutSections, TArray<UMaterialInterface*>& OutMaterials)
+{
+	OutSections.Empty();
+	OutMaterials.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	TArray<int32> regionTriangles;
+	regionTriangles.SetNumUninitialized(3 * Triangles.Num());
+	FDualMeshParallel::ForEach(Triangles.Num(), [&](int32 i)
+	{
+		const int32 t = Triangles[i];
+		regionTriangles[3 * i] = (int32)triangles[3 * t];
+		regionTriangles[3 * i + 1] = (int32)triangles[3 * t + 1];
+		regionTriangles[3 * i + 2] = (int32)triangles[3 * t + 2];
+	});
+	BuildRegionBiomeSections(Mesh, regionTriangles, ZScale, RegionElevation, CostalRegions, RegionBiomes, OutSections, OutMaterials);
+}
+
+void UIslandMapUtils::BuildRegionBiomeSections(const UTriangleDualMesh* Mesh, TArrayView<const int32> RegionTriangles, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, TArray<FMapMeshData>& OutSections, TArray<UMaterialInterface*>& OutMaterials)
+{
+	OutSections.Empty();
+	OutMaterials.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
 	const TArray<FVector2D>& points = Mesh->GetPoints();
-	const FDualMesh& rawMesh = Mesh->GetRawMesh();
+	const int32 numTriangles = RegionTriangles.Num() / 3;
 
-	TMap<FName, FMapMeshData> meshLookup;
-	TMap<FName, UMaterialInterface*> materialLookup;
+	// First pass: figure out which region decides the biome of each triangle
+	TArray<int32> t_biome_r;
+	t_biome_r.SetNumUninitialized(numTriangles);
+	FDualMeshParallel::ForEach(numTriangles, [&](int32 i)
+	{
+		t_biome_r[i] = (int32)GetTriangleBiomeRegion(Mesh, RegionTriangles[3 * i], RegionTriangles[3 * i + 1], RegionTriangles[3 * i + 2], CostalRegions, RegionBiomes);
+	});
 
-	for (FTriangleIndex t = 0; t < rawMesh.DelaunayTriangles.Num(); t += 3)
+	// Each biome gets its own section, in the order the biomes are first seen
+	// There are only ever a handful of biomes, so a linear search is plenty
+	TArray<FName> sectionTags;
+	TArray<int32> t_section;
+	t_section.SetNumUninitialized(numTriangles);
+	TArray<int32> sectionOffsets;
+	for (int32 i = 0; i < numTriangles; i++)
 	{
-		// Get triangle
-		FDelaunayTriangle triangle = UDelaunayHelper::ConvertTriangleIDToTriangle(rawMesh, t);		
-		// Determine which biome to use
-		// If we're on the boundary, use the boundary biome
-		// If we're part coast, use the coast biome (this prevents jagged triangles along the water)
-		// If 2+ points use the same biome, make the whole triangle that biome
-		// Otherwise, just use point A's biome
-		FBiomeData biome;
-		if (Mesh->r_boundary(triangle.AIndex))
+		const FBiomeData& biome = RegionBiomes[t_biome_r[i]];
+		int32 section = sectionTags.Find(biome.Tag);
+		if (section == INDEX_NONE)
 		{
-			biome = RegionBiomes[triangle.AIndex];
+			section = sectionTags.Add(biome.Tag);
+			OutMaterials.Add(biome.BiomeMaterial);
+			sectionOffsets.Add(0);
 		}
-		else if (Mesh->r_boundary(triangle.BIndex))
+		t_section[i] = section;
+		sectionOffsets[section]++;
+	}
+
+	// Turn the per-section counts into offsets, then bucket the triangles by section
+	const int32 numSections = sectionTags.Num();
+	int32 runningTotal = 0;
+	for (int32 i = 0; i < numSections; i++)
+	{
+		const int32 count = sectionOffsets[i];
+		sectionOffsets[i] = runningTotal;
+		runningTotal += count;
+	}
+	sectionOffsets.Add(runningTotal);
+
+	TArray<int32> sectionTriangles;
+	sectionTriangles.SetNumUninitialized(numTriangles);
+	{
+		TArray<int32> nextSlot = sectionOffsets;
+		for (int32 i = 0; i < numTriangles; i++)
 		{
-			biome = RegionBiomes[triangle.BIndex];
+			sectionTriangles[nextSlot[t_section[i]]++] = i;
 		}
-		else if (Mesh->r_boundary(triangle.CIndex))
+	}
+
+	// Second pass: presize every section and fill it in place
+	OutSections.SetNum(numSections);
+	FDualMeshParallel::ForEach(numSections, [&](int32 Section)
+	{
+		FMapMeshData& meshData = OutSections[Section];
+		const int32 first = sectionOffsets[Section];
+		const int32 numVertices = 3 * (sectionOffsets[Section + 1] - first);
+		meshData.Vertices.SetNumUninitialized(numVertices);
+		meshData.VertexColors.SetNumUninitialized(numVertices);
+		meshData.Triangles.SetNumUninitialized(numVertices);
+		meshData.Normals.SetNumUninitialized(numVertices);
+		meshData.UV0.SetNumZeroed(numVertices);
+		meshData.Tangents.SetNumUninitialized(numVertices);
+
+		for (int32 v = 0; v < numVertices; v += 3)
 		{
-			biome = RegionBiomes[triangle.CIndex];
+			const int32 t = sectionTriangles[first + v / 3];
+			FVector corners[3];
+			for (int32 i = 0; i < 3; i++)
+			{
+				// Create points
+				const FPointIndex r = RegionTriangles[3 * t + i];
+				const float z = Mesh->r_ghost(r) ? -10 * ZScale : RegionElevation[r] * ZScale;
+				corners[i] = FVector(points[r].X, points[r].Y, z);
+				meshData.Vertices[v + i] = corners[i];
+				meshData.Triangles[v + i] = v + i;
+				// Vertex colors from the original biome data
+				meshData.VertexColors[v + i] = RegionBiomes[r].DebugColor.ReinterpretAsLinear();
+			}
+
+			// Calculate the tangents of our triangle
+			const FVector edge1 = corners[1] - corners[2];
+			const FVector edge2 = corners[0] - corners[2];
+			const FVector tangentX = edge1.GetSafeNormal();
+			const FVector tangentZ = (edge1 ^ edge2).GetSafeNormal();
+			for (int32 i = 0; i < 3; i++)
+			{
+				meshData.Tangents[v + i] = FProcMeshTangent(tangentX, false);
+				meshData.Normals[v + i] = tangentZ;
+			}
 		}
-		else if (CostalRegions[triangle.AIndex])
+	}, 1);
+}
+
+void UIslandMapUtils::CreateBiomeSections(UProceduralMeshComponent* MapMesh, TArray<FMapMeshData>& Sections, const TArray<UMaterialInterface*>& Materials, bool bCreateCollision)
+{
+	for (int32 i = 0; i < Sections.Num(); i++)
+	{
+		const FMapMeshData& meshData = Sections[i];
+		MapMesh->CreateMeshSection_LinearColor(i, meshData.Vertices, meshData.Triangles, meshData.Normals, meshData.UV0, meshData.VertexColors, meshData.Tangents, bCreateCollision);
+		if (Materials.IsValidIndex(i) && Materials[i] != NULL)
 		{
-			// Coastal regions get handled after boundary regions
-			// This way, the boundary remains the same no matter what
-			biome = RegionBiomes[triangle.AIndex];
+			MapMesh->SetMaterial(i, Materials[i]);
 		}
-		else if (CostalRegions[triangle.BIndex])
+		// The component has its own copy now, so free ours as we go
+		Sections[i] = FMapMeshData();
+	}
+}
+
+void UIslandMapUtils::ClusterRegions(const UTriangleDualMesh* Mesh, float CellSize, const TArray<bool>& PreservedRegions, const TArray<int32>& RegionGroups, TArray<int32>& OutRegionMap)
+{
+	OutRegionMap.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+	ClusterPoints(Mesh->GetPoints(), Mesh->GetSize(), Mesh->NumRegions, Mesh->NumSolidRegions, Mesh->NumBoundaryRegions, CellSize, PreservedRegions, RegionGroups, OutRegionMap);
+}
+
+void UIslandMapUtils::ClusterPoints(const TArray<FVector2D>& Points, const FVector2D& MapSize, int32 NumRegions, int32 NumSolidRegions, int32 NumBoundaryRegions, float CellSize, const TArray<bool>& PreservedRegions, const TArray<int32>& RegionGroups, TArray<int32>& OutRegionMap)
+{
+	OutRegionMap.Empty();
+
+	CellSize = FMath::Max(CellSize, 1.0f);
+	const int32 cellsX = FMath::Max(1, FMath::CeilToInt(MapSize.X / CellSize));
+	const int32 cellsY = FMath::Max(1, FMath::CeilToInt(MapSize.Y / CellSize));
+	const bool bHasPreserved = PreservedRegions.Num() == NumRegions;
+	const bool bHasGroups = RegionGroups.Num() == NumRegions;
+
+	// Every region starts out as its own cluster
+	OutRegionMap.SetNumUninitialized(NumRegions);
+	for (int32 r = 0; r < NumRegions; r++)
+	{
+		OutRegionMap[r] = r;
+	}
+
+	auto isClustered = [&](int32 r)
+	{
+		return r >= NumBoundaryRegions && !(bHasPreserved && PreservedRegions[r]);
+	};
+	// Clusters are keyed on (cell, group)
+	auto getCell = [&](int32 r, FVector2D& OutCenter)
+	{
+		const int32 x = FMath::Clamp(FMath::FloorToInt(Points[r].X / CellSize), 0, cellsX - 1);
+		const int32 y = FMath::Clamp(FMath::FloorToInt(Points[r].Y / CellSize), 0, cellsY - 1);
+		OutCenter = FVector2D((x + 0.5f) * CellSize, (y + 0.5f) * CellSize);
+		return FIntPoint(y * cellsX + x, bHasGroups ? RegionGroups[r] : 0);
+	};
+
+	// First, find the region closest to the center of each cluster...
+	TMap<FIntPoint, int32> clusterRegions;
+	for (int32 r = 0; r < NumSolidRegions; r++)
+	{
+		if (!isClustered(r))
 		{
-			biome = RegionBiomes[triangle.BIndex];
+			continue;
 		}
-		else if (CostalRegions[triangle.CIndex])
+		FVector2D center;
+		const FIntPoint cluster = getCell(r, center);
+		int32* closest = clusterRegions.Find(cluster);
+		if (closest == NULL)
 		{
-			biome = RegionBiomes[triangle.CIndex];
+			clusterRegions.Add(cluster, r);
 		}
-		else if (RegionBiomes[triangle.AIndex].Tag == RegionBiomes[triangle.BIndex].Tag)
+		else if (FVector2D::DistSquared(Points[r], center) < FVector2D::DistSquared(Points[*closest], center))
 		{
-			// Finally, handle it based on biomes
-			biome = RegionBiomes[triangle.AIndex];
+			*closest = r;
 		}
-		else if (RegionBiomes[triangle.BIndex].Tag == RegionBiomes[triangle.CIndex].Tag)
+	}
+
+	// ...then point every other region in the cluster at it
+	for (int32 r = 0; r < NumSolidRegions; r++)
+	{
+		if (isClustered(r))
 		{
-			biome = RegionBiomes[triangle.BIndex];
+			FVector2D center;
+			OutRegionMap[r] = clusterRegions.FindChecked(getCell(r, center));
 		}
-		else if (RegionBiomes[triangle.CIndex].Tag == RegionBiomes[triangle.AIndex].Tag)
+	}
+}
+
+void UIslandMapUtils::BuildLODRegionMaps(const UTriangleDualMesh* Mesh, int32 NumLevels, float BaseCellSize, const TArray<bool>& PreservedRegions, const TArray<int32>& RegionGroups, TArray<TArray<int32>>& OutRegionMaps)
+{
+	OutRegionMaps.Empty();
+	if (Mesh == NULL || NumLevels <= 0)
+	{
+		return;
+	}
+
+	OutRegionMaps.SetNum(NumLevels);
+	FDualMeshParallel::ForEach(NumLevels, [&](int32 Level)
+	{
+		ClusterRegions(Mesh, BaseCellSize * (1 << Level), PreservedRegions, RegionGroups, OutRegionMaps[Level]);
+		UndoFlippingCollapses(Mesh, OutRegionMaps[Level]);
+	}, 1);
+}
+
+void UIslandMapUtils::UndoFlippingCollapses(const UTriangleDualMesh* Mesh, TArray<int32>& RegionMap)
+{
+	if (Mesh == NULL || RegionMap.Num() != Mesh->NumRegions)
+	{
+		return;
+	}
+
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	const TArray<FVector2D>& points = Mesh->GetPoints();
+	TArray<bool> t_flipped;
+	t_flipped.SetNumUninitialized(Mesh->NumSolidTriangles);
+	bool bUndidCollapse = true;
+	while (bUndidCollapse)
+	{
+		FDualMeshParallel::ForEach(Mesh->NumSolidTriangles, [&](int32 t)
 		{
-			biome = RegionBiomes[triangle.CIndex];
+			const int32 a = (int32)triangles[3 * t];
+			const int32 b = (int32)triangles[3 * t + 1];
+			const int32 c = (int32)triangles[3 * t + 2];
+			const int32 newA = RegionMap[a];
+			const int32 newB = RegionMap[b];
+			const int32 newC = RegionMap[c];
+			if (newA == newB || newB == newC || newC == newA)
+			{
+				// Collapsed triangles get covered by their neighbors
+				t_flipped[t] = false;
+				return;
+			}
+			const float oldArea = (points[b] - points[a]) ^ (points[c] - points[a]);
+			const float newArea = (points[newB] - points[newA]) ^ (points[newC] - points[newA]);
+			t_flipped[t] = oldArea * newArea <= 0.0f;
+		});
+
+		// Put every corner of a flipped triangle back where it was.
+		// A flipped triangle always has a corner which moved, so this finishes once nothing is left to undo.
+		bUndidCollapse = false;
+		for (int32 t = 0; t < t_flipped.Num(); t++)
+		{
+			if (!t_flipped[t])
+			{
+				continue;
+			}
+			for (int32 i = 3 * t; i < 3 * t + 3; i++)
+			{
+				const int32 r = (int32)triangles[i];
+				if (RegionMap[r] != r)
+				{
+					RegionMap[r] = r;
+					bUndidCollapse = true;
+				}
+			}
 		}
-		else
+	}
+}
+
+void UIslandMapUtils::CollapseTriangles(const UTriangleDualMesh* Mesh, TArrayView<const int32> Triangles, const TArray<int32>& RegionMap, TArray<int32>& OutRegionTriangles)
+{
+	OutRegionTriangles.Empty();
+	if (Mesh == NULL || RegionMap.Num() != Mesh->NumRegions)
+	{
+		return;
+	}
+
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	TSet<FIntVector> keptTriangles;
+	for (int32 t : Triangles)
+	{
+		if (Mesh->t_ghost(FTriangleIndex(t)))
+		{
+			continue;
+		}
+
+		const int32 a = (int32)triangles[3 * t];
+		const int32 b = (int32)triangles[3 * t + 1];
+		const int32 c = (int32)triangles[3 * t + 2];
+		const int32 newA = RegionMap[a];
+		const int32 newB = RegionMap[b];
+		const int32 newC = RegionMap[c];
+		if (newA == newB || newB == newC || newC == newA)
 		{
-			biome = RegionBiomes[triangle.AIndex];
+			// Collapsed into a line or a point
+			continue;
 		}
 
-		// Grab mesh info from the biome
-		FMapMeshData meshData;
-		if (meshLookup.Contains(biome.Tag))
+		// Rotate the smallest region to the front, so the same triangle always has the same key
+		FIntVector key;
+		if (newA < newB && newA < newC)
+		{
+			key = FIntVector(newA, newB, newC);
+		}
+		else if (newB < newC)
 		{
-			meshData = meshLookup[biome.Tag];
+			key = FIntVector(newB, newC, newA);
 		}
 		else
 		{
-			materialLookup.Add(biome.Tag, biome.BiomeMaterial);
-			meshLookup.Add(biome.Tag, meshData);
+			key = FIntVector(newC, newA, newB);
+		}
+
+		bool bAlreadyKept = false;
+		keptTriangles.Add(key, &bAlreadyKept);
+		if (!bAlreadyKept)
+		{
+			OutRegionTriangles.Add(key.X);
+			OutRegionTriangles.Add(key.Y);
+			OutRegionTriangles.Add(key.Z);
+		}
+	}
+}
+
+void UIslandMapUtils::FindDeepOceanRegions(const UTriangleDualMesh* Mesh, const TArray<bool>& OceanRegions, const TArray<int32>& TriangleCoastDistances, int32 MinCoastDistance, TArray<bool>& OutDeepOceanRegions)
+{
+	OutDeepOceanRegions.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	const bool bHasDistances = TriangleCoastDistances.Num() == Mesh->NumTriangles;
+	OutDeepOceanRegions.SetNumUninitialized(Mesh->NumRegions);
+	FDualMeshParallel::ForEach(Mesh->NumRegions, [&](int32 r)
+	{
+		bool bDeep = bHasDistances && OceanRegions.IsValidIndex(r) && OceanRegions[r];
+		for (int32 i = r_side_offsets[r]; i < r_side_offsets[r + 1] && bDeep; i++)
+		{
+			bDeep = TriangleCoastDistances[r_sides[i] / 3] >= MinCoastDistance;
+		}
+		OutDeepOceanRegions[r] = bDeep;
+	});
+}
+
+void UIslandMapUtils::LabelConnectedRegions(const UTriangleDualMesh* Mesh, const TArray<bool>& Regions, TArray<int32>& OutRegionGroups)
+{
+	OutRegionGroups.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+
+	OutRegionGroups.Init(INDEX_NONE, Mesh->NumRegions);
+	if (Regions.Num() != Mesh->NumRegions)
+	{
+		return;
+	}
+
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	const TArray<FPointIndex>& s_start_r = Mesh->GetRawMesh().DelaunayTriangles;
+	TArray<int32> stack;
+	int32 numGroups = 0;
+	for (int32 seed = 0; seed < Mesh->NumSolidRegions; seed++)
+	{
+		if (!Regions[seed] || OutRegionGroups[seed] != INDEX_NONE)
+		{
+			continue;
+		}
+
+		OutRegionGroups[seed] = numGroups;
+		stack.Add(seed);
+		while (stack.Num() > 0)
+		{
+			const int32 r1 = stack.Pop(false);
+			for (int32 i = r_side_offsets[r1]; i < r_side_offsets[r1 + 1]; i++)
+			{
+				const int32 s = r_sides[i];
+				if (s >= Mesh->NumSolidSides)
+				{
+					continue;
+				}
+				const int32 r2 = s_start_r[UTriangleDualMesh::s_next_s(s)];
+				if (Regions[r2] && OutRegionGroups[r2] == INDEX_NONE)
+				{
+					OutRegionGroups[r2] = numGroups;
+					stack.Add(r2);
+				}
+			}
 		}
+		numGroups++;
+	}
+}
+
+void UIslandMapUtils::DecimateRegions(const UTriangleDualMesh* Mesh, float CellSize, const TArray<bool>& PreservedRegions, TArray<int32>& OutKeptRegions)
+{
+	OutKeptRegions.Empty();
+	if (Mesh == NULL)
+	{
+		return;
+	}
+
+	TArray<int32> regionMap;
+	ClusterRegions(Mesh, CellSize, PreservedRegions, TArray<int32>(), regionMap);
+	for (int32 r = 0; r < Mesh->NumSolidRegions; r++)
+	{
+		if (regionMap[r] == r)
+		{
+			OutKeptRegions.Add(r);
+		}
+	}
+}
+
+void UIslandMapUtils::TriangulateRegions(const UTriangleDualMesh* Mesh, const TArray<int32>& Regions, TArray<int32>& OutTriangles)
+{
+	OutTriangles.Empty();
+	if (Mesh == NULL || Regions.Num() < 3)
+	{
+		return;
+	}
+
+	TriangulateRegions(Mesh->GetPoints(), Regions, OutTriangles);
+}
+
+void UIslandMapUtils::TriangulateRegions(const TArray<FVector2D>& Points, const TArray<int32>& Regions, TArray<int32>& OutTriangles)
+{
+	OutTriangles.Empty();
+	if (Regions.Num() < 3)
+	{
+		return;
+	}
 
-		// Create points
-		float aZ = Mesh->r_ghost(triangle.AIndex) ? -10 * ZScale : RegionElevation[triangle.AIndex] * ZScale;
-		float bZ = Mesh->r_ghost(triangle.BIndex) ? -10 * ZScale : RegionElevation[triangle.BIndex] * ZScale;
-		float cZ = Mesh->r_ghost(triangle.CIndex) ? -10 * ZScale : RegionElevation[triangle.CIndex] * ZScale;
-		FVector a = FVector(triangle.A.X, triangle.A.Y, aZ);
-		FVector b = FVector(triangle.B.X, triangle.B.Y, bZ);
-		FVector c = FVector(triangle.C.X, triangle.C.Y, cZ);
+	TArray<FVector2D> positions;
+	positions.SetNumUninitialized(Regions.Num());
+	for (int32 i = 0; i < Regions.Num(); i++)
+	{
+		positions[i] = Points[Regions[i]];
+	}
+
+	FDelaunayMesh triangulation = FDelaunayMesh(positions);
+	OutTriangles.SetNumUninitialized(triangulation.DelaunayTriangles.Num());
+	for (int32 i = 0; i < OutTriangles.Num(); i++)
+	{
+		OutTriangles[i] = (int32)triangulation.DelaunayTriangles[i];
+	}
+}
 
-		// Add to triangle
-		meshData.Triangles.Add(meshData.Vertices.Add(a));
-		meshData.Triangles.Add(meshData.Vertices.Add(b));
-		meshData.Triangles.Add(meshData.Vertices.Add(c));
+void UIslandMapUtils::BuildSimplifiedCollision(const FMapMeshPoints& Mesh, float ZScale, const TArray<float>& RegionElevation, float VertexSpacing, TArray<FVector>& OutVertices, TArray<int32>& OutTriangles)
+{
+	OutVertices.Empty();
+	OutTriangles.Empty();
 
-		// Calculate the tangents of our triangle
-		const FVector edge1 = b - c;
-		const FVector edge2 = a - c;
-		const FVector tangentX = edge1.GetSafeNormal();
-		FVector tangentZ = (edge1 ^ edge2).GetSafeNormal();
-		for (uint8 i = 0; i < 3; i++)
+	// The same as DecimateRegions(), but from the copied points
+	TArray<int32> regionMap;
+	ClusterPoints(Mesh.Points, Mesh.Size, Mesh.NumRegions, Mesh.NumSolidRegions, Mesh.NumBoundaryRegions, VertexSpacing, TArray<bool>(), TArray<int32>(), regionMap);
+	TArray<int32> keptRegions;
+	for (int32 r = 0; r < Mesh.NumSolidRegions; r++)
+	{
+		if (regionMap[r] == r)
 		{
-			meshData.Tangents.Add(FProcMeshTangent(tangentX, false));
-			meshData.Normals.Add(tangentZ);
-			meshData.UV0.Add(FVector2D::ZeroVector);
+			keptRegions.Add(r);
 		}
+	}
+	TriangulateRegions(Mesh.Points, keptRegions, OutTriangles);
+
+	const TArray<FVector2D>& points = Mesh.Points;
+	OutVertices.SetNumUninitialized(keptRegions.Num());
+	FDualMeshParallel::ForEach(keptRegions.Num(), [&](int32 i)
+	{
+		const int32 r = keptRegions[i];
+		OutVertices[i] = FVector(points[r].X, points[r].Y, RegionElevation[r] * ZScale);
+	});
 
-		// Vertex colors from the original biome data
-		meshData.VertexColors.Add(RegionBiomes[triangle.AIndex].DebugColor.ReinterpretAsLinear());
-		meshData.VertexColors.Add(RegionBiomes[triangle.BIndex].DebugColor.ReinterpretAsLinear());
-		meshData.VertexColors.Add(RegionBiomes[triangle.CIndex].DebugColor.ReinterpretAsLinear());
+	UE_LOG(LogMapGen, Log, TEXT("Simplified collision has %d triangles, down from %d."), OutTriangles.Num() / 3, Mesh.NumSolidTriangles);
+}
 
-		// Update the map with the latest version of the mesh
-		meshLookup[biome.Tag] = meshData;
+void UIslandMapUtils::AssignTriangleChunks(const UTriangleDualMesh* Mesh, int32 ChunksPerSide, TArray<int32>& OutTriangleChunks, TArray<int32>& OutChunkOffsets, TArray<int32>& OutChunkTriangles)
+{
+	OutTriangleChunks.Empty();
+	OutChunkOffsets.Empty();
+	OutChunkTriangles.Empty();
+	if (Mesh == NULL)
+	{
+		return;
 	}
 
-	// Create the actual meshes
-	uint8 index = 0;
-	for (auto kvp : meshLookup)
+	ChunksPerSide = FMath::Max(1, ChunksPerSide);
+	const int32 numGridChunks = ChunksPerSide * ChunksPerSide;
+	const int32 ghostChunk = numGridChunks;
+	const FVector2D mapSize = Mesh->GetSize();
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	const TArray<FVector2D>& points = Mesh->GetPoints();
+
+	// Chunks are based on the position of the triangle's first region.
+	// Ghost triangles reach all the way to the center of the map, so they
+	// get a chunk of their own to keep the other chunks' bounds tight.
+	OutTriangleChunks.SetNumUninitialized(Mesh->NumTriangles);
+	FDualMeshParallel::ForEach(Mesh->NumTriangles, [&](int32 t)
 	{
-		FMapMeshData meshData = kvp.Value;
-		MapMesh->CreateMeshSection_LinearColor(index, meshData.Vertices, meshData.Triangles, meshData.Normals, meshData.UV0, meshData.VertexColors, meshData.Tangents, true);
-		if (materialLookup.Contains(kvp.Key) && materialLookup[kvp.Key] != NULL)
+		if (Mesh->t_ghost(FTriangleIndex(t)))
 		{
-			MapMesh->SetMaterial(index, materialLookup[kvp.Key]);
+			OutTriangleChunks[t] = ghostChunk;
+			return;
 		}
-		index++;
+		const FVector2D& position = points[triangles[3 * t]];
+		const int32 x = FMath::Clamp(FMath::FloorToInt(position.X / mapSize.X * ChunksPerSide), 0, ChunksPerSide - 1);
+		const int32 y = FMath::Clamp(FMath::FloorToInt(position.Y / mapSize.Y * ChunksPerSide), 0, ChunksPerSide - 1);
+		OutTriangleChunks[t] = y * ChunksPerSide + x;
+	});
+
+	OutChunkOffsets.SetNumZeroed(numGridChunks + 2);
+	for (int32 t = 0; t < OutTriangleChunks.Num(); t++)
+	{
+		OutChunkOffsets[OutTriangleChunks[t] + 1]++;
+	}
+	for (int32 i = 0; i < numGridChunks + 1; i++)
+	{
+		OutChunkOffsets[i + 1] += OutChunkOffsets[i];
 	}
 
-	// Enable collision data
-	MapMesh->ContainsPhysicsTriMeshData(true);
+	OutChunkTriangles.SetNumUninitialized(OutTriangleChunks.Num());
+	TArray<int32> nextSlot = OutChunkOffsets;
+	for (int32 t = 0; t < OutTriangleChunks.Num(); t++)
+	{
+		OutChunkTriangles[nextSlot[OutTriangleChunks[t]]++] = t;
+	}
 }
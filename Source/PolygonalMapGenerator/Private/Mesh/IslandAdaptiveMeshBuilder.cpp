@@ -0,0 +1,49 @@
+/*
+* From http://www.redblobgames.com/maps/mapgen2/
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Mesh/IslandAdaptiveMeshBuilder.h"
+#include "DualMeshBuilder.h"
+
+UIslandAdaptiveMeshBuilder::UIslandAdaptiveMeshBuilder()
+{
+	SeaSpacing = 3000.0f;
+	LandRadius = 0.7f;
+	SeaRadius = 1.0f;
+}
+
+void UIslandAdaptiveMeshBuilder::AddPoints_Implementation(UDualMeshBuilder* Builder, FRandomStream& Rng) const
+{
+	const float minSpacing = FMath::Min(PoissonSpacing, SeaSpacing);
+	Builder->AddVariablePoisson(Rng, [this](const FVector2D& Point)
+	{
+		return FMath::Lerp(SeaSpacing, PoissonSpacing, FMath::Clamp(GetPointDensity(Point), 0.0f, 1.0f));
+	}, MapSize - PoissonSize, minSpacing, PoissonSamples);
+}
+
+float UIslandAdaptiveMeshBuilder::GetPointDensity_Implementation(const FVector2D& Point) const
+{
+	// Distance from the center of the map, where 1 is the middle of an edge
+	const FVector2D halfSize = MapSize * 0.5f;
+	const FVector2D offset = FVector2D((Point.X - halfSize.X) / halfSize.X, (Point.Y - halfSize.Y) / halfSize.Y);
+	const float distance = offset.Size();
+	if (SeaRadius <= LandRadius)
+	{
+		return distance < SeaRadius ? 1.0f : 0.0f;
+	}
+	return 1.0f - FMath::SmoothStep(LandRadius, SeaRadius, distance);
+}
@@ -18,11 +18,14 @@
 
 #include "Mesh/IslandMeshBuilder.h"
 #include "DualMeshBuilder.h"
+#include "DualMeshCache.h"
+#include "PolygonalMapGenerator.h"
 
 UIslandMeshBuilder::UIslandMeshBuilder()
 {
 	MapSize = FVector2D(107500.0, 107500.0);
 	BoundarySpacing = 1000;
+	bCacheMesh = false;
 }
 
 void UIslandMeshBuilder::AddPoints_Implementation(UDualMeshBuilder* Builder, FRandomStream& Rng) const
@@ -30,10 +33,75 @@ void UIslandMeshBuilder::AddPoints_Implementation(UDualMeshBuilder* Builder, FRa
 	// Do nothing
 }
 
+FString UIslandMeshBuilder::GetCacheKey(const FRandomStream& Rng) const
+{
+	FString key = GetClass()->GetPathName();
+	for (TFieldIterator<UProperty> it(GetClass()); it; ++it)
+	{
+		UProperty* property = *it;
+		FString value;
+		property->ExportTextItem(value, property->ContainerPtrToValuePtr<void>(this), NULL, NULL, PPF_None);
+		key += FString::Printf(TEXT("|%s=%s"), *property->GetName(), *value);
+	}
+	key += FString::Printf(TEXT("|Seed=%d"), Rng.GetCurrentSeed());
+	return key;
+}
+
 UTriangleDualMesh* UIslandMeshBuilder::GenerateDualMesh_Implementation(FRandomStream& Rng) const
 {
+	FString cacheKey;
+	if (bCacheMesh)
+	{
+		cacheKey = GetCacheKey(Rng);
+		int32 rngSteps = 0;
+		UTriangleDualMesh* cachedMesh = FDualMeshCache::Load(cacheKey, rngSteps);
+		if (cachedMesh != NULL)
+		{
+			// Leave the stream exactly where building the mesh would have left it,
+			// so everything generated after this comes out the same
+			for (int32 i = 0; i < rngSteps; i++)
+			{
+				Rng.GetUnsignedInt();
+			}
+			return cachedMesh;
+		}
+	}
+
+#if !UE_BUILD_SHIPPING
+	FDateTime startTime = FDateTime::UtcNow();
+#endif
+	const FRandomStream startRng = Rng;
+
 	UDualMeshBuilder* builder = NewObject<UDualMeshBuilder>();
 	builder->Initialize(MapSize, BoundarySpacing);
 	AddPoints(builder, Rng);
-	return builder->Create();
+	UTriangleDualMesh* mesh = builder->Create();
+
+	if (bCacheMesh && mesh != NULL)
+	{
+#if !UE_BUILD_SHIPPING
+		FTimespan difference = FDateTime::UtcNow() - startTime;
+		UE_LOG(LogMapGen, Log, TEXT("Built a dual mesh with %d regions in %f seconds."), mesh->NumRegions, difference.GetTotalSeconds());
+#endif
+		// Every draw from a random stream advances its seed once, so count how many
+		// draws it takes to get from the old seed to the new one
+		const int32 maxRngSteps = 1 << 26;
+		FRandomStream replayRng = startRng;
+		int32 rngSteps = 0;
+		while (replayRng.GetCurrentSeed() != Rng.GetCurrentSeed() && rngSteps < maxRngSteps)
+		{
+			replayRng.GetUnsignedInt();
+			rngSteps++;
+		}
+
+		if (replayRng.GetCurrentSeed() == Rng.GetCurrentSeed())
+		{
+			FDualMeshCache::Save(mesh, cacheKey, rngSteps);
+		}
+		else
+		{
+			UE_LOG(LogMapGen, Warning, TEXT("Could not work out how far the random stream moved while building the mesh, so it won't be cached."));
+		}
+	}
+	return mesh;
 }
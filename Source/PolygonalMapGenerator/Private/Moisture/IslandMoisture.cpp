@@ -17,6 +17,13 @@
 */
 
 #include "Moisture/IslandMoisture.h"
+#include "DualMeshDistanceField.h"
+#include "DualMeshParallel.h"
+
+UIslandMoisture::UIslandMoisture()
+{
+	bUseGeometricDistances = false;
+}
 
 TSet<FPointIndex> UIslandMoisture::FindRiverbanks(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow) const
 {
@@ -32,33 +39,65 @@ TSet<FPointIndex> UIslandMoisture::FindRiverbanks(UTriangleDualMesh* Mesh, const
 	return banks;
 }
 
-TSet<FPointIndex> UIslandMoisture::FindLakeshores(UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const
+TSet<FPointIndex> UIslandMoisture::FindLakeshores(const TArray<FIslandLake>& Lakes) const
 {
 	TSet<FPointIndex> shores;
-	for (FSideIndex s = 0; s < Mesh->NumSolidSides; s++)
+	for (const FIslandLake& lake : Lakes)
 	{
-		FPointIndex r = Mesh->s_begin_r(s);
-		if (r_water[r] && !r_ocean[r])
-		{
-			shores.Add(r);
-			shores.Add(Mesh->s_end_r(s));
-		}
+		shores.Append(lake.Regions);
+		shores.Append(lake.ShoreRegions);
 	}
 	return shores;
 }
 
-TSet<FPointIndex> UIslandMoisture::FindMoistureSeeds_Implementation(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const
+TSet<FPointIndex> UIslandMoisture::FindMoistureSeeds_Implementation(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<FIslandLake>& Lakes) const
 {
 	TSet<FPointIndex> seeds;
 
 	seeds.Append(FindRiverbanks(Mesh, s_flow));
-	seeds.Append(FindLakeshores(Mesh, r_ocean, r_water));
+	seeds.Append(FindLakeshores(Lakes));
 
 	return seeds;
 }
 
+void UIslandMoisture::AssignGeometricRegionMoisture(TArray<float>& r_moisture, TArray<int32>& r_waterdistance, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TSet<FPointIndex>& seed_r) const
+{
+	r_moisture.Empty(Mesh->NumRegions);
+	r_moisture.SetNumZeroed(Mesh->NumRegions);
+	r_waterdistance.Empty(Mesh->NumRegions);
+	r_waterdistance.SetNumZeroed(Mesh->NumRegions);
+
+	// Like the breadth first search, never walk into water; seeds on the water still count as sources
+	TArray<FPointIndex> seeds = seed_r.Array();
+	TArray<float> r_distance;
+	const float meanLength = FDualMeshDistanceField::ComputeRegionDistances(Mesh, seeds, [&](FSideIndex s)
+	{
+		return r_water[Mesh->s_end_r(s)] ? -1.0f : 1.0f;
+	}, r_distance);
+
+	float maxDistance = meanLength;
+	for (float distance : r_distance)
+	{
+		maxDistance = FMath::Max(maxDistance, distance);
+	}
+
+	FDualMeshParallel::ForEach(Mesh->NumRegions, [&](int32 r)
+	{
+		// Land which can't reach any water is as dry as it gets
+		const float distance = r_distance[r] < 0.0f ? maxDistance : r_distance[r];
+		r_waterdistance[r] = r_distance[r] < 0.0f ? -1 : FMath::RoundToInt(distance / meanLength);
+		r_moisture[r] = r_water[r] ? 1.0f : 1.0f - FMath::Pow(distance / maxDistance, 0.5f);
+	});
+}
+
 void UIslandMoisture::AssignRegionMoisture_Implementation(TArray<float>& r_moisture, TArray<int32>& r_waterdistance, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TSet<FPointIndex>& seed_r) const
 {
+	if (bUseGeometricDistances)
+	{
+		AssignGeometricRegionMoisture(r_moisture, r_waterdistance, Mesh, r_water, seed_r);
+		return;
+	}
+
 	r_moisture.Empty(Mesh->NumRegions);
 	r_moisture.SetNumZeroed(Mesh->NumRegions);
 	r_waterdistance.Empty(Mesh->NumRegions);
@@ -96,10 +135,10 @@ void UIslandMoisture::AssignRegionMoisture_Implementation(TArray<float>& r_moist
 	}
 
 	// Actually set the moisture
-	for (FPointIndex r = 0; r < r_waterdistance.Num(); r++)
+	FDualMeshParallel::ForEach(r_waterdistance.Num(), [&](int32 r)
 	{
 		r_moisture[r] = r_water[r] ? 1.0f : 1.0f - FMath::Pow((float)r_waterdistance[r] / maxDistance, 0.5f);
-	}
+	});
 }
 
 void UIslandMoisture::RedistributeRegionMoisture_Implementation(TArray<float>& r_moisture, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, float MinMoisture, float MaxMoisture) const
@@ -139,7 +178,7 @@ void UIslandMoisture::redistribute_r_moisture(TArray<float>& r_moisture, UTriang
 	RedistributeRegionMoisture(r_moisture, Mesh, r_water, MinMoisture, MaxMoisture);
 }
 
-TSet<FPointIndex> UIslandMoisture::find_moisture_seeds_r(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const
+TSet<FPointIndex> UIslandMoisture::find_moisture_seeds_r(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<FIslandLake>& Lakes) const
 {
-	return FindMoistureSeeds(Mesh, s_flow, r_ocean, r_water);
+	return FindMoistureSeeds(Mesh, s_flow, Lakes);
 }
@@ -0,0 +1,495 @@
+/*
+* From http://www.redblobgames.com/maps/mapgen2/
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Navigation/IslandNavigationGraph.h"
+#include "PolygonalMapGenerator.h"
+#include "DualMeshParallel.h"
+#include "Algo/Reverse.h"
+
+FIslandNavigationGraph::FIslandNavigationGraph(const UTriangleDualMesh* Mesh, const TArray<float>& RegionElevation, const TArray<bool>& WaterRegions,
+	const TArray<bool>& OceanRegions, const TArray<int32>& SideFlow, const FIslandNavigationSettings& Settings)
+{
+	ClusterCellSize = FVector2D::ZeroVector;
+	ClustersWide = 0;
+	ClustersHigh = 0;
+	if (Mesh == NULL)
+	{
+		return;
+	}
+	const int32 numRegions = Mesh->NumRegions;
+	if (RegionElevation.Num() != numRegions || WaterRegions.Num() != numRegions || OceanRegions.Num() != numRegions || SideFlow.Num() != Mesh->NumSides)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("Can't build a navigation graph from island data which doesn't match the mesh!"));
+		return;
+	}
+
+	Positions = Mesh->GetPoints();
+	const int32 ghost = numRegions - 1;
+	Passable.SetNumUninitialized(numRegions);
+	for (int32 r = 0; r < numRegions; r++)
+	{
+		Passable[r] = r != ghost && (Settings.bAllowOcean || !OceanRegions[r]);
+	}
+
+	// Weigh every side of the mesh
+	const TArray<int32>& sideOffsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& sides = Mesh->GetRegionSides();
+	const TArray<FPointIndex>& triangles = Mesh->GetRawMesh().DelaunayTriangles;
+	const TArray<FSideIndex>& halfEdges = Mesh->GetRawMesh().HalfEdges;
+	EdgeOffsets = sideOffsets;
+	EdgeTargets.SetNumUninitialized(sides.Num());
+	EdgeCosts.SetNumUninitialized(sides.Num());
+	ReverseEdgeCosts.SetNumUninitialized(sides.Num());
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
+	{
+		for (int32 i = sideOffsets[r]; i < sideOffsets[r + 1]; i++)
+		{
+			const int32 s = sides[i];
+			const int32 q = (int32)triangles[s % 3 == 2 ? s - 2 : s + 1];
+			EdgeTargets[i] = q;
+			if (!Passable[r] || !Passable[q])
+			{
+				EdgeCosts[i] = -1.0f;
+				continue;
+			}
+
+			// Every cost is at least the distance walked, which keeps the A* heuristic admissible
+			float cost = FVector2D::Distance(Positions[r], Positions[q]) + Settings.ElevationCost * FMath::Abs(RegionElevation[q] - RegionElevation[r]);
+			if (WaterRegions[q])
+			{
+				cost *= FMath::Max(Settings.WaterCostMultiplier, 1.0f);
+			}
+			// Rivers flow along the border between the two regions
+			const FSideIndex opposite = halfEdges[s];
+			if (SideFlow[s] > 0 || (opposite.IsValid() && SideFlow[opposite] > 0))
+			{
+				cost += Settings.RiverCrossingCost;
+			}
+			EdgeCosts[i] = cost;
+		}
+	});
+
+	TArray<int32> sideEdges;
+	sideEdges.SetNumUninitialized(sides.Num());
+	for (int32 i = 0; i < sides.Num(); i++)
+	{
+		sideEdges[sides[i]] = i;
+	}
+	FDualMeshParallel::ForEach(sides.Num(), [&](int32 i)
+	{
+		ReverseEdgeCosts[i] = EdgeCosts[sideEdges[halfEdges[sides[i]]]];
+	});
+
+	// Group regions into clusters
+	const FVector2D size = Mesh->GetSize();
+	const float clusterSize = FMath::Max(Settings.ClusterSize, 1.0f);
+	ClustersWide = FMath::Max(1, FMath::CeilToInt(size.X / clusterSize));
+	ClustersHigh = FMath::Max(1, FMath::CeilToInt(size.Y / clusterSize));
+	ClusterCellSize = FVector2D(FMath::Max(size.X / ClustersWide, 1.0f), FMath::Max(size.Y / ClustersHigh, 1.0f));
+	const int32 numClusters = ClustersWide * ClustersHigh;
+	RegionClusters.SetNumUninitialized(numRegions);
+	for (int32 r = 0; r < numRegions; r++)
+	{
+		RegionClusters[r] = GetCluster(Positions[r]);
+	}
+
+	// Pick the cheapest crossing between every pair of neighboring clusters as their entrance
+	struct FEntrance
+	{
+		int32 From;
+		int32 To;
+		float Cost;
+		float ReverseCost;
+	};
+	TMap<uint64, FEntrance> bestEntrances;
+	for (int32 r = 0; r < numRegions; r++)
+	{
+		for (int32 i = EdgeOffsets[r]; i < EdgeOffsets[r + 1]; i++)
+		{
+			const int32 q = EdgeTargets[i];
+			const int32 clusterA = RegionClusters[r];
+			const int32 clusterB = RegionClusters[q];
+			// Only look at each border from its lower-numbered side
+			if (EdgeCosts[i] < 0.0f || clusterA >= clusterB)
+			{
+				continue;
+			}
+			const uint64 key = ((uint64)clusterA << 32) | (uint32)clusterB;
+			const FEntrance* existing = bestEntrances.Find(key);
+			if (existing == NULL || EdgeCosts[i] + ReverseEdgeCosts[i] < existing->Cost + existing->ReverseCost)
+			{
+				bestEntrances.Add(key, FEntrance{ r, q, EdgeCosts[i], ReverseEdgeCosts[i] });
+			}
+		}
+	}
+
+	struct FEntranceEdge
+	{
+		int32 From;
+		int32 To;
+		float Cost;
+	};
+	TArray<FEntranceEdge> entranceEdges;
+	ClusterEntrances.SetNum(numClusters);
+	auto addEntrance = [this](int32 Region)
+	{
+		if (const int32* existing = RegionEntrances.Find(Region))
+		{
+			return *existing;
+		}
+		const int32 index = EntranceRegions.Add(Region);
+		RegionEntrances.Add(Region, index);
+		ClusterEntrances[RegionClusters[Region]].Add(index);
+		return index;
+	};
+	for (const TPair<uint64, FEntrance>& pair : bestEntrances)
+	{
+		const int32 a = addEntrance(pair.Value.From);
+		const int32 b = addEntrance(pair.Value.To);
+		entranceEdges.Add(FEntranceEdge{ a, b, pair.Value.Cost });
+		entranceEdges.Add(FEntranceEdge{ b, a, pair.Value.ReverseCost });
+	}
+
+	// Work out the cost between every pair of entrances inside each cluster
+	TArray<TArray<FEntranceEdge>> clusterEdges;
+	clusterEdges.SetNum(numClusters);
+	FDualMeshParallel::ForEach(numClusters, [&](int32 cluster)
+	{
+		const TArray<int32>& entrances = ClusterEntrances[cluster];
+		if (entrances.Num() < 2)
+		{
+			return;
+		}
+		TMap<int32, FSearchNode> nodes;
+		for (int32 from : entrances)
+		{
+			nodes.Reset();
+			Search(EntranceRegions[from], INDEX_NONE, cluster, false, nodes);
+			for (int32 to : entrances)
+			{
+				const FSearchNode* node = nodes.Find(EntranceRegions[to]);
+				if (to != from && node != NULL && node->bClosed)
+				{
+					clusterEdges[cluster].Add(FEntranceEdge{ from, to, node->Cost });
+				}
+			}
+		}
+	}, 1);
+	for (const TArray<FEntranceEdge>& edges : clusterEdges)
+	{
+		entranceEdges.Append(edges);
+	}
+
+	// Bucket the entrance edges by where they start
+	const int32 numEntrances = EntranceRegions.Num();
+	EntranceEdgeOffsets.SetNumZeroed(numEntrances + 1);
+	for (const FEntranceEdge& edge : entranceEdges)
+	{
+		EntranceEdgeOffsets[edge.From + 1]++;
+	}
+	for (int32 i = 0; i < numEntrances; i++)
+	{
+		EntranceEdgeOffsets[i + 1] += EntranceEdgeOffsets[i];
+	}
+	EntranceEdgeTargets.SetNumUninitialized(entranceEdges.Num());
+	EntranceEdgeCosts.SetNumUninitialized(entranceEdges.Num());
+	TArray<int32> nextSlot = EntranceEdgeOffsets;
+	for (const FEntranceEdge& edge : entranceEdges)
+	{
+		const int32 slot = nextSlot[edge.From]++;
+		EntranceEdgeTargets[slot] = edge.To;
+		EntranceEdgeCosts[slot] = edge.Cost;
+	}
+}
+
+int32 FIslandNavigationGraph::GetCluster(const FVector2D& Position) const
+{
+	const int32 x = FMath::Clamp(FMath::FloorToInt(Position.X / ClusterCellSize.X), 0, ClustersWide - 1);
+	const int32 y = FMath::Clamp(FMath::FloorToInt(Position.Y / ClusterCellSize.Y), 0, ClustersHigh - 1);
+	return y * ClustersWide + x;
+}
+
+bool FIslandNavigationGraph::IsPassable(int32 Region) const
+{
+	return Passable.IsValidIndex(Region) && Passable[Region];
+}
+
+int32 FIslandNavigationGraph::GetNumClusters() const
+{
+	return ClustersWide * ClustersHigh;
+}
+
+int32 FIslandNavigationGraph::GetNumEntrances() const
+{
+	return EntranceRegions.Num();
+}
+
+void FIslandNavigationGraph::Search(int32 Start, int32 Goal, int32 Cluster, bool bReverse, TMap<int32, FSearchNode>& OutNodes) const
+{
+	const TArray<float>& costs = bReverse ? ReverseEdgeCosts : EdgeCosts;
+	TArray<FOpenNode> open;
+	OutNodes.Add(Start, FSearchNode{ 0.0f, INDEX_NONE, false });
+	open.HeapPush(FOpenNode{ Start, 0.0f });
+	while (open.Num() > 0)
+	{
+		FOpenNode current;
+		open.HeapPop(current, false);
+		FSearchNode& node = OutNodes[current.Node];
+		if (node.bClosed)
+		{
+			continue;
+		}
+		node.bClosed = true;
+		if (current.Node == Goal)
+		{
+			return;
+		}
+
+		const float cost = node.Cost;
+		for (int32 i = EdgeOffsets[current.Node]; i < EdgeOffsets[current.Node + 1]; i++)
+		{
+			const int32 next = EdgeTargets[i];
+			if (costs[i] < 0.0f || (Cluster != INDEX_NONE && RegionClusters[next] != Cluster))
+			{
+				continue;
+			}
+
+			const float nextCost = cost + costs[i];
+			FSearchNode* existing = OutNodes.Find(next);
+			if (existing != NULL && (existing->bClosed || existing->Cost <= nextCost))
+			{
+				continue;
+			}
+			if (existing != NULL)
+			{
+				existing->Cost = nextCost;
+				existing->Parent = current.Node;
+			}
+			else
+			{
+				OutNodes.Add(next, FSearchNode{ nextCost, current.Node, false });
+			}
+			const float heuristic = Goal != INDEX_NONE ? FVector2D::Distance(Positions[next], Positions[Goal]) : 0.0f;
+			open.HeapPush(FOpenNode{ next, nextCost + heuristic });
+		}
+	}
+}
+
+bool FIslandNavigationGraph::AppendClusterPath(int32 From, int32 To, int32 Cluster, TArray<FPointIndex>& OutPath) const
+{
+	if (From == To)
+	{
+		return true;
+	}
+
+	TMap<int32, FSearchNode> nodes;
+	Search(From, To, Cluster, false, nodes);
+	const FSearchNode* goal = nodes.Find(To);
+	if (goal == NULL || !goal->bClosed)
+	{
+		return false;
+	}
+
+	const int32 start = OutPath.Num();
+	for (int32 r = To; r != From; r = nodes[r].Parent)
+	{
+		OutPath.Add(r);
+	}
+	Algo::Reverse(OutPath.GetData() + start, OutPath.Num() - start);
+	return true;
+}
+
+bool FIslandNavigationGraph::FindFlatPath(FPointIndex Start, FPointIndex Goal, TArray<FPointIndex>& OutPath) const
+{
+	OutPath.Empty();
+	if (!IsPassable(Start) || !IsPassable(Goal))
+	{
+		return false;
+	}
+	// Even if both ends are in the same cluster, the only way between them might leave it (around a bay or lake, say)
+	OutPath.Add(Start);
+	if (!AppendClusterPath(Start, Goal, INDEX_NONE, OutPath))
+	{
+		OutPath.Empty();
+		return false;
+	}
+	return true;
+}
+
+bool FIslandNavigationGraph::FindPath(FPointIndex Start, FPointIndex Goal, TArray<FPointIndex>& OutPath) const
+{
+	OutPath.Empty();
+	const int32 start = Start.IsValid() ? (int32)Start.Value : INDEX_NONE;
+	const int32 goal = Goal.IsValid() ? (int32)Goal.Value : INDEX_NONE;
+	if (!IsPassable(start) || !IsPassable(goal))
+	{
+		return false;
+	}
+
+	const int32 startCluster = RegionClusters[start];
+	const int32 goalCluster = RegionClusters[goal];
+	if (startCluster == goalCluster)
+	{
+		// Short paths aren't worth going through the entrances for
+		return FindFlatPath(Start, Goal, OutPath);
+	}
+
+	// Find the cost from the start to every entrance of its cluster, and from every entrance of the goal's cluster to the goal
+	TMap<int32, FSearchNode> startNodes;
+	TMap<int32, FSearchNode> goalNodes;
+	Search(start, INDEX_NONE, startCluster, false, startNodes);
+	Search(goal, INDEX_NONE, goalCluster, true, goalNodes);
+
+	// A* across the entrances. The start and goal get node indices just past the real entrances.
+	const int32 startNode = EntranceRegions.Num();
+	const int32 goalNode = startNode + 1;
+	TMap<int32, FSearchNode> nodes;
+	TArray<FOpenNode> open;
+	auto relax = [&](int32 From, int32 To, float Cost)
+	{
+		FSearchNode* existing = nodes.Find(To);
+		if (existing != NULL && (existing->bClosed || existing->Cost <= Cost))
+		{
+			return;
+		}
+		if (existing != NULL)
+		{
+			existing->Cost = Cost;
+			existing->Parent = From;
+		}
+		else
+		{
+			nodes.Add(To, FSearchNode{ Cost, From, false });
+		}
+		const int32 region = To == goalNode ? goal : EntranceRegions[To];
+		open.HeapPush(FOpenNode{ To, Cost + FVector2D::Distance(Positions[region], Positions[goal]) });
+	};
+
+	bool bFound = false;
+	nodes.Add(startNode, FSearchNode{ 0.0f, INDEX_NONE, false });
+	open.HeapPush(FOpenNode{ startNode, 0.0f });
+	while (open.Num() > 0)
+	{
+		FOpenNode current;
+		open.HeapPop(current, false);
+		FSearchNode& node = nodes[current.Node];
+		if (node.bClosed)
+		{
+			continue;
+		}
+		node.bClosed = true;
+		if (current.Node == goalNode)
+		{
+			bFound = true;
+			break;
+		}
+
+		const float cost = node.Cost;
+		if (current.Node == startNode)
+		{
+			for (int32 entrance : ClusterEntrances[startCluster])
+			{
+				const FSearchNode* reached = startNodes.Find(EntranceRegions[entrance]);
+				if (reached != NULL && reached->bClosed)
+				{
+					relax(startNode, entrance, reached->Cost);
+				}
+			}
+			continue;
+		}
+
+		const int32 entrance = current.Node;
+		if (RegionClusters[EntranceRegions[entrance]] == goalCluster)
+		{
+			const FSearchNode* reached = goalNodes.Find(EntranceRegions[entrance]);
+			if (reached != NULL && reached->bClosed)
+			{
+				relax(entrance, goalNode, cost + reached->Cost);
+			}
+		}
+		for (int32 i = EntranceEdgeOffsets[entrance]; i < EntranceEdgeOffsets[entrance + 1]; i++)
+		{
+			relax(entrance, EntranceEdgeTargets[i], cost + EntranceEdgeCosts[i]);
+		}
+	}
+
+	if (!bFound)
+	{
+		// Water can split a cluster in two, so an entrance might not be reachable from
+		// everywhere inside its cluster. Fall back to searching every region.
+		return FindFlatPath(Start, Goal, OutPath);
+	}
+
+	TArray<int32> waypoints;
+	for (int32 n = goalNode; n != INDEX_NONE; n = nodes[n].Parent)
+	{
+		waypoints.Add(n == goalNode ? goal : n == startNode ? start : EntranceRegions[n]);
+	}
+	Algo::Reverse(waypoints);
+
+	// Fill in the path inside each cluster. Waypoints in different clusters are the two sides of an entrance.
+	OutPath.Add(start);
+	for (int32 i = 1; i < waypoints.Num(); i++)
+	{
+		const int32 from = waypoints[i - 1];
+		const int32 to = waypoints[i];
+		if (from == to)
+		{
+			continue;
+		}
+		if (RegionClusters[from] != RegionClusters[to])
+		{
+			OutPath.Add(to);
+		}
+		else if (!AppendClusterPath(from, to, RegionClusters[from], OutPath))
+		{
+			return FindFlatPath(Start, Goal, OutPath);
+		}
+	}
+	return true;
+}
+
+float FIslandNavigationGraph::GetPathCost(const TArray<FPointIndex>& Path) const
+{
+	float cost = 0.0f;
+	for (int32 i = 1; i < Path.Num(); i++)
+	{
+		const int32 from = (int32)Path[i - 1].Value;
+		const int32 to = (int32)Path[i].Value;
+		if (!EdgeOffsets.IsValidIndex(from + 1))
+		{
+			return -1.0f;
+		}
+
+		float edgeCost = -1.0f;
+		for (int32 e = EdgeOffsets[from]; e < EdgeOffsets[from + 1]; e++)
+		{
+			if (EdgeTargets[e] == to)
+			{
+				edgeCost = EdgeCosts[e];
+				break;
+			}
+		}
+		if (edgeCost < 0.0f)
+		{
+			return -1.0f;
+		}
+		cost += edgeCost;
+	}
+	return cost;
+}
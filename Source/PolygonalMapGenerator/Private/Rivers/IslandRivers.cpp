@@ -17,11 +17,31 @@
 */
 
 #include "Rivers/IslandRivers.h"
+#include "DualMeshParallel.h"
 
 UIslandRivers::UIslandRivers()
 {
 	MinSpringElevation = 0.3f;
 	MaxSpringElevation = 0.9f;
+	RiverFlowThreshold = 0;
+}
+
+bool UIslandRivers::IsTriangleWaterCached(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_water) const
+{
+	if (Mesh->HasTriangleWaterCache())
+	{
+		return Mesh->t_water(t);
+	}
+	return IsTriangleWater(t, Mesh, r_water);
+}
+
+bool UIslandRivers::IsTriangleOceanCached(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
+{
+	if (Mesh->HasTriangleWaterCache())
+	{
+		return Mesh->t_ocean_count(t) >= 2;
+	}
+	return IsTriangleOcean(t, Mesh, r_ocean);
 }
 
 bool UIslandRivers::IsTriangleWater(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_water) const
@@ -37,20 +57,50 @@ bool UIslandRivers::IsTriangleWater(FTriangleIndex t, UTriangleDualMesh* Mesh, c
 	return false;
 }
 
+bool UIslandRivers::IsTriangleOcean(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const
+{
+	TArray<FPointIndex> regions = Mesh->t_circulate_r(t);
+	int32 count = 0;
+	for (FPointIndex r : regions)
+	{
+		if (r_ocean[r])
+		{
+			count++;
+		}
+	}
+	return count >= 2;
+}
+
 TArray<FTriangleIndex> UIslandRivers::FindSpringTriangles_Implementation(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<float>& t_elevation, const TArray<FSideIndex>& t_downslope_s) const
 {
-	TSet<FTriangleIndex> spring_t;
+	TArray<FTriangleIndex> spring_t;
 	if (Mesh != NULL)
 	{
 		// Add everything above some elevation, but not lakes
 		// We skip every other triangle to ensure that we don't select neighboring triangles later
-		for (FTriangleIndex t = 0; t < Mesh->NumSolidTriangles; t += 2)
+		const int32 numCandidates = (Mesh->NumSolidTriangles + 1) / 2;
+		TArray<bool> isSpring;
+		isSpring.SetNumUninitialized(numCandidates);
+		FDualMeshParallel::ForEach(numCandidates, [&](int32 i)
 		{
-			if (t_elevation[t] >= MinSpringElevation &&
+			const int32 t = 2 * i;
+			isSpring[i] = t_elevation[t] >= MinSpringElevation &&
 				t_elevation[t] <= MaxSpringElevation &&
-				!IsTriangleWater(t, Mesh, r_water))
+				!IsTriangleWaterCached(t, Mesh, r_water);
+		});
+
+		int32 numSprings = 0;
+		for (bool bSpring : isSpring)
+		{
+			numSprings += bSpring ? 1 : 0;
+		}
+		spring_t.SetNumUninitialized(numSprings);
+		numSprings = 0;
+		for (int32 i = 0; i < numCandidates; i++)
+		{
+			if (isSpring[i])
 			{
-				spring_t.Add(t);
+				spring_t[numSprings++] = 2 * i;
 			}
 		}
 	}
@@ -58,14 +108,15 @@ TArray<FTriangleIndex> UIslandRivers::FindSpringTriangles_Implementation(UTriang
 	{
 		UE_LOG(LogMapGen, Error, TEXT("Mesh was invalid!"));
 	}
-	return spring_t.Array();
+	return spring_t;
 }
 
-TArray<URiver*> UIslandRivers::CreateRiver(FTriangleIndex RiverTriangle, TArray<int32> &s_flow, TMap<FTriangleIndex, URiver*> RiverMap, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, FRandomStream& RiverRng) const
+void UIslandRivers::CreateRiver(FTriangleIndex RiverTriangle, TArray<int32> &s_flow, TArray<int32>& t_river, FIslandRiverNetwork& RiverNetwork, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, FRandomStream& RiverRng) const
 {
 	TSet<FTriangleIndex> processedSlopes;
-	TArray<URiver*> createdRivers;
-	URiver* currentRiver = NULL;
+	// The river we're adding triangles to, or INDEX_NONE if we've joined an existing river.
+	// This is always the last river in the network, since nothing else adds rivers while we trace.
+	int32 currentRiver = INDEX_NONE;
 	FSideIndex lastS = FSideIndex();
 	while(true)
 	{
@@ -84,50 +135,43 @@ TArray<URiver*> UIslandRivers::CreateRiver(FTriangleIndex RiverTriangle, TArray<
 			{
 				s_flow[s]++;
 
-				if (!RiverMap.Contains(RiverTriangle))
+				if (t_river[RiverTriangle] == INDEX_NONE)
 				{
-					if (currentRiver == NULL)
+					if (currentRiver == INDEX_NONE)
 					{
 						// Make a new river, just for 1 triangle
-						currentRiver = NewObject<URiver>();
-						createdRivers.Add(currentRiver);
+						currentRiver = RiverNetwork.AddRiver();
 					}
-					currentRiver->Add(RiverTriangle, s);
-					RiverMap.Add(RiverTriangle, currentRiver);
+					RiverNetwork.AddTriangle(RiverTriangle, s);
+					t_river[RiverTriangle] = currentRiver;
 				}
-				else if (currentRiver != NULL && RiverMap[RiverTriangle] != NULL)
+				else if (currentRiver != INDEX_NONE)
 				{
-					currentRiver->FeedsInto = RiverMap[RiverTriangle];
-					currentRiver = NULL;
+					RiverNetwork.FeedsInto[currentRiver] = t_river[RiverTriangle];
+					currentRiver = INDEX_NONE;
 				}
 			}
 			break;
 		}
 
-		if (!RiverMap.Contains(RiverTriangle))
+		if (t_river[RiverTriangle] == INDEX_NONE)
 		{
 			// This triangle doesn't have a river in it yet
-			if (currentRiver == NULL)
+			if (currentRiver == INDEX_NONE)
 			{
 				// Make a new river
-				currentRiver = NewObject<URiver>();
-				if (currentRiver == NULL)
-				{
-					UE_LOG(LogMapGen, Error, TEXT("Could not create a new river!"));
-					break;
-				}
-				createdRivers.Add(currentRiver);
+				currentRiver = RiverNetwork.AddRiver();
 			}
 
 			// Now that we know we have a river, mark it as being traversed
-			currentRiver->Add(RiverTriangle, s);
-			RiverMap.Add(RiverTriangle, currentRiver);
+			RiverNetwork.AddTriangle(RiverTriangle, s);
+			t_river[RiverTriangle] = currentRiver;
 		}
-		else if (currentRiver != NULL && RiverMap[RiverTriangle] != NULL)
+		else if (currentRiver != INDEX_NONE)
 		{
 			// The current river joins as a tributary of the river at this location
-			currentRiver->FeedsInto = RiverMap[RiverTriangle];
-			currentRiver = NULL;
+			RiverNetwork.FeedsInto[currentRiver] = t_river[RiverTriangle];
+			currentRiver = INDEX_NONE;
 		}
 
 		// Each river contributes 1 more flow down to the coastline
@@ -144,34 +188,170 @@ TArray<URiver*> UIslandRivers::CreateRiver(FTriangleIndex RiverTriangle, TArray<
 		RiverTriangle = next_t;
 		lastS = s;
 	}
+}
+
+void UIslandRivers::AccumulateTriangleFlow_Implementation(TArray<int32>& t_flow, TArray<int32>& t_watershed, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<bool>& r_ocean) const
+{
+	if (Mesh == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Mesh was invalid!"));
+		return;
+	}
+
+	const int32 numTriangles = Mesh->NumTriangles;
+	t_flow.Empty(numTriangles);
+	t_flow.SetNumZeroed(numTriangles);
+	t_watershed.Empty(numTriangles);
+	t_watershed.Init(-1, numTriangles);
+	if (t_downslope_s.Num() != numTriangles)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Downslope array had %d triangles, but the mesh has %d!"), t_downslope_s.Num(), numTriangles);
+		return;
+	}
+
+	// Find where each triangle drains to, and give every land triangle its rain
+	TArray<int32> t_downstream_t;
+	t_downstream_t.SetNumUninitialized(numTriangles);
+	TArray<bool> t_ocean;
+	t_ocean.SetNumUninitialized(numTriangles);
+	FDualMeshParallel::ForEach(numTriangles, [&](int32 t)
+	{
+		const FSideIndex s = t_downslope_s[t];
+		t_downstream_t[t] = s.IsValid() ? (int32)Mesh->s_outer_t(s) : INDEX_NONE;
+		t_ocean[t] = t >= Mesh->NumSolidTriangles || IsTriangleOceanCached(t, Mesh, r_ocean);
+		t_flow[t] = t_ocean[t] ? 0 : 1;
+	});
 
-	// One final pass; make sure none of the rivers are null
-	TArray<URiver*> riverArray;
-	for (int i = 0; i < createdRivers.Num(); i++)
+	TArray<int32> upstreamCount;
+	upstreamCount.SetNumZeroed(numTriangles);
+	for (int32 t = 0; t < numTriangles; t++)
 	{
-		if (createdRivers[i] == NULL)
+		if (t_downstream_t[t] != INDEX_NONE)
 		{
-			UE_LOG(LogMapGen, Error, TEXT("River at index %d was null!"), i);
+			upstreamCount[t_downstream_t[t]]++;
+		}
+	}
+
+	// Start at the headwaters. A triangle is only queued once everything upstream of it has been,
+	// so every triangle passes its total flow downstream exactly once.
+	TArray<int32> order;
+	order.Reserve(numTriangles);
+	for (int32 t = 0; t < numTriangles; t++)
+	{
+		if (upstreamCount[t] == 0)
+		{
+			order.Add(t);
+		}
+	}
+	for (int32 i = 0; i < order.Num(); i++)
+	{
+		const int32 t = order[i];
+		const int32 downstream_t = t_downstream_t[t];
+		if (downstream_t == INDEX_NONE)
+		{
+			continue;
+		}
+		// The rain stops counting once it reaches the sea
+		if (!t_ocean[downstream_t])
+		{
+			t_flow[downstream_t] += t_flow[t];
+		}
+		if (--upstreamCount[downstream_t] == 0)
+		{
+			order.Add(downstream_t);
+		}
+	}
+	if (order.Num() < numTriangles)
+	{
+		UE_LOG(LogMapGen, Warning, TEXT("%d triangles are part of a downslope loop and won't have any flow passed through them."), numTriangles - order.Num());
+	}
+
+	// Walk back up from the outlets, so every triangle's downstream triangle already knows its watershed.
+	// Ocean triangles don't get a watershed themselves, but everything draining into the same one shares a watershed.
+	int32 numWatersheds = 0;
+	TMap<int32, int32> outletWatersheds;
+	for (int32 i = order.Num() - 1; i >= 0; i--)
+	{
+		const int32 t = order[i];
+		if (t_ocean[t])
+		{
+			continue;
+		}
+		const int32 downstream_t = t_downstream_t[t];
+		if (downstream_t != INDEX_NONE && t_ocean[downstream_t])
+		{
+			int32& outletWatershed = outletWatersheds.FindOrAdd(downstream_t, numWatersheds);
+			if (outletWatershed == numWatersheds)
+			{
+				numWatersheds++;
+			}
+			t_watershed[t] = outletWatershed;
+		}
+		else if (downstream_t == INDEX_NONE || t_watershed[downstream_t] == -1)
+		{
+			t_watershed[t] = numWatersheds++;
 		}
 		else
 		{
-			riverArray.Add(createdRivers[i]);
+			t_watershed[t] = t_watershed[downstream_t];
 		}
 	}
-	return riverArray;
 }
 
-void UIslandRivers::AssignSideFlow_Implementation(TArray<int32>& s_flow, TArray<URiver*>& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRng) const
+TArray<FTriangleIndex> UIslandRivers::FindRiverHeadTriangles_Implementation(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<int32>& t_flow, const TArray<FSideIndex>& t_downslope_s) const
+{
+	TArray<FTriangleIndex> head_t;
+	if (Mesh == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Mesh was invalid!"));
+		return head_t;
+	}
+	if (RiverFlowThreshold <= 0 || t_flow.Num() != Mesh->NumTriangles || t_downslope_s.Num() != Mesh->NumTriangles)
+	{
+		return head_t;
+	}
+
+	const TArray<int32>& t_neighbors = Mesh->GetTriangleNeighbors();
+	auto isRiverTriangle = [&](int32 t)
+	{
+		return t_flow[t] >= RiverFlowThreshold && !IsTriangleWaterCached(t, Mesh, r_water);
+	};
+	for (int32 t = 0; t < Mesh->NumSolidTriangles; t++)
+	{
+		if (!isRiverTriangle(t))
+		{
+			continue;
+		}
+
+		// Rivers flowing out of lakes start at the lake's edge
+		bool bFedByRiver = false;
+		for (int32 s = 3 * t; s < 3 * t + 3 && !bFedByRiver; s++)
+		{
+			const int32 neighbor_t = t_neighbors[s];
+			const FSideIndex downslope_s = t_downslope_s[neighbor_t];
+			bFedByRiver = downslope_s.IsValid() && (int32)Mesh->s_outer_t(downslope_s) == t && isRiverTriangle(neighbor_t);
+		}
+		if (!bFedByRiver)
+		{
+			head_t.Add(t);
+		}
+	}
+	return head_t;
+}
+
+void UIslandRivers::AssignSideFlow_Implementation(TArray<int32>& s_flow, FIslandRiverNetwork& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRng) const
 {
 	if (Mesh)
 	{
 		Rivers.Empty(river_t.Num());
 		s_flow.Empty(Mesh->NumSides);
 		s_flow.SetNumZeroed(Mesh->NumSides);
-		TMap<FTriangleIndex, URiver*> riverTriangles;
+		// Shared between every river, so later rivers can find the ones they flow into
+		TArray<int32> t_river;
+		t_river.Init(INDEX_NONE, Mesh->NumTriangles);
 		for (int i = 0; i < river_t.Num(); i++)
 		{
-			Rivers.Append(CreateRiver(river_t[i], s_flow, riverTriangles, Mesh, t_downslope_s, RiverRng));
+			CreateRiver(river_t[i], s_flow, t_river, Rivers, Mesh, t_downslope_s, RiverRng);
 		}
 	}
 	else
@@ -185,7 +365,17 @@ TArray<FTriangleIndex> UIslandRivers::find_spring_t(UTriangleDualMesh* Mesh, con
 	return FindSpringTriangles(Mesh, r_water, t_elevation, t_downslope_s);
 }
 
-void UIslandRivers::assign_s_flow(TArray<int32>& s_flow, TArray<URiver*>& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRng) const
+void UIslandRivers::assign_t_flow(TArray<int32>& t_flow, TArray<int32>& t_watershed, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<bool>& r_ocean) const
+{
+	AccumulateTriangleFlow(t_flow, t_watershed, Mesh, t_downslope_s, r_ocean);
+}
+
+TArray<FTriangleIndex> UIslandRivers::find_river_head_t(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<int32>& t_flow, const TArray<FSideIndex>& t_downslope_s) const
+{
+	return FindRiverHeadTriangles(Mesh, r_water, t_flow, t_downslope_s);
+}
+
+void UIslandRivers::assign_s_flow(TArray<int32>& s_flow, FIslandRiverNetwork& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRng) const
 {
 	AssignSideFlow(s_flow, Rivers, Mesh, t_downslope_s, river_t, RiverRng);
 }
\ No newline at end of file
@@ -19,10 +19,707 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Engine/World.h"
+#include "Engine/DataTable.h"
+
+#include "IslandMap.h"
+#include "Mesh/IslandPoissonMeshBuilder.h"
+#include "Water/IslandNoiseWater.h"
+
+// How much more a path through the clusters may cost than the cheapest path
+#define MAX_CLUSTERED_PATH_COST_RATIO 1.5f
 
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWaterTest, "Procedural Generation.PolygonalMapGenerator.Check Water Generation", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::LowPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLakeTest, "Procedural Generation.PolygonalMapGenerator.Check Lakes", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDrainageTest, "Procedural Generation.PolygonalMapGenerator.Check Drainage", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBiomeTest, "Procedural Generation.PolygonalMapGenerator.Check Biomes", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNavigationTest, "Procedural Generation.PolygonalMapGenerator.Check Navigation", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSnapshotTest, "Procedural Generation.PolygonalMapGenerator.Check Snapshots", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter | EAutomationTestFlags::MediumPriority)
+
+/**
+* A small island generated from a fixed seed, in a world of its own so the tests don't need a level open.
+* The world is torn down again once this goes out of scope.
+*/
+struct FTestIsland
+{
+	UWorld* World;
+	AIslandMap* Map;
+
+	FTestIsland()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+		Map = NULL;
+		Map = SpawnMap();
+		if (Map == NULL)
+		{
+			return;
+		}
+
+		UIslandPoissonMeshBuilder* pointGenerator = NewObject<UIslandPoissonMeshBuilder>(Map);
+		pointGenerator->MapSize = FVector2D(50000.0f, 50000.0f);
+		pointGenerator->PoissonSize = FVector2D(46000.0f, 46000.0f);
+		pointGenerator->PoissonSpacing = 1000.0f;
+		Map->PointGenerator = pointGenerator;
+		Map->Water = NewObject<UIslandNoiseWater>(Map);
+		Map->Elevation = NewObject<UIslandElevation>(Map);
+		Map->Rivers = NewObject<UIslandRivers>(Map);
+		Map->Moisture = NewObject<UIslandMoisture>(Map);
+		UIslandBiome* biomes = NewObject<UIslandBiome>(Map);
+		biomes->BiomeData = CreateBiomeTable(biomes);
+		Map->Biomes = biomes;
+	}
+
+	~FTestIsland()
+	{
+		World->DestroyWorld(false);
+		World->RemoveFromRoot();
+	}
+
+	// An island with no data of its own yet, which uses the same assets as Map once they're set up.
+	AIslandMap* SpawnMap() const
+	{
+		AIslandMap* map = World->SpawnActor<AIslandMap>();
+		if (map != NULL && Map != NULL)
+		{
+			map->PointGenerator = Map->PointGenerator;
+			map->Water = Map->Water;
+			map->Elevation = Map->Elevation;
+			map->Rivers = Map->Rivers;
+			map->Moisture = Map->Moisture;
+			map->Biomes = Map->Biomes;
+		}
+		return map;
+	}
+
+	// One biome for each combination of flags GetBiome can reach, so it never has to report a missing biome.
+	static UDataTable* CreateBiomeTable(UObject* Outer)
+	{
+		UDataTable* table = NewObject<UDataTable>(Outer);
+		table->RowStruct = FBiomeData::StaticStruct();
+		auto addBiome = [table](const TCHAR* Name, bool bIsOcean, bool bIsWater, bool bIsCoast, float MinMoisture, float MaxMoisture, const FColor& Color)
+		{
+			FBiomeData biome;
+			biome.Tag = FName(Name);
+			biome.bIsOcean = bIsOcean;
+			biome.bIsWater = bIsWater;
+			biome.bIsCoast = bIsCoast;
+			biome.MinMoisture = MinMoisture;
+			biome.MaxMoisture = MaxMoisture;
+			biome.DebugColor = Color;
+			table->AddRow(FName(Name), biome);
+		};
+		addBiome(TEXT("Ocean"), true, true, false, 0.0f, 1.0f, FColor::Blue);
+		addBiome(TEXT("Lake"), false, true, false, 0.0f, 1.0f, FColor::Cyan);
+		addBiome(TEXT("Beach"), false, false, true, 0.0f, 1.0f, FColor::Yellow);
+		addBiome(TEXT("Grassland"), false, false, false, 0.0f, 0.5f, FColor::Green);
+		addBiome(TEXT("Forest"), false, false, false, 0.5f, 1.0f, FColor::Emerald);
+		return table;
+	}
+};
+
+// True if 2 or more corners of the triangle are ocean, the same as UIslandRivers::IsTriangleOcean
+bool IsTestTriangleOcean(UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, int32 t)
+{
+	if (t >= Mesh->NumSolidTriangles)
+	{
+		return true;
+	}
+	int32 count = 0;
+	for (FPointIndex r : Mesh->t_circulate_r(t))
+	{
+		count += r_ocean[r] ? 1 : 0;
+	}
+	return count >= 2;
+}
 
 bool FWaterTest::RunTest(const FString& Parameters)
 {
+	FTestIsland island;
+	if (island.Map == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not spawn an island!"));
+		return false;
+	}
+	island.Map->GenerateIsland();
+	UTriangleDualMesh* mesh = island.Map->Mesh;
+	const TArray<bool>& r_water = island.Map->GetWaterRegions();
+	const TArray<bool>& r_ocean = island.Map->GetOceanRegions();
+
+	// Plain serial flood fill out from the ghost region to check against
+	TArray<bool> expected;
+	expected.SetNumZeroed(mesh->NumRegions);
+	TArray<FPointIndex> stack = { mesh->ghost_r() };
+	expected[mesh->ghost_r()] = true;
+	while (stack.Num() > 0)
+	{
+		const FPointIndex r1 = stack.Pop();
+		for (FPointIndex r2 : mesh->r_circulate_r(r1))
+		{
+			if (r_water[r2] && !expected[r2])
+			{
+				expected[r2] = true;
+				stack.Add(r2);
+			}
+		}
+	}
+
+	int32 numOcean = 0;
+	for (int32 r = 0; r < mesh->NumRegions; r++)
+	{
+		if (r_ocean[r] != expected[r])
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d should%s have been ocean!"), r, expected[r] ? TEXT("") : TEXT("n't"));
+			return false;
+		}
+		numOcean += r_ocean[r] ? 1 : 0;
+	}
+	if (numOcean == mesh->NumRegions)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Island was all ocean!"));
+		return false;
+	}
+	return true;
+}
+
+bool FLakeTest::RunTest(const FString& Parameters)
+{
+	FTestIsland island;
+	if (island.Map == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not spawn an island!"));
+		return false;
+	}
+	island.Map->GenerateIsland();
+	UTriangleDualMesh* mesh = island.Map->Mesh;
+	const TArray<bool>& r_water = island.Map->GetWaterRegions();
+	const TArray<bool>& r_ocean = island.Map->GetOceanRegions();
+	const TArray<float>& r_elevation = island.Map->GetRegionElevations();
+	const TArray<int32>& r_lake_id = island.Map->GetRegionLakeIds();
+	const TArray<FIslandLake>& lakes = island.Map->GetLakes();
+
+	// Label each lake with a serial flood fill, then make sure both labellings split the regions up the same way
+	TArray<int32> expected;
+	expected.Init(INDEX_NONE, mesh->NumRegions);
+	TArray<int32> expectedToLake;
+	for (int32 r = 0; r < mesh->NumRegions; r++)
+	{
+		if (!r_water[r] || r_ocean[r] || expected[r] != INDEX_NONE)
+		{
+			continue;
+		}
+		const int32 label = expectedToLake.Add(r_lake_id[r]);
+		if (r_lake_id[r] == INDEX_NONE || expectedToLake.Find(r_lake_id[r]) != label)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d should have been in a lake of its own!"), r);
+			return false;
+		}
+
+		TArray<FPointIndex> stack = { r };
+		expected[r] = label;
+		int32 numRegions = 0;
+		float elevation = 0.0f;
+		while (stack.Num() > 0)
+		{
+			const FPointIndex r1 = stack.Pop();
+			if (r_lake_id[r1] != r_lake_id[r])
+			{
+				UE_LOG(LogMapGen, Error, TEXT("Regions %d and %d are in the same lake, but were given different lake IDs!"), r, (int32)r1);
+				return false;
+			}
+			numRegions++;
+			elevation += r_elevation[r1];
+			for (FPointIndex r2 : mesh->r_circulate_r(r1))
+			{
+				if (r_water[r2] && !r_ocean[r2] && expected[r2] == INDEX_NONE)
+				{
+					expected[r2] = label;
+					stack.Add(r2);
+				}
+			}
+		}
+
+		const FIslandLake& lake = lakes[r_lake_id[r]];
+		if (lake.Regions.Num() != numRegions)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Lake %d should have had %d regions, but it has %d!"), r_lake_id[r], numRegions, lake.Regions.Num());
+			return false;
+		}
+		if (!FMath::IsNearlyEqual(lake.SurfaceElevation, elevation / numRegions, 0.001f))
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Lake %d should have been at elevation %f, but it was at %f!"), r_lake_id[r], elevation / numRegions, lake.SurfaceElevation);
+			return false;
+		}
+	}
+
+	for (int32 r = 0; r < mesh->NumRegions; r++)
+	{
+		if (expected[r] == INDEX_NONE && r_lake_id[r] != INDEX_NONE)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d isn't a lake, but it has lake ID %d!"), r, r_lake_id[r]);
+			return false;
+		}
+	}
+	if (expectedToLake.Num() != lakes.Num())
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Island should have had %d lakes, but it had %d!"), expectedToLake.Num(), lakes.Num());
+		return false;
+	}
+
+	UE_LOG(LogMapGen, Display, TEXT("Checked %d lakes."), lakes.Num());
+	return true;
+}
+
+bool FDrainageTest::RunTest(const FString& Parameters)
+{
+	FTestIsland island;
+	if (island.Map == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not spawn an island!"));
+		return false;
+	}
+	// Pick rivers by flow, so the river heads get checked too
+	UIslandRivers* rivers = NewObject<UIslandRivers>(island.Map);
+	rivers->RiverFlowThreshold = 20;
+	island.Map->Rivers = rivers;
+	island.Map->GenerateIsland();
+
+	UTriangleDualMesh* mesh = island.Map->Mesh;
+	const TArray<bool>& r_water = island.Map->GetWaterRegions();
+	const TArray<bool>& r_ocean = island.Map->GetOceanRegions();
+	const TArray<FSideIndex>& t_downslope_s = island.Map->GetTriangleDownslopes();
+	const TArray<int32>& t_flow = island.Map->GetTriangleFlow();
+	const TArray<int32>& t_watershed = island.Map->GetTriangleWatersheds();
+	const int32 numTriangles = mesh->NumTriangles;
+
+	TArray<bool> t_ocean;
+	TArray<int32> t_downstream_t;
+	t_ocean.SetNumUninitialized(numTriangles);
+	t_downstream_t.SetNumUninitialized(numTriangles);
+	for (int32 t = 0; t < numTriangles; t++)
+	{
+		t_ocean[t] = IsTestTriangleOcean(mesh, r_ocean, t);
+		t_downstream_t[t] = t_downslope_s[t].IsValid() ? (int32)mesh->s_outer_t(t_downslope_s[t]) : INDEX_NONE;
+	}
+
+	// Walk every land triangle's rain down to the sea, one triangle at a time.
+	// Triangles which drain out to sea through the same triangle should share a watershed.
+	FDateTime startTime = FDateTime::UtcNow();
+	TArray<int32> expectedFlow;
+	expectedFlow.SetNumZeroed(numTriangles);
+	TArray<int32> t_outlet;
+	t_outlet.Init(INDEX_NONE, numTriangles);
+	for (int32 t = 0; t < numTriangles; t++)
+	{
+		if (t_ocean[t])
+		{
+			continue;
+		}
+		int32 current = t;
+		int32 steps = 0;
+		while (true)
+		{
+			expectedFlow[current]++;
+			const int32 next = t_downstream_t[current];
+			if (next == INDEX_NONE || t_ocean[next])
+			{
+				t_outlet[t] = next == INDEX_NONE ? current : next;
+				break;
+			}
+			if (++steps > numTriangles)
+			{
+				UE_LOG(LogMapGen, Error, TEXT("Triangle %d drains into a loop!"), t);
+				return false;
+			}
+			current = next;
+		}
+	}
+	FTimespan walkTime = FDateTime::UtcNow() - startTime;
+
+	TMap<int32, int32> outletWatersheds;
+	TMap<int32, int32> watershedOutlets;
+	for (int32 t = 0; t < numTriangles; t++)
+	{
+		if (t_flow[t] != expectedFlow[t])
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Triangle %d should have had a flow of %d, but it had %d!"), t, expectedFlow[t], t_flow[t]);
+			return false;
+		}
+		if (t_ocean[t])
+		{
+			if (t_watershed[t] != INDEX_NONE)
+			{
+				UE_LOG(LogMapGen, Error, TEXT("Ocean triangle %d was given watershed %d!"), t, t_watershed[t]);
+				return false;
+			}
+			continue;
+		}
+		if (!outletWatersheds.Contains(t_outlet[t]))
+		{
+			outletWatersheds.Add(t_outlet[t], t_watershed[t]);
+		}
+		if (!watershedOutlets.Contains(t_watershed[t]))
+		{
+			watershedOutlets.Add(t_watershed[t], t_outlet[t]);
+		}
+		if (outletWatersheds[t_outlet[t]] != t_watershed[t] || watershedOutlets[t_watershed[t]] != t_outlet[t] || t_watershed[t] == INDEX_NONE)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Triangle %d drains out through triangle %d, but it's in the wrong watershed!"), t, t_outlet[t]);
+			return false;
+		}
+	}
+
+	// A river starts at every river triangle that no other river triangle drains into
+	auto isRiverTriangle = [&](int32 t)
+	{
+		if (t >= mesh->NumSolidTriangles || expectedFlow[t] < rivers->RiverFlowThreshold)
+		{
+			return false;
+		}
+		for (FPointIndex r : mesh->t_circulate_r(t))
+		{
+			if (r_water[r])
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+	TArray<bool> t_fed;
+	t_fed.SetNumZeroed(numTriangles);
+	for (int32 t = 0; t < numTriangles; t++)
+	{
+		if (t_downstream_t[t] != INDEX_NONE && isRiverTriangle(t) && isRiverTriangle(t_downstream_t[t]))
+		{
+			t_fed[t_downstream_t[t]] = true;
+		}
+	}
+	TArray<FTriangleIndex> expectedHeads;
+	for (int32 t = 0; t < numTriangles; t++)
+	{
+		if (isRiverTriangle(t) && !t_fed[t])
+		{
+			expectedHeads.Add(t);
+		}
+	}
+	TArray<FTriangleIndex> heads = island.Map->GetSpringTriangles();
+	heads.Sort([](const FTriangleIndex& A, const FTriangleIndex& B) { return (int32)A < (int32)B; });
+	if (heads.Num() != expectedHeads.Num())
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Island should have had %d river heads, but it had %d!"), expectedHeads.Num(), heads.Num());
+		return false;
+	}
+	for (int32 i = 0; i < heads.Num(); i++)
+	{
+		if ((int32)heads[i] != (int32)expectedHeads[i])
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Triangle %d should have been a river head!"), (int32)expectedHeads[i]);
+			return false;
+		}
+	}
+
+	// Trace every river down to the coast the same way the original per-river tracing did
+	const TArray<FTriangleIndex>& river_t = island.Map->GetRiverTriangles();
+	TArray<int32> expectedSideFlow;
+	expectedSideFlow.SetNumZeroed(mesh->NumSides);
+	for (FTriangleIndex t : river_t)
+	{
+		TSet<int32> visited;
+		FSideIndex lastS = FSideIndex();
+		while (!visited.Contains(t))
+		{
+			FSideIndex s = t_downslope_s[t];
+			if (!s.IsValid())
+			{
+				s = mesh->s_opposite_s(lastS);
+				if (s.IsValid())
+				{
+					expectedSideFlow[s]++;
+				}
+				break;
+			}
+			expectedSideFlow[s]++;
+			visited.Add(t);
+			const FTriangleIndex next_t = mesh->s_outer_t(s);
+			if ((int32)next_t == (int32)t)
+			{
+				break;
+			}
+			t = next_t;
+			lastS = s;
+		}
+	}
+	const TArray<int32>& s_flow = island.Map->GetSideFlow();
+	for (int32 s = 0; s < mesh->NumSides; s++)
+	{
+		if (s_flow[s] != expectedSideFlow[s])
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Side %d should have had a flow of %d, but it had %d!"), s, expectedSideFlow[s], s_flow[s]);
+			return false;
+		}
+	}
+
+	// Time the one-pass accumulation against walking every triangle down to the sea
+	TArray<int32> timedFlow;
+	TArray<int32> timedWatersheds;
+	startTime = FDateTime::UtcNow();
+	rivers->assign_t_flow(timedFlow, timedWatersheds, mesh, t_downslope_s, r_ocean);
+	FTimespan accumulateTime = FDateTime::UtcNow() - startTime;
+
+	UE_LOG(LogMapGen, Display, TEXT("Checked flow for %d triangles, %d watersheds and %d rivers. Accumulating flow took %f ms, against %f ms walking each triangle."),
+		numTriangles, outletWatersheds.Num(), island.Map->GetNumRivers(), accumulateTime.GetTotalMilliseconds(), walkTime.GetTotalMilliseconds());
+	return true;
+}
+
+bool FBiomeTest::RunTest(const FString& Parameters)
+{
+	FTestIsland island;
+	if (island.Map == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not spawn an island!"));
+		return false;
+	}
+	island.Map->GenerateIsland();
+	const UIslandBiome* biomes = island.Map->Biomes;
+	if (!biomes->CanFuseAssignments())
+	{
+		UE_LOG(LogMapGen, Error, TEXT("The default biome assignments should have been fused!"));
+		return false;
+	}
+
+	// Run the three separate passes over the same inputs the fused pass had
+	UTriangleDualMesh* mesh = island.Map->Mesh;
+	const TArray<bool>& r_ocean = island.Map->GetOceanRegions();
+	const TArray<bool>& r_water = island.Map->GetWaterRegions();
+	const TArray<float>& r_elevation = island.Map->GetRegionElevations();
+	const TArray<float>& r_moisture = island.Map->GetRegionMoisture();
+	const FBiomeBias& bias = island.Map->BiomeBias;
+	TArray<bool> expectedCoast;
+	TArray<float> expectedTemperature;
+	TArray<FBiomeData> expectedBiome;
+	FDateTime startTime = FDateTime::UtcNow();
+	biomes->assign_r_coast(expectedCoast, mesh, r_ocean);
+	biomes->assign_r_temperature(expectedTemperature, mesh, r_ocean, r_water, r_elevation, r_moisture, bias.NorthernTemperature, bias.SouthernTemperature);
+	biomes->assign_r_biome(expectedBiome, mesh, r_ocean, r_water, expectedCoast, expectedTemperature, r_moisture);
+	FTimespan separateTime = FDateTime::UtcNow() - startTime;
+
+	const TArray<bool>& r_coast = island.Map->GetCoastalRegions();
+	const TArray<float>& r_temperature = island.Map->GetRegionTemperature();
+	const TArray<FBiomeData>& r_biome = island.Map->GetRegionBiomes();
+	if (r_coast.Num() != mesh->NumRegions || r_temperature.Num() != mesh->NumRegions || r_biome.Num() != mesh->NumRegions)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Fused biome pass didn't fill in every region!"));
+		return false;
+	}
+	for (int32 r = 0; r < mesh->NumRegions; r++)
+	{
+		if (r_coast[r] != expectedCoast[r])
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d should%s have been coast!"), r, expectedCoast[r] ? TEXT("") : TEXT("n't"));
+			return false;
+		}
+		if (!FMath::IsNearlyEqual(r_temperature[r], expectedTemperature[r], 0.0001f))
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d should have had a temperature of %f, but it had %f!"), r, expectedTemperature[r], r_temperature[r]);
+			return false;
+		}
+		if (r_biome[r].Tag != expectedBiome[r].Tag)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d should have been %s, but it was %s!"), r, *expectedBiome[r].Tag.ToString(), *r_biome[r].Tag.ToString());
+			return false;
+		}
+	}
+
+	// The fused pass reuses the buffers it already has
+	startTime = FDateTime::UtcNow();
+	TArray<bool> fusedCoast = r_coast;
+	TArray<float> fusedTemperature = r_temperature;
+	TArray<FBiomeData> fusedBiome = r_biome;
+	biomes->assign_r_coast_temperature_biome(fusedCoast, fusedTemperature, fusedBiome, mesh, r_ocean, r_water, r_elevation, r_moisture, bias.NorthernTemperature, bias.SouthernTemperature);
+	FTimespan fusedTime = FDateTime::UtcNow() - startTime;
+
+	UE_LOG(LogMapGen, Display, TEXT("Assigned biomes to %d regions in %f ms fused, against %f ms in separate passes."), mesh->NumRegions, fusedTime.GetTotalMilliseconds(), separateTime.GetTotalMilliseconds());
+	return true;
+}
+
+bool FNavigationTest::RunTest(const FString& Parameters)
+{
+	FTestIsland island;
+	if (island.Map == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not spawn an island!"));
+		return false;
+	}
+	island.Map->GenerateIsland();
+	TSharedPtr<const FIslandNavigationGraph, ESPMode::ThreadSafe> graph = island.Map->GetNavigationGraph();
+	if (!graph.IsValid())
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Island didn't build a navigation graph!"));
+		return false;
+	}
+
+	const TArray<bool>& r_water = island.Map->GetWaterRegions();
+	TArray<int32> land_r;
+	for (int32 r = 0; r < island.Map->Mesh->NumSolidRegions; r++)
+	{
+		if (!r_water[r])
+		{
+			land_r.Add(r);
+		}
+	}
+	if (land_r.Num() < 2)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Island didn't have any land to walk across!"));
+		return false;
+	}
+
+	// Anything the plain search can reach, the clusters should reach too, and not by too much of a detour
+	FRandomStream rng(0);
+	FTimespan clusteredTime = FTimespan::Zero();
+	FTimespan flatTime = FTimespan::Zero();
+	int32 numPaths = 0;
+	TArray<FPointIndex> clusteredPath;
+	TArray<FPointIndex> flatPath;
+	for (int32 i = 0; i < 50; i++)
+	{
+		const FPointIndex start = land_r[rng.RandRange(0, land_r.Num() - 1)];
+		const FPointIndex goal = land_r[rng.RandRange(0, land_r.Num() - 1)];
+
+		FDateTime startTime = FDateTime::UtcNow();
+		const bool bFoundClustered = graph->FindPath(start, goal, clusteredPath);
+		clusteredTime += FDateTime::UtcNow() - startTime;
+		startTime = FDateTime::UtcNow();
+		const bool bFoundFlat = graph->FindFlatPath(start, goal, flatPath);
+		flatTime += FDateTime::UtcNow() - startTime;
+
+		if (!bFoundFlat)
+		{
+			continue;
+		}
+		if (!bFoundClustered)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Found a path from region %d to region %d without clusters, but not with them!"), (int32)start, (int32)goal);
+			return false;
+		}
+		if ((int32)clusteredPath[0] != (int32)start || (int32)clusteredPath.Last() != (int32)goal)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Path from region %d to region %d doesn't start and end in the right places!"), (int32)start, (int32)goal);
+			return false;
+		}
+		const float clusteredCost = graph->GetPathCost(clusteredPath);
+		const float flatCost = graph->GetPathCost(flatPath);
+		if (clusteredCost > flatCost * MAX_CLUSTERED_PATH_COST_RATIO + KINDA_SMALL_NUMBER)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Path from region %d to region %d cost %f through the clusters, but only %f without them!"), (int32)start, (int32)goal, clusteredCost, flatCost);
+			return false;
+		}
+		numPaths++;
+	}
+
+	UE_LOG(LogMapGen, Display, TEXT("Found %d paths in %f ms through %d clusters, against %f ms without clusters."), numPaths, clusteredTime.GetTotalMilliseconds(), graph->GetNumClusters(), flatTime.GetTotalMilliseconds());
+	return true;
+}
+
+bool FSnapshotTest::RunTest(const FString& Parameters)
+{
+	FTestIsland island;
+	if (island.Map == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not spawn an island!"));
+		return false;
+	}
+	island.Map->GenerateIsland();
+	TArray<uint8> bytes;
+	if (!island.Map->SaveSnapshotToBytes(bytes))
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not save a snapshot!"));
+		return false;
+	}
+
+	AIslandMap* loaded = island.SpawnMap();
+	if (loaded == NULL || !loaded->LoadSnapshotFromBytes(bytes))
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Could not load a snapshot back in!"));
+		return false;
+	}
+	const uint64 checksum = loaded->ComputeChecksum();
+	if (checksum != island.Map->ComputeChecksum())
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Loaded island doesn't match the island it was saved from!"));
+		return false;
+	}
+	const TArray<float>& r_moisture = island.Map->GetRegionMoisture();
+	const TArray<FBiomeData>& r_biome = island.Map->GetRegionBiomes();
+	for (int32 r = 0; r < island.Map->Mesh->NumRegions; r++)
+	{
+		if (loaded->GetRegionMoisture()[r] != r_moisture[r] || loaded->GetRegionBiomes()[r].Tag != r_biome[r].Tag)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Region %d didn't load back in the same as it was saved!"), r);
+			return false;
+		}
+	}
+	if (loaded->GetNumRivers() != island.Map->GetNumRivers() || loaded->GetNumLakes() != island.Map->GetNumLakes())
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Loaded island has %d rivers and %d lakes, but it should have %d rivers and %d lakes!"),
+			loaded->GetNumRivers(), loaded->GetNumLakes(), island.Map->GetNumRivers(), island.Map->GetNumLakes());
+		return false;
+	}
+
+	// None of these should load, and none of them should touch the island that's already there
+	UTriangleDualMesh* loadedMesh = loaded->Mesh;
+	auto expectRejected = [&](const TArray<uint8>& BadBytes, const TCHAR* Description)
+	{
+		if (loaded->LoadSnapshotFromBytes(BadBytes))
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Loaded a snapshot with %s!"), Description);
+			return false;
+		}
+		if (loaded->Mesh != loadedMesh || loaded->ComputeChecksum() != checksum)
+		{
+			UE_LOG(LogMapGen, Error, TEXT("Rejecting a snapshot with %s changed the island!"), Description);
+			return false;
+		}
+		return true;
+	};
+
+	TArray<uint8> truncated = bytes;
+	truncated.SetNum(bytes.Num() / 2);
+	if (!expectRejected(truncated, TEXT("half of it missing")))
+	{
+		return false;
+	}
+
+	// Sections are padded out to 16 bytes, so flip enough bytes that some of them are sure to be inside a section
+	TArray<uint8> corrupted = bytes;
+	for (int32 i = bytes.Num() / 2; i < bytes.Num() / 2 + 64 && i < bytes.Num(); i++)
+	{
+		corrupted[i] ^= 0xA5;
+	}
+	if (!expectRejected(corrupted, TEXT("corrupted bytes")))
+	{
+		return false;
+	}
+
+	// Indices which are encoded perfectly well, but point outside the mesh
+	TArray<uint8> outOfRange;
+	TArray<FSideIndex>& t_downslope_s = island.Map->GetTriangleDownslopes();
+	const FSideIndex downslope = t_downslope_s[0];
+	t_downslope_s[0] = FSideIndex(island.Map->Mesh->NumSides + 10);
+	island.Map->SaveSnapshotToBytes(outOfRange);
+	t_downslope_s[0] = downslope;
+	if (!expectRejected(outOfRange, TEXT("a downslope side outside the mesh")))
+	{
+		return false;
+	}
+
+	TArray<FTriangleIndex>& river_t = island.Map->GetRiverTriangles();
+	river_t.Add(FTriangleIndex(island.Map->Mesh->NumTriangles));
+	island.Map->SaveSnapshotToBytes(outOfRange);
+	river_t.Pop();
+	if (!expectRejected(outOfRange, TEXT("a river triangle outside the mesh")))
+	{
+		return false;
+	}
+
+	UE_LOG(LogMapGen, Display, TEXT("Snapshot of %d regions was %d bytes."), island.Map->Mesh->NumRegions, bytes.Num());
 	return true;
-}
\ No newline at end of file
+}
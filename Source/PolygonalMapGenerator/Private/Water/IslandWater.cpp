@@ -18,11 +18,56 @@
 
 #include "Water/IslandWater.h"
 #include "RandomSampling/SimplexNoise.h"
+#include "DualMeshParallel.h"
+#include "HAL/PlatformAtomics.h"
+
+namespace
+{
+	// Finds the root of Node's set, halving the path on the way up.
+	// Roots are always the lowest index in their set, so parents only ever move down.
+	int32 FindLakeRoot(TArray<int32>& Parents, int32 Node)
+	{
+		int32 parent = FPlatformAtomics::AtomicRead(&Parents[Node]);
+		while (parent != Node)
+		{
+			const int32 grandparent = FPlatformAtomics::AtomicRead(&Parents[parent]);
+			// If someone else already moved this link, that's fine; it still points at an ancestor
+			FPlatformAtomics::InterlockedCompareExchange(&Parents[Node], grandparent, parent);
+			Node = parent;
+			parent = grandparent;
+		}
+		return Node;
+	}
+
+	// Joins the sets containing A and B, without any locks.
+	void UnionLakes(TArray<int32>& Parents, int32 A, int32 B)
+	{
+		while (true)
+		{
+			A = FindLakeRoot(Parents, A);
+			B = FindLakeRoot(Parents, B);
+			if (A == B)
+			{
+				return;
+			}
+			if (A < B)
+			{
+				Swap(A, B);
+			}
+			// Hang the higher root under the lower one, as long as it's still a root
+			if (FPlatformAtomics::InterlockedCompareExchange(&Parents[A], B, A) == A)
+			{
+				return;
+			}
+		}
+	}
+}
 
 UIslandWater::UIslandWater()
 {
 	WaterCutoff = 0.0f;
 	bInvertLandAndWater = false;
+	bFlattenLakes = false;
 }
 
 void UIslandWater::AssignOcean_Implementation(TArray<bool>& r_ocean, UTriangleDualMesh* Mesh, const TArray<bool>& r_water) const
@@ -30,39 +75,78 @@ void UIslandWater::AssignOcean_Implementation(TArray<bool>& r_ocean, UTriangleDu
 	/* A region is ocean if it is a water region connected to the ghost region,
 	which is outside the boundary of the map; this could be any seed set but
 	for islands, the ghost region is a good seed */
+	Mesh->ClearTriangleWaterCache();
 	r_ocean.Empty(Mesh->NumRegions);
 	r_ocean.SetNumZeroed(Mesh->NumRegions);
-	TArray<FPointIndex> stack = { Mesh->ghost_r() };
-	r_ocean[stack[0]] = true;
 
-	while (stack.Num() > 0)
+	// Fill outwards one ring at a time, so each ring can be split across threads.
+	// Regions are claimed by setting their bit in visited, so only one thread ever adds a region.
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	const TArray<FPointIndex>& s_start_r = Mesh->GetRawMesh().DelaunayTriangles;
+	TArray<int32> visited;
+	visited.SetNumZeroed(FMath::DivideAndRoundUp(Mesh->NumRegions, 32));
+	auto claimRegion = [&visited](int32 r)
 	{
-		FPointIndex r1 = stack.Pop();
-		check(r1.IsValid());
-		TArray<FPointIndex> r_out = Mesh->r_circulate_r(r1);
-		for (FPointIndex r2 : r_out)
+		volatile int32* word = &visited[r / 32];
+		const int32 bit = (int32)(1u << (r % 32));
+		int32 oldWord = FPlatformAtomics::AtomicRead(word);
+		while ((oldWord & bit) == 0)
 		{
-			if (!r2.IsValid())
-			{
-				continue;
-			}
-			if (r_water[r2] && !r_ocean[r2])
+			const int32 seenWord = FPlatformAtomics::InterlockedCompareExchange(word, oldWord | bit, oldWord);
+			if (seenWord == oldWord)
 			{
-				r_ocean[r2] = true;
-				stack.Add(r2);
+				return true;
 			}
+			oldWord = seenWord;
 		}
-	}
+		return false;
+	};
 
-#if !UE_BUILD_SHIPPING
-	int32 oceanTileCount = 0;
-	for (int i = 0; i < r_ocean.Num(); i++)
+	const int32 batchSize = FDualMeshParallel::GetMinBatchSize();
+	TArray<int32> frontier = { (int32)Mesh->ghost_r() };
+	TArray<TArray<int32>> chunkFrontiers;
+	claimRegion(frontier[0]);
+	r_ocean[frontier[0]] = true;
+	int32 oceanTileCount = 1;
+
+	while (frontier.Num() > 0)
 	{
-		if (r_ocean[i])
+		const int32 numChunks = FMath::DivideAndRoundUp(frontier.Num(), batchSize);
+		if (chunkFrontiers.Num() < numChunks)
 		{
-			oceanTileCount++;
+			chunkFrontiers.SetNum(numChunks);
 		}
+
+		FDualMeshParallel::ForEachChunk(frontier.Num(), [&](int32 Start, int32 End)
+		{
+			TArray<int32>& next = chunkFrontiers[Start / batchSize];
+			next.Reset();
+			for (int32 i = Start; i < End; i++)
+			{
+				const int32 r1 = frontier[i];
+				for (int32 j = r_side_offsets[r1]; j < r_side_offsets[r1 + 1]; j++)
+				{
+					const int32 r2 = s_start_r[UTriangleDualMesh::s_next_s(r_sides[j])];
+					if (r_water[r2] && claimRegion(r2))
+					{
+						r_ocean[r2] = true;
+						next.Add(r2);
+					}
+				}
+			}
+		}, batchSize);
+
+		// Gather the next ring in chunk order, so the fill visits regions in the same order every time
+		frontier.Reset();
+		for (int32 chunk = 0; chunk < numChunks; chunk++)
+		{
+			frontier.Append(chunkFrontiers[chunk]);
+		}
+		oceanTileCount += frontier.Num();
 	}
+
+#if !UE_BUILD_SHIPPING
 	if (oceanTileCount == 0)
 	{
 		UE_LOG(LogMapGen, Error, TEXT("Did not generate any ocean tiles!"));
@@ -74,6 +158,145 @@ void UIslandWater::AssignOcean_Implementation(TArray<bool>& r_ocean, UTriangleDu
 #endif
 }
 
+void UIslandWater::AssignLakes_Implementation(TArray<int32>& r_lake_id, TArray<FIslandLake>& Lakes, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<bool>& r_ocean) const
+{
+	Lakes.Empty();
+	if (Mesh == NULL)
+	{
+		UE_LOG(LogMapGen, Error, TEXT("Mesh was invalid!"));
+		return;
+	}
+
+	const int32 numRegions = Mesh->NumRegions;
+	r_lake_id.Empty(numRegions);
+	r_lake_id.Init(INDEX_NONE, numRegions);
+	auto isLake = [&](int32 r)
+	{
+		return r_water[r] && !r_ocean[r];
+	};
+
+	// Every lake region starts in its own set, then each side between two lake regions joins their sets
+	TArray<int32> parents;
+	parents.SetNumUninitialized(numRegions);
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
+	{
+		parents[r] = r;
+	});
+	const TArray<FPointIndex>& s_start_r = Mesh->GetRawMesh().DelaunayTriangles;
+	FDualMeshParallel::ForEach(Mesh->NumSolidSides, [&](int32 s)
+	{
+		const int32 r0 = s_start_r[s];
+		const int32 r1 = s_start_r[UTriangleDualMesh::s_next_s(s)];
+		// Each pair of regions shows up on two sides, so only look at one of them
+		if (r0 < r1 && isLake(r0) && isLake(r1))
+		{
+			UnionLakes(parents, r0, r1);
+		}
+	});
+
+	// Number the lakes by their roots, which are their lowest regions
+	TArray<int32> rootLake;
+	rootLake.Init(INDEX_NONE, numRegions);
+	for (int32 r = 0; r < numRegions; r++)
+	{
+		if (isLake(r) && parents[r] == r)
+		{
+			rootLake[r] = Lakes.AddDefaulted();
+		}
+	}
+	if (Lakes.Num() == 0)
+	{
+		return;
+	}
+	FDualMeshParallel::ForEach(numRegions, [&](int32 r)
+	{
+		if (isLake(r))
+		{
+			r_lake_id[r] = rootLake[FindLakeRoot(parents, r)];
+		}
+	});
+
+	for (int32 r = 0; r < numRegions; r++)
+	{
+		if (r_lake_id[r] != INDEX_NONE)
+		{
+			Lakes[r_lake_id[r]].Regions.Add(r);
+		}
+	}
+
+	// Lakes don't share any regions, so each one can be measured on its own thread
+	const TArray<int32>& r_side_offsets = Mesh->GetRegionSideOffsets();
+	const TArray<int32>& r_sides = Mesh->GetRegionSides();
+	FDualMeshParallel::ForEach(Lakes.Num(), [&](int32 lake)
+	{
+		FIslandLake& lakeData = Lakes[lake];
+		TArray<FTriangleIndex> out_t;
+		for (FPointIndex r : lakeData.Regions)
+		{
+			// The area of the Voronoi cell, whose corners are the centroids of the triangles around r
+			out_t = Mesh->r_circulate_t(r);
+			float area = 0.0f;
+			for (int32 i = 0; i < out_t.Num(); i++)
+			{
+				const FVector2D a = Mesh->t_pos(out_t[i]);
+				const FVector2D b = Mesh->t_pos(out_t[(i + 1) % out_t.Num()]);
+				area += a ^ b;
+			}
+			lakeData.Area += FMath::Abs(area) * 0.5f;
+
+			for (int32 i = r_side_offsets[r]; i < r_side_offsets[r + 1]; i++)
+			{
+				const int32 neighbor_r = s_start_r[UTriangleDualMesh::s_next_s(r_sides[i])];
+				if (r_lake_id[neighbor_r] != lake && !Mesh->r_ghost(neighbor_r))
+				{
+					lakeData.ShoreRegions.Add(neighbor_r);
+				}
+			}
+		}
+
+		// Most shore regions touch the lake more than once, so sort and drop the duplicates
+		lakeData.ShoreRegions.Sort();
+		int32 numShores = 0;
+		for (int32 i = 0; i < lakeData.ShoreRegions.Num(); i++)
+		{
+			if (numShores == 0 || lakeData.ShoreRegions[numShores - 1] != lakeData.ShoreRegions[i])
+			{
+				lakeData.ShoreRegions[numShores++] = lakeData.ShoreRegions[i];
+			}
+		}
+		lakeData.ShoreRegions.SetNum(numShores, false);
+	}, 1);
+
+#if !UE_BUILD_SHIPPING
+	UE_LOG(LogMapGen, Log, TEXT("Found %d lakes."), Lakes.Num());
+#endif
+}
+
+void UIslandWater::AssignLakeElevations(TArray<FIslandLake>& Lakes, TArray<float>& r_elevation) const
+{
+	for (FIslandLake& lake : Lakes)
+	{
+		if (lake.Regions.Num() == 0)
+		{
+			continue;
+		}
+		float elevation = 0.0f;
+		for (FPointIndex r : lake.Regions)
+		{
+			elevation += r_elevation[r];
+		}
+		lake.SurfaceElevation = elevation / lake.Regions.Num();
+
+		if (bFlattenLakes)
+		{
+			for (FPointIndex r : lake.Regions)
+			{
+				r_elevation[r] = lake.SurfaceElevation;
+			}
+		}
+	}
+}
+
 void UIslandWater::AssignWater_Implementation(TArray<bool>& r_water, FRandomStream& Rng, UTriangleDualMesh* Mesh, const FIslandShape& Shape) const
 {
 	if (Mesh)
@@ -81,6 +304,7 @@ void UIslandWater::AssignWater_Implementation(TArray<bool>& r_water, FRandomStre
 #if !UE_BUILD_SHIPPING
 		int32 count = 0;
 #endif
+		Mesh->ClearTriangleWaterCache();
 		/* A region is water if the noise value is low */
 		r_water.Empty(Mesh->NumRegions);
 		r_water.SetNumZeroed(Mesh->NumRegions);
@@ -133,10 +357,24 @@ bool UIslandWater::IsPointLand_Implementation(FPointIndex Point, UTriangleDualMe
 
 void UIslandWater::assign_r_water(TArray<bool>& r_water, FRandomStream& Rng, UTriangleDualMesh* Mesh, const FIslandShape& Shape) const
 {
+	// Blueprint overrides won't clear the triangle water cache themselves
+	if (Mesh != NULL)
+	{
+		Mesh->ClearTriangleWaterCache();
+	}
 	AssignWater(r_water, Rng, Mesh, Shape);
 }
 
 void UIslandWater::assign_r_ocean(TArray<bool>& r_ocean, UTriangleDualMesh* Mesh, const TArray<bool>& r_water) const
 {
+	if (Mesh != NULL)
+	{
+		Mesh->ClearTriangleWaterCache();
+	}
 	AssignOcean(r_ocean, Mesh, r_water);
 }
+
+void UIslandWater::assign_r_lake(TArray<int32>& r_lake_id, TArray<FIslandLake>& Lakes, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<bool>& r_ocean) const
+{
+	AssignLakes(r_lake_id, Lakes, Mesh, r_water, r_ocean);
+}
@@ -57,4 +57,17 @@ public:
 	void assign_r_coast(TArray<bool>& r_coast, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const;
 	void assign_r_temperature(TArray<float>& r_temperature, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<float>& r_elevation, const TArray<float>& r_moisture, float NorthernTemperature, float SouthernTemperature) const;
 	void assign_r_biome(TArray<FBiomeData>& r_biome, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<bool>& r_coast, const TArray<float>& r_temperature, const TArray<float>& r_moisture) const;
+
+	/**
+	* Assigns coast, temperature, and biome for every region.
+	* If none of AssignCoast, AssignTemperature, or AssignBiome have been overridden,
+	* all three are computed together in a single pass over the regions.
+	* Otherwise, this just calls them one after another.
+	*/
+	void assign_r_coast_temperature_biome(TArray<bool>& r_coast, TArray<float>& r_temperature, TArray<FBiomeData>& r_biome, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<float>& r_elevation, const TArray<float>& r_moisture, float NorthernTemperature, float SouthernTemperature) const;
+	// Whether assign_r_coast_temperature_biome can skip the BlueprintNativeEvents and use the fused pass.
+	bool CanFuseAssignments() const;
+
+private:
+	void AssignFused(TArray<bool>& r_coast, TArray<float>& r_temperature, TArray<FBiomeData>& r_biome, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, const TArray<float>& r_elevation, const TArray<float>& r_moisture, float NorthernTemperature, float SouthernTemperature) const;
 };
@@ -35,6 +35,15 @@ class POLYGONALMAPGENERATOR_API UIslandElevation : public UDataAsset
 {
 	GENERATED_BODY()
 
+public:
+	// Measure distance from the coast in world units along the mesh, instead of counting triangles.
+	// Hop counts depend on how densely points were placed, which shows up as artifacts on adaptive meshes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Distance")
+	bool bUseGeometricDistances;
+
+public:
+	UIslandElevation();
+
 protected:
 	/**
 	* Coast corners are connected to coast sides, which have
@@ -45,6 +54,9 @@ protected:
 
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Elevation")
 	virtual bool IsTriangleOcean(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const;
+	// Uses the mesh's triangle water cache if it has one, otherwise falls back to IsTriangleOcean.
+	// Only for the generation passes, where the cache was built from r_ocean; the cache doesn't look at r_ocean.
+	bool IsTriangleOceanCached(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const;
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Elevation")
 	virtual bool IsRegionLake(FPointIndex r, const TArray<bool>& r_water, const TArray<bool>& r_ocean) const;
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Elevation")
@@ -52,6 +64,9 @@ protected:
 
 	virtual void DistributeElevations(TArray<float> &t_elevation, UTriangleDualMesh* Mesh, const TArray<int32> &t_coastdistance, const TArray<bool>& r_ocean, int32 MinDistance, int32 MaxDistance) const;
 	virtual void UpdateCoastDistance(TArray<int32> &t_coastdistance, UTriangleDualMesh* Mesh, FTriangleIndex Triangle, int32 Distance) const;
+	// Assigns elevations from Euclidean distances to the coast. Lakes are free to cross, so they stay flat.
+	// t_coastdistance is filled with the distance in mean edge lengths, so it reads like a hop count.
+	virtual void AssignGeometricTriangleElevations(TArray<float>& t_elevation, TArray<int32>& t_coastdistance, TArray<FSideIndex>& t_downslope_s, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const;
 
 	virtual void AssignTriangleElevations_Implementation(TArray<float>& t_elevation, TArray<int32>& t_coastdistance, TArray<FSideIndex>& t_downslope_s, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water, FRandomStream& DrainageRng) const;
 	virtual void RedistributeTriangleElevations_Implementation(TArray<float>& t_elevation, UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean) const;
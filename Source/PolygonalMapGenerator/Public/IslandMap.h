@@ -21,6 +21,7 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "GameplayTagContainer.h"
+#include "Async/Future.h"
 
 #include "DualMesh/Public/RandomSampling/SimplexNoise.h"
 #include "DualMesh/Public/TriangleDualMesh.h"
@@ -32,16 +33,107 @@
 #include "Moisture/IslandMoisture.h"
 #include "Rivers/IslandRivers.h"
 #include "Water/IslandWater.h"
+#include "Navigation/IslandNavigationGraph.h"
 
 #include "IslandMap.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnIslandGenerationComplete);
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnIslandPathFound, const TArray<FPointIndex>&, Path);
+
+// The region attributes at a point on the map, blended between the corners of the triangle it's in.
+USTRUCT(BlueprintType)
+struct POLYGONALMAPGENERATOR_API FIslandAttributeSample
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
+	float Elevation;
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
+	float Moisture;
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
+	float Temperature;
+
+public:
+	FIslandAttributeSample()
+	{
+		Elevation = 0.0f;
+		Moisture = 0.0f;
+		Temperature = 0.0f;
+	}
+};
+
+/**
+* Everything needed to generate an island, small enough to send over the network.
+* Clients regenerate the island from this, then check their island against the server's checksum.
+*/
+USTRUCT(BlueprintType)
+struct POLYGONALMAPGENERATOR_API FIslandDescriptor
+{
+	GENERATED_BODY()
+public:
+	// The generator version the server is running.
+	// Clients on a different version can't expect to generate the same island.
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Version")
+	int32 GeneratorVersion;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "RNG")
+	int32 Seed;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "RNG")
+	int32 DrainageSeed;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "RNG")
+	int32 RiverSeed;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Map")
+	FBiomeBias BiomeBias;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Map")
+	FIslandShape Shape;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Map")
+	int32 NumRivers;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Map")
+	float Smoothing;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Assets")
+	const UIslandMeshBuilder* PointGenerator;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Assets")
+	const UIslandBiome* Biomes;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Assets")
+	const UIslandElevation* Elevation;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Assets")
+	const UIslandMoisture* Moisture;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Assets")
+	const UIslandRivers* Rivers;
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Assets")
+	const UIslandWater* Water;
+
+	// The result of AIslandMap::ComputeChecksum() on the server.
+	UPROPERTY()
+	uint64 Checksum;
+
+public:
+	FIslandDescriptor()
+	{
+		GeneratorVersion = 0;
+		Seed = 0;
+		DrainageSeed = 0;
+		RiverSeed = 0;
+		NumRivers = 0;
+		Smoothing = 0.0f;
+		PointGenerator = NULL;
+		Biomes = NULL;
+		Elevation = NULL;
+		Moisture = NULL;
+		Rivers = NULL;
+		Water = NULL;
+		Checksum = 0;
+	}
+};
 
 UCLASS()
 class POLYGONALMAPGENERATOR_API AIslandMap : public AActor
 {
 	GENERATED_BODY()
 	friend class UIslandMapUtils;
+	friend struct FIslandMapSnapshot;
 
 #if !UE_BUILD_SHIPPING
 private:
@@ -57,6 +149,11 @@ protected:
 	TArray<bool> r_coast;
 	UPROPERTY()
 	TArray<float> r_elevation;
+	// The index of the lake each region belongs to, or -1.
+	UPROPERTY()
+	TArray<int32> r_lake_id;
+	UPROPERTY()
+	TArray<FIslandLake> Lakes;
 	UPROPERTY()
 	TArray<int32> r_waterdistance;
 	UPROPERTY()
@@ -74,10 +171,37 @@ protected:
 	TArray<FSideIndex> t_downslope_s;
 	UPROPERTY()
 	TArray<int32> s_flow;
+	// How many land triangles drain through each triangle, and which watershed each belongs to.
+	// Both are rebuilt from t_downslope_s, so they aren't saved in snapshots.
+	UPROPERTY()
+	TArray<int32> t_flow;
+	UPROPERTY()
+	TArray<int32> t_watershed;
 	UPROPERTY()
 	TArray<FTriangleIndex> spring_t;
 	UPROPERTY()
 	TArray<FTriangleIndex> river_t;
+	// One bit per triangle, set if it's in spring_t or river_t.
+	// Rebuilt whenever the island is generated or loaded.
+	TBitArray<> t_spring;
+	TBitArray<> t_river;
+
+	// Filled in on the server whenever the island is generated, and replicated to clients
+	// so they can generate the same island without any map data being sent.
+	UPROPERTY(ReplicatedUsing = OnRep_Descriptor, VisibleInstanceOnly, Category = "Network")
+	FIslandDescriptor Descriptor;
+
+	// Copies of each river made for Blueprints, only filled in once GetRivers is called.
+	UPROPERTY(Transient)
+	TArray<URiver*> RiverViews;
+
+	// Elevation, moisture and temperature packed together for every region, so a sample
+	// can blend all three at once. Rebuilt whenever the island is generated or loaded.
+	TArray<FVector4> r_sample_attributes;
+
+	// Built after generation if bBuildNavigation is set.
+	// Shared with any path searches still running, so it can outlive a regeneration.
+	TSharedPtr<const FIslandNavigationGraph, ESPMode::ThreadSafe> NavigationGraph;
 
 	// Note -- will be compiled when GetVoronoiPolygons is first called.
 	// This will take a long time to compile and use a lot of memory. Use with caution!
@@ -109,6 +233,12 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Map", meta = (ClampMin = "-1.0", ClampMax = "1.0"))
 	float Smoothing;
 
+	// Whether to build a pathfinding graph once the island is generated.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Navigation")
+	bool bBuildNavigation;
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Navigation")
+	FIslandNavigationSettings NavigationSettings;
+
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, Category = "Map")
 	float Persistence;
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, Category = "Mesh")
@@ -133,8 +263,8 @@ public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Map")
 	const UIslandWater* Water;
 
-	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, Category = "Map")
-	TArray<URiver*> CreatedRivers;
+	UPROPERTY(VisibleInstanceOnly, Category = "Map")
+	FIslandRiverNetwork RiverNetwork;
 
 
 	UPROPERTY(BlueprintAssignable)
@@ -152,9 +282,15 @@ public:
 	UPROPERTY(BlueprintAssignable)
 	FOnIslandGenerationComplete OnIslandGenerationComplete;
 
+public:
+	// Bump this whenever a change to generation would create a different island from the same descriptor.
+	static const int32 GeneratorVersion;
+
 public:	
 	AIslandMap();
 
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 protected:
 	//virtual void OnConstruction(const FTransform& NewTransform) override;
 	virtual void BeginPlay() override;
@@ -182,6 +318,27 @@ protected:
 	void OnIslandGenComplete();
 	virtual void OnIslandGenComplete_Implementation();
 
+	UFUNCTION()
+	void OnRep_Descriptor();
+	// Called on clients if the island they generated doesn't match the server's.
+	// By default this just logs an error. Games can override this to have the server send a
+	// snapshot over (see SaveSnapshotToBytes) and pass it to LoadSnapshotFromBytes.
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Network")
+	void OnChecksumMismatch();
+	virtual void OnChecksumMismatch_Implementation();
+
+private:
+	void BroadcastGenerationComplete();
+	void CacheSampleAttributes();
+	void BuildNavigationGraph();
+	void AccumulateFlow();
+	void CacheRiverFlags();
+	// Rebuilds everything which isn't stored in snapshots.
+	void CacheDerivedData();
+	// Blends the attributes of the triangle containing Position.
+	// InOutTriangle is used as a starting point for the search, and is set to the triangle found.
+	VectorRegister BlendAttributesAt(const FVector2D& Position, FTriangleIndex& InOutTriangle) const;
+
 public:
 	// Creates the island using all the current parameters.
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation")
@@ -193,6 +350,64 @@ public:
 	UFUNCTION()
 	TArray<FIslandPolygon>& GetVoronoiPolygons();
 
+	// Saves everything generated for this island to a file, which can be loaded back instead of regenerating.
+	// Quantizing floats makes the file smaller, at the cost of some precision in elevation, moisture and temperature.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Snapshot")
+	bool SaveSnapshot(const FString& Path, bool bQuantizeFloats = false) const;
+	// Loads a file written by SaveSnapshot in place of calling GenerateIsland.
+	// All the generation complete events are fired once it's done, just as if the island had been generated.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Snapshot")
+	bool LoadSnapshot(const FString& Path);
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Snapshot")
+	bool SaveSnapshotToBytes(TArray<uint8>& OutBytes, bool bQuantizeFloats = false) const;
+	// Loads bytes written by SaveSnapshotToBytes in place of calling GenerateIsland.
+	// Every size and index is checked before anything is replaced, so this is safe to use on bytes from the network.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Snapshot")
+	bool LoadSnapshotFromBytes(const TArray<uint8>& Bytes);
+
+	// A 64-bit hash of the mesh, water, drainage and rivers of the generated island.
+	// Anything that changes the island's shape will change this.
+	uint64 ComputeChecksum() const;
+
+	// Finds the region closest to a position on the map.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Location")
+	FPointIndex FindRegionAt(const FVector2D& Position) const;
+	// Finds the triangle containing a position on the map, or an invalid triangle if the position is off the map.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Location")
+	FTriangleIndex FindTriangleAt(const FVector2D& Position) const;
+	// Finds the closest region to every position, spreading the work across threads.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Location")
+	void FindRegionsAt(const TArray<FVector2D>& Positions, TArray<FPointIndex>& OutRegions) const;
+
+	// Smoothly interpolated elevation at a position on the map.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Location")
+	float SampleElevation(const FVector2D& Position) const;
+	// Smoothly interpolated moisture at a position on the map.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Location")
+	float SampleMoisture(const FVector2D& Position) const;
+	// Smoothly interpolated temperature at a position on the map.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Location")
+	float SampleTemperature(const FVector2D& Position) const;
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Location")
+	FIslandAttributeSample SampleAttributesAt(const FVector2D& Position) const;
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Location")
+	void SampleAttributesBatch(const TArray<FVector2D>& Positions, TArray<FIslandAttributeSample>& OutSamples) const;
+	// Finds a cheap walking path between two regions. The path includes both the start and goal.
+	// Returns false if there's no path, or bBuildNavigation is off.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Navigation")
+	bool FindPath(FPointIndex Start, FPointIndex Goal, TArray<FPointIndex>& OutPath) const;
+	// Finds a path on a worker thread, and calls OnPathFound on the game thread once it's done.
+	// The path is empty if there's no path.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Navigation")
+	void RequestPath(FPointIndex Start, FPointIndex Goal, FOnIslandPathFound OnPathFound) const;
+	// Finds a path on a worker thread.
+	TFuture<TArray<FPointIndex>> FindPathAsync(FPointIndex Start, FPointIndex Goal) const;
+	TSharedPtr<const FIslandNavigationGraph, ESPMode::ThreadSafe> GetNavigationGraph() const;
+
+	// Samples a batch of positions across multiple threads.
+	// Each thread walks from its last hit, so keep positions which are near each other next to each other.
+	void SampleAttributes(TArrayView<const FVector2D> Positions, TArray<FIslandAttributeSample>& OutSamples) const;
+
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Water")
 	TArray<bool>& GetWaterRegions();
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Water")
@@ -226,6 +441,16 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Moisture")
 	FBiomeData GetPointBiome(FPointIndex Region) const;
 
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Water")
+	TArray<int32>& GetRegionLakeIds();
+	// The index of the lake Region is part of, or -1 if it isn't part of a lake.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Water")
+	int32 GetRegionLakeId(FPointIndex Region) const;
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Water")
+	TArray<FIslandLake>& GetLakes();
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Water")
+	int32 GetNumLakes() const;
+
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Ocean")
 	TArray<int32>& GetTriangleCoastDistances();
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Ocean")
@@ -239,6 +464,23 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
 	TArray<int32>& GetSideFlow();
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
+	TArray<int32>& GetTriangleFlow();
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
+	int32 GetTriangleFlowAt(FTriangleIndex Triangle) const;
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
+	TArray<int32>& GetTriangleWatersheds();
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
+	int32 GetTriangleWatershed(FTriangleIndex Triangle) const;
+	// Every river on the island. Prefer this to GetRivers, which has to make an object for each river.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
+	FIslandRiverNetwork& GetRiverNetwork();
+	const FIslandRiverNetwork& GetRiverNetwork() const;
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
+	int32 GetNumRivers() const;
+	// Makes a river object for every river the first time it's called, and returns the same objects until the island changes.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Rivers")
+	TArray<URiver*> GetRivers();
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
 	TArray<FTriangleIndex>& GetSpringTriangles();
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Rivers")
 	bool IsTriangleSpring(FTriangleIndex Triangle) const;
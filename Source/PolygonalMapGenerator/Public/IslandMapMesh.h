@@ -21,16 +21,114 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = "Mesh")
 	UProceduralMeshComponent* MapMesh;
 
+	/** A hidden procedural mesh that only holds simplified collision. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = "Mesh")
+	UProceduralMeshComponent* CollisionMesh;
+
+	// Bumped every time we start building collision, so stale async results get thrown away.
+	int32 CollisionBuildId;
+
+	/** One procedural mesh component per chunk, if the mesh is chunked. */
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Mesh")
+	TArray<UProceduralMeshComponent*> ChunkMeshes;
+	/** The lower levels of detail for each chunk. LOD n of chunk i is at (n - 1) * ChunkMeshes.Num() + i. */
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Mesh")
+	TArray<UProceduralMeshComponent*> ChunkLODMeshes;
+
+	// Which chunk each triangle belongs to.
+	TArray<int32> t_chunk;
+	// The triangles in chunk i are ChunkTriangles[ChunkOffsets[i]] up to ChunkTriangles[ChunkOffsets[i + 1]].
+	TArray<int32> ChunkOffsets;
+	TArray<int32> ChunkTriangles;
+	// Chunks which need to be rebuilt the next time RebuildDirtyChunks() is called.
+	TArray<bool> DirtyChunks;
+
+	// How many levels of detail the current chunks were made with.
+	int32 NumChunkLODs;
+	// For every LOD past 0, which region each region collapses onto.
+	TArray<TArray<int32>> LODRegionMaps;
+	// The LOD each chunk is currently showing.
+	TArray<int32> ChunkLODs;
+	// How many triangles LOD n of chunk i has, at n * ChunkMeshes.Num() + i.
+	TArray<int32> ChunkTriangleCounts;
+
 public:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
 	float ZScale;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
 	UMaterialInterface* GroundMaterial;
 
+	// If true, the island is split into a grid of chunks, each with its own mesh component.
+	// Chunks are culled separately and can be rebuilt on their own.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh")
+	bool bChunkMesh;
+	// How many chunks to make along each side of the map.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh", meta = (ClampMin = "1", EditCondition = "bChunkMesh"))
+	int32 ChunksPerSide;
+
+	// How many levels of detail each chunk has, including the full-detail mesh.
+	// Every level after the first has roughly a quarter of the triangles of the one before it.
+	// Coastlines, rivers, and the edges of each chunk are kept at full detail, so neighboring chunks always line up.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh|LOD", meta = (ClampMin = "1", ClampMax = "8", EditCondition = "bChunkMesh"))
+	int32 NumLODs;
+	// Roughly how far apart the vertices of LOD 1 are. Each level after that doubles it.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh|LOD", meta = (ClampMin = "1.0", EditCondition = "bChunkMesh"))
+	float LODVertexSpacing;
+	// How far the camera has to be from a chunk before it switches to LOD 1. Each level after that doubles it.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh|LOD", meta = (ClampMin = "0.0", EditCondition = "bChunkMesh"))
+	float LODDistance;
+
+	// If true, deep ocean is merged into much larger triangles, while the coastline keeps its full detail.
+	// Chunked meshes already coarsen the ocean through their levels of detail, so this only applies to the single mesh.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh|Ocean")
+	bool bMergeDeepOcean;
+	// How many triangles away from the coast the ocean has to be before it gets merged.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh|Ocean", meta = (ClampMin = "1", EditCondition = "bMergeDeepOcean"))
+	int32 DeepOceanCoastDistance;
+	// Roughly how far apart the vertices of the merged ocean are.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Mesh|Ocean", meta = (ClampMin = "1.0", EditCondition = "bMergeDeepOcean"))
+	float DeepOceanCellSize;
+
+	// If true, collision comes from a decimated copy of the map on its own component,
+	// built off the game thread and cooked asynchronously.
+	// If false, the render mesh has full-detail collision.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Collision")
+	bool bSimplifiedCollision;
+	// Roughly how far apart the vertices of the simplified collision are.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Collision", meta = (ClampMin = "1.0", EditCondition = "bSimplifiedCollision"))
+	float CollisionVertexSpacing;
+
 public:
 	AIslandMapMesh();
 
+	virtual void Tick(float DeltaSeconds) override;
+
 protected:
 	virtual void OnIslandGenComplete_Implementation() override;
 	virtual void CreateIslandMesh();
+	virtual void CreateChunkMeshes();
+	virtual void CreateCollisionMesh();
+	virtual void CreateChunkLODs();
+
+private:
+	UProceduralMeshComponent* GetChunkMesh(int32 Chunk, int32 LOD) const;
+
+public:
+	// Marks every chunk touching any of these regions as needing a rebuild.
+	// Call this after changing region attributes, then call RebuildDirtyChunks().
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Mesh")
+	void MarkRegionsDirty(const TArray<FPointIndex>& Regions);
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Mesh")
+	void MarkAllChunksDirty();
+	// Rebuilds the mesh of every dirty chunk, in parallel.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Mesh")
+	void RebuildDirtyChunks();
+
+	// Shows the level of detail of each chunk that suits a camera at ViewLocation.
+	// This gets called every tick with the first player's camera, but can be called by hand for other views.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Mesh")
+	void UpdateChunkLODs(const FVector& ViewLocation);
+	// How many triangles the chunks are drawing at their current levels of detail.
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Procedural Generation|Island Generation|Mesh")
+	int32 GetVisibleTriangleCount() const;
 };
@@ -0,0 +1,62 @@
+/*
+* From http://www.redblobgames.com/maps/mapgen2/
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* A compact binary snapshot of a fully generated island.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AIslandMap;
+
+/**
+* Saves and loads everything GenerateIsland() creates, so a saved world can be
+* brought back without regenerating it.
+*
+* The file is a header, a table of sections, and the sections themselves. Each
+* section starts on a 16-byte boundary and is zlib compressed if that makes it
+* smaller, so sections can be pulled straight out of a memory-mapped file and
+* decoded independently of each other.
+*
+* Inside each section:
+*   - Region flags (water, ocean, coast) are packed into bits.
+*   - Index and distance arrays are delta encoded as variable-length integers.
+*   - Floats are either stored as-is or quantized to 16 bits over their range.
+*   - Biomes are stored once each in a palette, and regions just store a palette index.
+*   - The mesh itself uses the FDualMeshCache format.
+*/
+struct POLYGONALMAPGENERATOR_API FIslandMapSnapshot
+{
+public:
+	// Bump this whenever the file layout changes.
+	static const uint32 Version;
+
+	/**
+	* Writes the current state of a generated island out to bytes.
+	* If bQuantizeFloats is true, elevation, moisture and temperature are stored
+	* with 16 bits of precision instead of 32.
+	*/
+	static bool Save(const AIslandMap* Map, TArray<uint8>& OutBytes, bool bQuantizeFloats = false);
+	// Replaces the generated data on an island with the data from a snapshot. Returns false if the snapshot is invalid.
+	// Sizes and indices are all checked before anything is copied, so an invalid snapshot leaves the island untouched.
+	static bool Load(AIslandMap* Map, const uint8* Data, int64 Size);
+
+	static bool SaveToFile(const AIslandMap* Map, const FString& Path, bool bQuantizeFloats = false);
+	// Memory-maps a snapshot file, if the platform supports it, and loads it onto the given island.
+	static bool LoadFromFile(AIslandMap* Map, const FString& Path);
+};
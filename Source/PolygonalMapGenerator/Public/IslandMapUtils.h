@@ -52,6 +52,113 @@ struct POLYGONALMAPGENERATOR_API FIslandShape
 	}
 };
 
+/**
+* A connected body of fresh water: water regions which aren't ocean.
+*/
+USTRUCT(BlueprintType)
+struct POLYGONALMAPGENERATOR_API FIslandLake
+{
+	GENERATED_BODY()
+
+	// The regions making up the lake, in ascending order.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TArray<FPointIndex> Regions;
+	// The land regions touching the lake, in ascending order.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TArray<FPointIndex> ShoreRegions;
+	// The combined area of the lake's Voronoi cells.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float Area;
+	// The average elevation of the lake's regions.
+	// Only valid once region elevations have been assigned.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float SurfaceElevation;
+
+	FIslandLake()
+	{
+		Area = 0.0f;
+		SurfaceElevation = 0.0f;
+	}
+};
+
+/**
+* Every river on an island, stored as flat arrays instead of one object per river.
+*
+* River i covers Triangles[SegmentOffsets[i]] up to Triangles[SegmentOffsets[i + 1]],
+* and Downslopes holds the side each of those triangles drains through.
+* FeedsInto[i] is the index of the river that river i joins, or -1 if it reaches
+* the coast on its own.
+*/
+USTRUCT(BlueprintType)
+struct POLYGONALMAPGENERATOR_API FIslandRiverNetwork
+{
+	GENERATED_BODY()
+
+	// Where each river starts in Triangles, plus one final entry for the end of the array.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TArray<int32> SegmentOffsets;
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TArray<FTriangleIndex> Triangles;
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TArray<FSideIndex> Downslopes;
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TArray<int32> FeedsInto;
+
+	FIslandRiverNetwork()
+	{
+		SegmentOffsets.Add(0);
+	}
+
+	void Empty(int32 ExpectedRivers = 0)
+	{
+		SegmentOffsets.Empty(ExpectedRivers + 1);
+		SegmentOffsets.Add(0);
+		Triangles.Empty();
+		Downslopes.Empty();
+		FeedsInto.Empty(ExpectedRivers);
+	}
+
+	// Starts a new, empty river which doesn't feed into anything. Returns its index.
+	int32 AddRiver()
+	{
+		SegmentOffsets.Add(Triangles.Num());
+		return FeedsInto.Add(INDEX_NONE);
+	}
+
+	// Adds a triangle to the end of the last river.
+	void AddTriangle(FTriangleIndex Triangle, FSideIndex Downslope)
+	{
+		Triangles.Add(Triangle);
+		Downslopes.Add(Downslope);
+		SegmentOffsets.Last() = Triangles.Num();
+	}
+
+	int32 Num() const
+	{
+		return FeedsInto.Num();
+	}
+
+	int32 Length(int32 River) const
+	{
+		return SegmentOffsets[River + 1] - SegmentOffsets[River];
+	}
+
+	TArrayView<const FTriangleIndex> GetTriangles(int32 River) const
+	{
+		return TArrayView<const FTriangleIndex>(Triangles.GetData() + SegmentOffsets[River], Length(River));
+	}
+
+	TArrayView<const FSideIndex> GetDownslopes(int32 River) const
+	{
+		return TArrayView<const FSideIndex>(Downslopes.GetData() + SegmentOffsets[River], Length(River));
+	}
+};
+
+/**
+* A copy of one river, for Blueprints.
+* Islands keep their rivers in an FIslandRiverNetwork, and only make these
+* when asked (see AIslandMap::GetRivers).
+*/
 UCLASS(BlueprintType)
 class POLYGONALMAPGENERATOR_API URiver : public UObject
 {
@@ -178,6 +285,39 @@ public:
 	TArray<FProcMeshTangent> Tangents;
 };
 
+/**
+* A copy of a dual mesh's region positions, along with the counts needed to decimate them.
+* Taken on the game thread, so collision can be built on another thread without touching the mesh.
+*/
+struct POLYGONALMAPGENERATOR_API FMapMeshPoints
+{
+	TArray<FVector2D> Points;
+	FVector2D Size;
+	int32 NumRegions;
+	int32 NumSolidRegions;
+	int32 NumBoundaryRegions;
+	int32 NumSolidTriangles;
+
+	FMapMeshPoints()
+	{
+		Size = FVector2D::ZeroVector;
+		NumRegions = 0;
+		NumSolidRegions = 0;
+		NumBoundaryRegions = 0;
+		NumSolidTriangles = 0;
+	}
+
+	explicit FMapMeshPoints(const UTriangleDualMesh* Mesh)
+	{
+		Points = Mesh->GetPoints();
+		Size = Mesh->GetSize();
+		NumRegions = Mesh->NumRegions;
+		NumSolidRegions = Mesh->NumSolidRegions;
+		NumBoundaryRegions = Mesh->NumBoundaryRegions;
+		NumSolidTriangles = Mesh->NumSolidTriangles;
+	}
+};
+
 /**
  * A collection of utilities used in island generation.
  */
@@ -204,17 +344,76 @@ public:
 	UFUNCTION()
 	static void DrawVoronoiFromMap(class AIslandMap* Map);
 	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Debug")
-	static void DrawDelaunayMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<float>& RegionElevations, const TArray<int32>& SideFlow, const TArray<URiver*>& Rivers, const TArray<float> &TriangleElevations, const TArray<FBiomeData>& RegionBiomes);
+	static void DrawDelaunayMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<float>& RegionElevations, const TArray<int32>& SideFlow, const FIslandRiverNetwork& Rivers, const TArray<float> &TriangleElevations, const TArray<FBiomeData>& RegionBiomes);
 	//UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Debug")
 	UFUNCTION()
-	static void DrawVoronoiMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<FIslandPolygon>& Polygons, const TArray<int32>& SideFlow, const TArray<URiver*>& Rivers, const TArray<float>& TriangleElevations);
+	static void DrawVoronoiMesh(AActor* Context, UTriangleDualMesh* Mesh, const TArray<FIslandPolygon>& Polygons, const TArray<int32>& SideFlow, const FIslandRiverNetwork& Rivers, const TArray<float>& TriangleElevations);
 	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Debug")
-	static void DrawRivers(AActor* Context, UTriangleDualMesh* Mesh, const TArray<URiver*>& Rivers, const TArray<int32>& SideFlow, const TArray<float> &TriangleElevations);
+	static void DrawRivers(AActor* Context, UTriangleDualMesh* Mesh, const FIslandRiverNetwork& Rivers, const TArray<int32>& SideFlow, const TArray<float> &TriangleElevations);
 
 	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation")
-	static void GenerateMesh(class AIslandMap* Map, UProceduralMeshComponent* MapMesh, float ZScale);
+	static void GenerateMesh(class AIslandMap* Map, UProceduralMeshComponent* MapMesh, float ZScale, bool bCreateCollision = true);
 	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation")
-	static void GenerateMapMeshSingleMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation);
+	static void GenerateMapMeshSingleMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, bool bCreateCollision = true);
 	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation")
-	static void GenerateMapMeshMultiMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData> RegionBiomes);
+	static void GenerateMapMeshMultiMaterial(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, bool bCreateCollision = true);
+	// Same as GenerateMapMeshMultiMaterial(), but deep ocean is merged into triangles roughly OceanCellSize wide.
+	// Ocean regions count as deep once every triangle around them is at least MinCoastDistance triangles away from the coast.
+	// Everything closer to the coast than that keeps its full detail.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation")
+	static void GenerateMapMeshMergedOcean(UTriangleDualMesh* Mesh, UProceduralMeshComponent* MapMesh, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, const TArray<bool>& OceanRegions, const TArray<int32>& TriangleCoastDistances, int32 MinCoastDistance = 3, float OceanCellSize = 8000.0f, bool bCreateCollision = true);
+	// Creates a collision-only section from a decimated copy of the map, roughly VertexSpacing units apart.
+	// The section is hidden, so this can go on its own component next to the render mesh.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation")
+	static void GenerateSimplifiedCollision(UTriangleDualMesh* Mesh, UProceduralMeshComponent* CollisionMesh, float ZScale, const TArray<float>& RegionElevation, float VertexSpacing);
+
+	// Determines which corner of a triangle decides the biome for the whole triangle.
+	static FPointIndex GetTriangleBiomeRegion(const UTriangleDualMesh* Mesh, FTriangleIndex Triangle, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes);
+	static FPointIndex GetTriangleBiomeRegion(const UTriangleDualMesh* Mesh, FPointIndex A, FPointIndex B, FPointIndex C, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes);
+	// Builds one flat-shaded mesh section per biome out of the given triangles.
+	// Safe to call from any thread.
+	static void BuildBiomeSections(const UTriangleDualMesh* Mesh, TArrayView<const int32> Triangles, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, TArray<FMapMeshData>& OutSections, TArray<UMaterialInterface*>& OutMaterials);
+	// Same as BuildBiomeSections(), but for triangles that aren't part of the dual mesh.
+	// RegionTriangles holds the 3 regions of every triangle.
+	static void BuildRegionBiomeSections(const UTriangleDualMesh* Mesh, TArrayView<const int32> RegionTriangles, float ZScale, const TArray<float>& RegionElevation, const TArray<bool>& CostalRegions, const TArray<FBiomeData>& RegionBiomes, TArray<FMapMeshData>& OutSections, TArray<UMaterialInterface*>& OutMaterials);
+	// Uploads sections made by BuildBiomeSections() to a mesh component, emptying them as it goes.
+	static void CreateBiomeSections(UProceduralMeshComponent* MapMesh, TArray<FMapMeshData>& Sections, const TArray<UMaterialInterface*>& Materials, bool bCreateCollision = true);
+	// Groups the solid regions into grid cells roughly CellSize wide, and maps every region onto the region closest to the center of its cell.
+	// Regions with different RegionGroups values never end up in the same cluster. An empty RegionGroups puts every region in one group.
+	// Boundary regions, ghost regions, and any regions flagged in PreservedRegions map onto themselves.
+	static void ClusterRegions(const UTriangleDualMesh* Mesh, float CellSize, const TArray<bool>& PreservedRegions, const TArray<int32>& RegionGroups, TArray<int32>& OutRegionMap);
+	// The same as ClusterRegions(), but works straight from the mesh's points and counts.
+	// Doesn't touch the mesh itself, so it's safe to call from any thread on copied points.
+	static void ClusterPoints(const TArray<FVector2D>& Points, const FVector2D& MapSize, int32 NumRegions, int32 NumSolidRegions, int32 NumBoundaryRegions, float CellSize, const TArray<bool>& PreservedRegions, const TArray<int32>& RegionGroups, TArray<int32>& OutRegionMap);
+	// Stops collapsing any region which would flip over one of the triangles around it, by mapping it back onto itself.
+	// Repeats until no collapsed triangle is flipped, so the collapsed mesh covers the same ground with no holes.
+	static void UndoFlippingCollapses(const UTriangleDualMesh* Mesh, TArray<int32>& RegionMap);
+	// Runs ClusterRegions() and UndoFlippingCollapses() once per level of detail, in parallel.
+	// Level 0 uses BaseCellSize, and every level after that doubles it.
+	static void BuildLODRegionMaps(const UTriangleDualMesh* Mesh, int32 NumLevels, float BaseCellSize, const TArray<bool>& PreservedRegions, const TArray<int32>& RegionGroups, TArray<TArray<int32>>& OutRegionMaps);
+	// Moves the corners of each solid triangle onto the regions picked by ClusterRegions().
+	// RegionMap should have been through UndoFlippingCollapses(), so no triangle flips over.
+	// Triangles which collapse into a line are dropped, and triangles which collapse onto the same corners are only kept once.
+	// OutRegionTriangles holds the 3 regions of every triangle that's left.
+	static void CollapseTriangles(const UTriangleDualMesh* Mesh, TArrayView<const int32> Triangles, const TArray<int32>& RegionMap, TArray<int32>& OutRegionTriangles);
+	// Flags every ocean region where all the triangles around it are at least MinCoastDistance triangles from the coast.
+	static void FindDeepOceanRegions(const UTriangleDualMesh* Mesh, const TArray<bool>& OceanRegions, const TArray<int32>& TriangleCoastDistances, int32 MinCoastDistance, TArray<bool>& OutDeepOceanRegions);
+	// Gives every connected group of flagged solid regions its own ID, and every other region -1.
+	// Regions only connect through solid sides, so groups never join up through the ghost region.
+	static void LabelConnectedRegions(const UTriangleDualMesh* Mesh, const TArray<bool>& Regions, TArray<int32>& OutRegionGroups);
+	// Picks a subset of solid regions roughly CellSize apart, keeping the region closest to the center of each grid cell.
+	// Boundary regions, and any regions flagged in PreservedRegions, are always kept.
+	// The kept regions are returned in ascending order.
+	static void DecimateRegions(const UTriangleDualMesh* Mesh, float CellSize, const TArray<bool>& PreservedRegions, TArray<int32>& OutKeptRegions);
+	// Makes a new Delaunay triangulation out of a subset of regions.
+	// OutTriangles holds indices into Regions, 3 per triangle, wound the same way as the dual mesh.
+	static void TriangulateRegions(const UTriangleDualMesh* Mesh, const TArray<int32>& Regions, TArray<int32>& OutTriangles);
+	static void TriangulateRegions(const TArray<FVector2D>& Points, const TArray<int32>& Regions, TArray<int32>& OutTriangles);
+	// Builds the vertices and triangles used by GenerateSimplifiedCollision().
+	// Only reads the copied points, so it's safe to call from any thread.
+	static void BuildSimplifiedCollision(const FMapMeshPoints& Mesh, float ZScale, const TArray<float>& RegionElevation, float VertexSpacing, TArray<FVector>& OutVertices, TArray<int32>& OutTriangles);
+	// Splits the map's triangles into a ChunksPerSide x ChunksPerSide grid, based on the position of each triangle's first region.
+	// Ghost triangles all go into one extra chunk at the end.
+	// The triangles in chunk i are OutChunkTriangles[OutChunkOffsets[i]] up to OutChunkTriangles[OutChunkOffsets[i + 1]].
+	static void AssignTriangleChunks(const UTriangleDualMesh* Mesh, int32 ChunksPerSide, TArray<int32>& OutTriangleChunks, TArray<int32>& OutChunkOffsets, TArray<int32>& OutChunkTriangles);
 };
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+* From http://www.redblobgames.com/maps/mapgen2/
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Mesh/IslandPoissonMeshBuilder.h"
+#include "IslandAdaptiveMeshBuilder.generated.h"
+
+/**
+ * A Poisson mesh builder which packs points tightly where the island is likely to be,
+ * and spreads them out over the open sea.
+ */
+UCLASS()
+class POLYGONALMAPGENERATOR_API UIslandAdaptiveMeshBuilder : public UIslandPoissonMeshBuilder
+{
+	GENERATED_BODY()
+public:
+	// How much spacing between Poisson points out at sea.
+	// PoissonSpacing is used on and around the island.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Points", meta = (ClampMin = "0.0"))
+	float SeaSpacing;
+	// Points closer to the center of the map than this use PoissonSpacing.
+	// This is a fraction of the distance from the center of the map to its edge.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Points", meta = (ClampMin = "0.0"))
+	float LandRadius;
+	// Points further from the center of the map than this use SeaSpacing.
+	// The spacing blends smoothly between LandRadius and SeaRadius.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Points", meta = (ClampMin = "0.0"))
+	float SeaRadius;
+
+public:
+	UIslandAdaptiveMeshBuilder();
+
+protected:
+	virtual void AddPoints_Implementation(UDualMeshBuilder* Builder, FRandomStream& Rng) const override;
+
+	// Returns how tightly packed points should be around the given point,
+	// from 0 (SeaSpacing) to 1 (PoissonSpacing).
+	// Override this to follow something other than the distance from the center of the map.
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Points")
+	float GetPointDensity(const FVector2D& Point) const;
+	virtual float GetPointDensity_Implementation(const FVector2D& Point) const;
+};
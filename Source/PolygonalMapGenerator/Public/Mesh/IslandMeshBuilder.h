@@ -40,6 +40,10 @@ public:
 	// The amount of spacing on the edge of the map.
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Edges", meta = (ClampMin = "0"))
 	int32 BoundarySpacing;
+	// If true, generated meshes are saved to disk and loaded back the next time
+	// the same builder settings and seed are used, instead of being rebuilt.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Cache")
+	bool bCacheMesh;
 
 public:
 	UIslandMeshBuilder();
@@ -50,6 +54,10 @@ protected:
 	virtual void AddPoints_Implementation(UDualMeshBuilder* Builder, FRandomStream& Rng) const;
 	virtual UTriangleDualMesh* GenerateDualMesh_Implementation(FRandomStream& Rng) const;
 
+	// Builds a key which uniquely identifies the mesh this builder will create with the given random stream.
+	// By default, this is made up of the builder's class, every property on the builder, and the stream's seed.
+	virtual FString GetCacheKey(const FRandomStream& Rng) const;
+
 public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Points")
 	UTriangleDualMesh* GenerateDualMesh(UPARAM(ref) FRandomStream& Rng) const;
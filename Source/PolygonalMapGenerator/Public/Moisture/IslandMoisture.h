@@ -23,6 +23,8 @@
 
 #include "DualMesh/Public/TriangleDualMesh.h"
 
+#include "IslandMapUtils.h"
+
 #include "IslandMoisture.generated.h"
 
 /**
@@ -33,25 +35,37 @@ class POLYGONALMAPGENERATOR_API UIslandMoisture : public UDataAsset
 {
 	GENERATED_BODY()
 
+public:
+	// Measure distance from fresh water in world units along the mesh, instead of counting regions.
+	// Hop counts depend on how densely points were placed, which shows up as artifacts on adaptive meshes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Distance")
+	bool bUseGeometricDistances;
+
+public:
+	UIslandMoisture();
+
 protected:
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Moisture")
 	virtual TSet<FPointIndex> FindRiverbanks(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow) const;
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Moisture")
-	virtual TSet<FPointIndex> FindLakeshores(UTriangleDualMesh* Mesh, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const;
+	virtual TSet<FPointIndex> FindLakeshores(const TArray<FIslandLake>& Lakes) const;
+	// Assigns moisture from Euclidean distances to the nearest seed, walking over land only.
+	// r_waterdistance is filled with the distance in mean edge lengths, so it reads like a hop count.
+	virtual void AssignGeometricRegionMoisture(TArray<float>& r_moisture, TArray<int32>& r_waterdistance, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TSet<FPointIndex>& r_moisture_seeds) const;
 
-	virtual TSet<FPointIndex> FindMoistureSeeds_Implementation(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const;
+	virtual TSet<FPointIndex> FindMoistureSeeds_Implementation(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<FIslandLake>& Lakes) const;
 	virtual void AssignRegionMoisture_Implementation(TArray<float>& r_moisture, TArray<int32>& r_waterdistance, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TSet<FPointIndex>& r_moisture_seeds) const;
 	virtual void RedistributeRegionMoisture_Implementation(TArray<float>& r_moisture, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, float MinMoisture, float MaxMoisture) const;
 
 public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Moisture")
-	TSet<FPointIndex> FindMoistureSeeds(UTriangleDualMesh* Mesh, const TArray<int32>& SideFlow, const TArray<bool>& OceanRegions, const TArray<bool>& WaterRegions) const;
+	TSet<FPointIndex> FindMoistureSeeds(UTriangleDualMesh* Mesh, const TArray<int32>& SideFlow, const TArray<FIslandLake>& Lakes) const;
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Moisture")
 	void AssignRegionMoisture(UPARAM(ref) TArray<float>& RegionMoisture, UPARAM(ref) TArray<int32>& RegionWaterDistance, UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions, const TSet<FPointIndex>& MoistureSeedRegions) const;
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Moisture")
 	void RedistributeRegionMoisture(UPARAM(ref) TArray<float>& RegionMoisture, UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions, float MinMoisture, float MaxMoisture) const;
 	
-	TSet<FPointIndex> find_moisture_seeds_r(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<bool>& r_ocean, const TArray<bool>& r_water) const;
+	TSet<FPointIndex> find_moisture_seeds_r(UTriangleDualMesh* Mesh, const TArray<int32>& s_flow, const TArray<FIslandLake>& Lakes) const;
 	void assign_r_moisture(TArray<float>& r_moisture, TArray<int32>& r_waterdistance, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TSet<FPointIndex>& r_moisture_seeds) const;
 	void redistribute_r_moisture(TArray<float>& r_moisture, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, float MinMoisture, float MaxMoisture) const;
 };
@@ -0,0 +1,149 @@
+/*
+* From http://www.redblobgames.com/maps/mapgen2/
+* Original work copyright 2017 Red Blob Games <redblobgames@gmail.com>
+* Unreal Engine 4 implementation copyright 2018 Jay Stevens <jaystevens42@gmail.com>
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "DualMesh/Public/TriangleDualMesh.h"
+
+#include "IslandNavigationGraph.generated.h"
+
+// How much different kinds of terrain cost to walk across.
+USTRUCT(BlueprintType)
+struct POLYGONALMAPGENERATOR_API FIslandNavigationSettings
+{
+	GENERATED_BODY()
+public:
+	// Extra cost for each unit of elevation gained or lost between two regions.
+	// Elevation goes from -1 to 1, and costs are in map units, so this should be on the order of the map size.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation", meta = (ClampMin = "0.0"))
+	float ElevationCost;
+	// How many times more expensive it is to move into a lake region than a land region.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation", meta = (ClampMin = "1.0"))
+	float WaterCostMultiplier;
+	// Flat cost added for crossing a river.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation", meta = (ClampMin = "0.0"))
+	float RiverCrossingCost;
+	// If false, paths never go through the ocean.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	bool bAllowOcean;
+	// The width and height of the square clusters regions are grouped into.
+	// Paths are planned between clusters first, then filled in inside each cluster.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation", meta = (ClampMin = "1.0"))
+	float ClusterSize;
+
+public:
+	FIslandNavigationSettings()
+	{
+		ElevationCost = 100000.0f;
+		WaterCostMultiplier = 4.0f;
+		RiverCrossingCost = 2000.0f;
+		bAllowOcean = false;
+		ClusterSize = 5000.0f;
+	}
+};
+
+/**
+* A weighted region graph for pathfinding across an island, along with a
+* hierarchical (HPA*-style) abstraction of it.
+*
+* Regions are grouped into square clusters. Every pair of neighboring clusters
+* gets one entrance, the cheapest pair of regions across their border. The
+* cost between every pair of entrances in a cluster is worked out up front.
+* Long paths search that small graph of entrances first, then fill in the
+* path inside each cluster they pass through.
+*
+* The graph keeps its own copy of everything it needs, and never changes once
+* it's built, so any number of threads can search it at once, even after the
+* island has been regenerated.
+*/
+class POLYGONALMAPGENERATOR_API FIslandNavigationGraph
+{
+public:
+	FIslandNavigationGraph(const UTriangleDualMesh* Mesh, const TArray<float>& RegionElevation, const TArray<bool>& WaterRegions,
+		const TArray<bool>& OceanRegions, const TArray<int32>& SideFlow, const FIslandNavigationSettings& Settings);
+
+	// Finds a cheap path between two regions. The path includes both the start and goal.
+	// Returns false if there's no path.
+	bool FindPath(FPointIndex Start, FPointIndex Goal, TArray<FPointIndex>& OutPath) const;
+	// Finds the cheapest path with a plain A* search over every region, without using the clusters.
+	bool FindFlatPath(FPointIndex Start, FPointIndex Goal, TArray<FPointIndex>& OutPath) const;
+	// The total cost of walking along a path.
+	float GetPathCost(const TArray<FPointIndex>& Path) const;
+
+	int32 GetNumClusters() const;
+	int32 GetNumEntrances() const;
+
+private:
+	struct FSearchNode
+	{
+		float Cost;
+		int32 Parent;
+		bool bClosed;
+	};
+
+	struct FOpenNode
+	{
+		int32 Node;
+		float Priority;
+
+		bool operator<(const FOpenNode& Other) const
+		{
+			return Priority < Other.Priority;
+		}
+	};
+
+	/**
+	* A* over the region graph.
+	* If Goal is INDEX_NONE, this is a Dijkstra search over everything reachable.
+	* If Cluster isn't INDEX_NONE, the search doesn't leave that cluster.
+	* If bReverse is true, costs are for travelling from each region to Start, rather than from Start.
+	*/
+	void Search(int32 Start, int32 Goal, int32 Cluster, bool bReverse, TMap<int32, FSearchNode>& OutNodes) const;
+	// Searches within Cluster, or every region if Cluster is INDEX_NONE, and appends the path (minus the first region) to OutPath.
+	bool AppendClusterPath(int32 From, int32 To, int32 Cluster, TArray<FPointIndex>& OutPath) const;
+	bool IsPassable(int32 Region) const;
+	int32 GetCluster(const FVector2D& Position) const;
+
+private:
+	// Region positions, copied so the graph doesn't depend on the mesh staying around
+	TArray<FVector2D> Positions;
+	TArray<bool> Passable;
+
+	// Edges in the same compressed sparse row order as the mesh's region sides.
+	// Costs of -1 mean the edge can't be walked.
+	TArray<int32> EdgeOffsets;
+	TArray<int32> EdgeTargets;
+	TArray<float> EdgeCosts;
+	// The cost of walking the same edge the other way, for reverse searches
+	TArray<float> ReverseEdgeCosts;
+
+	FVector2D ClusterCellSize;
+	int32 ClustersWide;
+	int32 ClustersHigh;
+	TArray<int32> RegionClusters;
+
+	// The abstract graph between cluster entrances, also in compressed sparse row form
+	TArray<int32> EntranceRegions;
+	TMap<int32, int32> RegionEntrances;
+	TArray<TArray<int32>> ClusterEntrances;
+	TArray<int32> EntranceEdgeOffsets;
+	TArray<int32> EntranceEdgeTargets;
+	TArray<float> EntranceEdgeCosts;
+};
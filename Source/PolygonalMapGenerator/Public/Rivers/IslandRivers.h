@@ -42,6 +42,10 @@ public:
 	float MinSpringElevation;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0.0", ClampMax = "1.0"))
 	float MaxSpringElevation;
+	// If above 0, every stream draining at least this many land triangles becomes a river,
+	// and the island's NumRivers is ignored. If 0, NumRivers random springs are used instead.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0"))
+	int32 RiverFlowThreshold;
 
 public:
 	UIslandRivers();
@@ -52,11 +56,24 @@ protected:
 	*/
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Rivers")
 	virtual bool IsTriangleWater(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions) const;
+	/**
+	* Is this triangle ocean? True if 2 or more of its corners are ocean.
+	*/
+	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "Procedural Generation|Island Generation|Rivers")
+	virtual bool IsTriangleOcean(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& OceanRegions) const;
+	// These use the mesh's triangle water cache if it has one, otherwise they fall back to IsTriangleWater/IsTriangleOcean.
+	// Only for the generation passes, where the cache was built from the same arrays; the cache doesn't look at them.
+	bool IsTriangleWaterCached(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions) const;
+	bool IsTriangleOceanCached(FTriangleIndex t, UTriangleDualMesh* Mesh, const TArray<bool>& OceanRegions) const;
+	// Traces a river down from RiverTriangle, adding any new river segments to RiverNetwork.
+	// t_river holds the river each triangle belongs to, or -1, and is updated as we go.
 	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Rivers")
-	virtual TArray<URiver*> CreateRiver(FTriangleIndex RiverTriangle, TArray<int32> &s_flow, TMap<FTriangleIndex, URiver*> RiverMap, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, FRandomStream& RiverRng) const;
+	virtual void CreateRiver(FTriangleIndex RiverTriangle, TArray<int32> &s_flow, TArray<int32>& t_river, FIslandRiverNetwork& RiverNetwork, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, FRandomStream& RiverRng) const;
 
 	virtual TArray<FTriangleIndex> FindSpringTriangles_Implementation(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<float>& t_elevation, const TArray<FSideIndex>& t_downslope_s) const;
-	virtual void AssignSideFlow_Implementation(TArray<int32>& s_flow, TArray<URiver*>& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRNG) const;
+	virtual void AccumulateTriangleFlow_Implementation(TArray<int32>& t_flow, TArray<int32>& t_watershed, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<bool>& r_ocean) const;
+	virtual TArray<FTriangleIndex> FindRiverHeadTriangles_Implementation(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<int32>& t_flow, const TArray<FSideIndex>& t_downslope_s) const;
+	virtual void AssignSideFlow_Implementation(TArray<int32>& s_flow, FIslandRiverNetwork& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRNG) const;
 
 public:
 	/**
@@ -66,9 +83,31 @@ public:
 	*/
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Rivers")
 	TArray<FTriangleIndex> FindSpringTriangles(UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions, const TArray<float>& TriangleElevations, const TArray<FSideIndex>& TriangleSideDownslopes) const;
+	/**
+	* The downslope sides form a forest of trees rooted at the coast.
+	* Every land triangle gets one unit of rain, which is passed down the tree
+	* in topological order, so each triangle ends up with the number of land
+	* triangles draining through it. This visits each triangle once.
+	*
+	* Each land triangle is also given the ID of its watershed: every triangle
+	* in a watershed drains out to the sea through the same ocean triangle.
+	* Ocean triangles get a flow of 0 and a watershed of -1, and don't pass
+	* anything on to the triangles downstream of them.
+	*/
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Rivers")
+	void AccumulateTriangleFlow(UPARAM(ref) TArray<int32>& TriangleFlow, UPARAM(ref) TArray<int32>& TriangleWatersheds, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& TriangleSideDownslopes, const TArray<bool>& OceanRegions) const;
+	/**
+	* Find where rivers start if they're chosen by RiverFlowThreshold.
+	* A river starts at each land triangle with enough flow which isn't
+	* fed by another land triangle with enough flow.
+	*/
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Rivers")
+	TArray<FTriangleIndex> FindRiverHeadTriangles(UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions, const TArray<int32>& TriangleFlow, const TArray<FSideIndex>& TriangleSideDownslopes) const;
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Rivers")
-	void AssignSideFlow(UPARAM(ref) TArray<int32>& SideFlow, UPARAM(ref) TArray<URiver*>& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& TriangleSideDownslopes, const TArray<FTriangleIndex>& RiverTriangles, UPARAM(ref) FRandomStream& RiverRNG) const;
+	void AssignSideFlow(UPARAM(ref) TArray<int32>& SideFlow, UPARAM(ref) FIslandRiverNetwork& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& TriangleSideDownslopes, const TArray<FTriangleIndex>& RiverTriangles, UPARAM(ref) FRandomStream& RiverRNG) const;
 
 	TArray<FTriangleIndex> find_spring_t(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<float>& t_elevation, const TArray<FSideIndex>& t_downslope_s) const;
-	void assign_s_flow(TArray<int32>& s_flow, TArray<URiver*>& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRNG) const;
+	void assign_t_flow(TArray<int32>& t_flow, TArray<int32>& t_watershed, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<bool>& r_ocean) const;
+	TArray<FTriangleIndex> find_river_head_t(UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<int32>& t_flow, const TArray<FSideIndex>& t_downslope_s) const;
+	void assign_s_flow(TArray<int32>& s_flow, FIslandRiverNetwork& Rivers, UTriangleDualMesh* Mesh, const TArray<FSideIndex>& t_downslope_s, const TArray<FTriangleIndex>& river_t, FRandomStream& RiverRNG) const;
 };
@@ -42,12 +42,16 @@ public:
 	// Inverts all non-border land and water.
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool bInvertLandAndWater;
+	// Sets every region in a lake to the lake's surface elevation, so lakes come out perfectly flat.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bFlattenLakes;
 
 public:
 	UIslandWater();
 
 protected:
 	virtual void AssignOcean_Implementation(TArray<bool>& r_ocean, UTriangleDualMesh* Mesh, const TArray<bool>& r_water) const;
+	virtual void AssignLakes_Implementation(TArray<int32>& r_lake_id, TArray<FIslandLake>& Lakes, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<bool>& r_ocean) const;
 	virtual void AssignWater_Implementation(TArray<bool>& r_water, FRandomStream& Rng, UTriangleDualMesh* Mesh, const FIslandShape& Shape) const;
 	virtual bool IsPointLand_Implementation(FPointIndex Point, UTriangleDualMesh* Mesh, const FVector2D& HalfMeshSize, const FVector2D& Offset, const FIslandShape& Shape) const;
 	virtual void InitializeWater_Implementation(TArray<bool>& r_water, UTriangleDualMesh* Mesh, FRandomStream& Rng) const;
@@ -60,6 +64,16 @@ protected:
 public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Water")
 	void AssignOcean(UPARAM(ref) TArray<bool>& OceanRegions, UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions) const;
+	/**
+	* Labels every connected lake, after the ocean has been assigned.
+	* Each lake region gets the index of its lake in Lakes, and everything else gets -1.
+	* Lakes are numbered in order of their lowest region.
+	*/
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Water")
+	void AssignLakes(UPARAM(ref) TArray<int32>& RegionLakeIds, UPARAM(ref) TArray<FIslandLake>& Lakes, UTriangleDualMesh* Mesh, const TArray<bool>& WaterRegions, const TArray<bool>& OceanRegions) const;
+	// Sets the surface elevation of each lake, and flattens the lakes if bFlattenLakes is set.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Generation|Island Generation|Water")
+	virtual void AssignLakeElevations(UPARAM(ref) TArray<FIslandLake>& Lakes, UPARAM(ref) TArray<float>& RegionElevations) const;
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "Procedural Generation|Island Generation|Water")
 	void AssignWater(UPARAM(ref) TArray<bool>& WaterRegions, UPARAM(ref) FRandomStream& Rng, UTriangleDualMesh* Mesh, const FIslandShape& IslandShape) const;
 
@@ -67,4 +81,6 @@ public:
 	void assign_r_water(TArray<bool>& r_water, FRandomStream& Rng, UTriangleDualMesh* Mesh, const FIslandShape& Shape) const;
 	// Alias for AssignOcean, using the old-style function name (for people coming from the old API).
 	void assign_r_ocean(TArray<bool>& r_ocean, UTriangleDualMesh* Mesh, const TArray<bool>& r_water) const;
+	// Alias for AssignLakes, using the old-style function name.
+	void assign_r_lake(TArray<int32>& r_lake_id, TArray<FIslandLake>& Lakes, UTriangleDualMesh* Mesh, const TArray<bool>& r_water, const TArray<bool>& r_ocean) const;
 };